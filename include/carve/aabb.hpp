@@ -91,6 +91,9 @@ namespace carve {
       double max(unsigned dim) const;
 
       double volume() const;
+      // the measure of the boundary of the box: its surface area in
+      // 3 dimensions, and its perimeter in 2.
+      double surfaceArea() const;
 
       int compareAxis(const axis_pos &ap) const;
 
@@ -247,6 +247,17 @@ namespace carve {
       return v;
     }
 
+    template<unsigned ndim>
+    double aabb<ndim>::surfaceArea() const {
+      double a = 0.0;
+      for (size_t i = 0; i < ndim; ++i) {
+        double f = 2.0;
+        for (size_t dim = 0; dim < ndim; ++dim) { if (dim != i) f *= 2.0 * extent.v[dim]; }
+        a += f;
+      }
+      return a;
+    }
+
     template<unsigned ndim>
     int aabb<ndim>::compareAxis(const axis_pos &ap) const {
       double p = ap.pos - pos[ap.axis];
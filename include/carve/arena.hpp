@@ -0,0 +1,264 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+#  define CARVE_THREAD_LOCAL __declspec(thread)
+#else
+#  define CARVE_THREAD_LOCAL __thread
+#endif
+
+namespace carve {
+
+
+
+  /**
+   * \class Arena
+   * \brief A monotonic allocator of raw storage.
+   *
+   * Storage is carved sequentially from large blocks, and is only
+   * returned when the arena is cleared or destroyed. Objects
+   * placement constructed in an arena are not destroyed by it; the
+   * owner of the arena is responsible for running any non-trivial
+   * destructors before the storage is released.
+   *
+   * Each thread may have a current arena, installed by an
+   * Arena::Scope, from which arena_allocator draws.
+   */
+  class Arena {
+    struct block_t {
+      char *base;
+      size_t used;
+      size_t size;
+    };
+
+    std::vector<block_t> blocks;
+    size_t block_size;
+    size_t n_allocated;
+
+    static CARVE_THREAD_LOCAL Arena *s_current;
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+
+    static size_t align(size_t n, size_t alignment) {
+      return (n + alignment - 1) & ~(alignment - 1);
+    }
+
+    void addBlock(size_t size) {
+      block_t b;
+      b.base = static_cast<char *>(std::malloc(size));
+      if (b.base == NULL) throw std::bad_alloc();
+      b.used = 0;
+      b.size = size;
+      blocks.push_back(b);
+    }
+
+  public:
+    static const size_t DEFAULT_BLOCK_SIZE = 65536;
+    static const size_t DEFAULT_ALIGNMENT = sizeof(double) > sizeof(void *) ? sizeof(double) : sizeof(void *);
+
+    Arena(size_t _block_size = DEFAULT_BLOCK_SIZE) :
+        blocks(), block_size(_block_size), n_allocated(0) {
+    }
+
+    ~Arena() {
+      clear();
+    }
+
+    /// Allocate \a size bytes aligned to \a alignment, which must be a power of two.
+    void *allocate(size_t size, size_t alignment = DEFAULT_ALIGNMENT) {
+      if (blocks.size()) {
+        block_t &b = blocks.back();
+        size_t p = align(b.used, alignment);
+        if (p + size <= b.size) {
+          b.used = p + size;
+          n_allocated += size;
+          return b.base + p;
+        }
+      }
+      addBlock(std::max(block_size, size + alignment));
+      block_t &b = blocks.back();
+      size_t p = align((size_t)b.base, alignment) - (size_t)b.base;
+      b.used = p + size;
+      n_allocated += size;
+      return b.base + p;
+    }
+
+    /// As allocate(), but safe to call from several threads of an
+    /// OpenMP parallel region at once.
+    void *allocateConcurrent(size_t size, size_t alignment = DEFAULT_ALIGNMENT);
+
+    /// Allocate uninitialized storage for \a n objects of type T.
+    template<typename T>
+    T *allocate(size_t n = 1) {
+      return static_cast<T *>(allocate(sizeof(T) * n));
+    }
+
+    /// Ensure that the next \a size bytes of allocation are satisfied
+    /// from a single block.
+    void reserve(size_t size) {
+      if (blocks.size() && blocks.back().used + size + DEFAULT_ALIGNMENT <= blocks.back().size) return;
+      addBlock(std::max(block_size, size + DEFAULT_ALIGNMENT));
+    }
+
+    /// Release all storage held by the arena.
+    void clear() {
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        std::free(blocks[i].base);
+      }
+      blocks.clear();
+      n_allocated = 0;
+    }
+
+    void swap(Arena &other) {
+      blocks.swap(other.blocks);
+      std::swap(block_size, other.block_size);
+      std::swap(n_allocated, other.n_allocated);
+    }
+
+    bool empty() const {
+      return n_allocated == 0;
+    }
+
+    /// The number of bytes handed out since the arena was last cleared.
+    size_t allocated() const {
+      return n_allocated;
+    }
+
+    /// The number of bytes held in blocks.
+    size_t capacity() const {
+      size_t c = 0;
+      for (size_t i = 0; i < blocks.size(); ++i) c += blocks[i].size;
+      return c;
+    }
+
+    /// The current arena of the calling thread, or NULL.
+    static Arena *current() {
+      return s_current;
+    }
+
+    /**
+     * \class Scope
+     * \brief Makes an arena current for the calling thread for the
+     * lifetime of the Scope, restoring the previous arena afterwards.
+     */
+    class Scope {
+      Arena *prev;
+
+      Scope(const Scope &);
+      Scope &operator=(const Scope &);
+
+    public:
+      Scope(Arena *arena) : prev(s_current) {
+        s_current = arena;
+      }
+
+      ~Scope() {
+        s_current = prev;
+      }
+    };
+  };
+
+
+
+  /**
+   * \class arena_allocator
+   * \brief A standard allocator that draws from an Arena.
+   *
+   * The arena is the calling thread's current arena when the
+   * allocator is constructed, and is carried by copies, so that a
+   * container releases storage to the arena it came from. Without a
+   * current arena, storage comes from the heap. Deallocation into an
+   * arena is a no-op; a container using this allocator must be
+   * destroyed or cleared before its arena.
+   */
+  template<typename T>
+  class arena_allocator {
+  public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+      typedef arena_allocator<U> other;
+    };
+
+    Arena *arena;
+
+    arena_allocator() : arena(Arena::current()) {
+    }
+
+    arena_allocator(const arena_allocator &other) : arena(other.arena) {
+    }
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U> &other) : arena(other.arena) {
+    }
+
+    pointer address(reference r) const { return &r; }
+    const_pointer address(const_reference r) const { return &r; }
+
+    pointer allocate(size_type n, const void * = 0) {
+      if (arena == NULL) return static_cast<pointer>(::operator new(n * sizeof(T)));
+      return static_cast<pointer>(arena->allocateConcurrent(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type) {
+      if (arena == NULL) ::operator delete(p);
+    }
+
+    size_type max_size() const {
+      return size_type(-1) / sizeof(T);
+    }
+
+    void construct(pointer p, const T &val) {
+      new(static_cast<void *>(p)) T(val);
+    }
+
+    void destroy(pointer p) {
+      p->~T();
+    }
+
+    template<typename U>
+    bool operator==(const arena_allocator<U> &other) const {
+      return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const arena_allocator<U> &other) const {
+      return arena != other.arena;
+    }
+  };
+
+
+
+}
@@ -21,6 +21,7 @@
 #include <carve/carve.hpp>
 
 #include <carve/mesh.hpp>
+#include <carve/flat_collection.hpp>
 
 namespace carve {
   namespace csg {
@@ -56,7 +57,7 @@ namespace carve {
     // lib/csg_collector.cpp lib/intersect.cpp
     // lib/intersect_common.hpp lib/intersect_face_division.cpp
     // lib/polyhedron.cpp
-    typedef std::unordered_map<
+    typedef carve::flat_hash_map<
       carve::mesh::MeshSet<3>::vertex_t *,
       carve::mesh::MeshSet<3>::vertex_t *> VVMap;
   }
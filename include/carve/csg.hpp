@@ -32,7 +32,7 @@
 #include <carve/iobj.hpp>
 #include <carve/faceloop.hpp>
 #include <carve/intersection.hpp>
-#include <carve/rtree.hpp>
+#include <carve/flat_rtree.hpp>
 
 namespace carve {
   namespace csg {
@@ -47,6 +47,7 @@ namespace carve {
       void reset();
       vertex_t *get(const vertex_t::vector_t &v = vertex_t::vector_t::ZERO());
       bool inPool(vertex_t *v) const;
+      void splice(VertexPool &other);
 
       VertexPool();
       ~VertexPool();
@@ -54,6 +55,50 @@ namespace carve {
 
 
 
+    /** 
+     * \class PreparedMeshSet
+     * \brief A CSG operand whose acceleration data is computed once.
+     * 
+     * Owns the face R-tree of a meshset, along with its bounding box
+     * and whether it is closed. Passing a PreparedMeshSet to
+     * CSG::compute() in place of a meshset skips this precomputation,
+     * which pays off when the same operand takes part in many
+     * operations.
+     *
+     * The meshset is not owned. It must not be modified while it is
+     * prepared; call update() after changing it.
+     */
+    class PreparedMeshSet {
+    public:
+      typedef carve::mesh::MeshSet<3> meshset_t;
+      typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
+
+    private:
+      meshset_t *meshset;
+      face_rtree_t *rtree;
+      carve::geom::aabb<3> aabb;
+      bool closed;
+
+      PreparedMeshSet(const PreparedMeshSet &);
+      PreparedMeshSet &operator=(const PreparedMeshSet &);
+
+    public:
+      explicit PreparedMeshSet(meshset_t *_meshset);
+      ~PreparedMeshSet();
+
+      /// Recompute all cached data from the meshset.
+      void update();
+
+      meshset_t *getMeshSet() const { return meshset; }
+      const face_rtree_t *getRTree() const { return rtree; }
+      const carve::geom::aabb<3> &getAABB() const { return aabb; }
+
+      /// True if every mesh of the meshset is closed.
+      bool isClosed() const { return closed; }
+    };
+
+
+
     namespace detail {
       struct Data;
       class LoopEdges;
@@ -166,8 +211,11 @@ namespace carve {
       };
 
     private:
-      typedef carve::geom::RTreeNode<3, carve::mesh::Face<3> *> face_rtree_t;
-      typedef std::unordered_map<carve::mesh::Face<3> *, std::vector<carve::mesh::Face<3> *> > face_pairs_t;
+      typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
+      typedef std::pair<carve::mesh::Face<3> *, carve::mesh::Face<3> *> face_pair_t;
+      typedef std::vector<face_pair_t> face_pairs_t;
+      /// A run of face pairs sharing the same first face.
+      typedef std::pair<const face_pair_t *, const face_pair_t *> face_pair_run_t;
 
       /// The computed intersection data.
       Intersections intersections;
@@ -180,43 +228,109 @@ namespace carve {
       /// provides testing for pool membership.
       VertexPool vertex_pool;
 
+      /// Storage for the short lived containers and face loops of a
+      /// single computation, released in one go when it completes.
+      carve::Arena arena;
+
+      /// Makes arena current for the duration of a computation, and
+      /// clears it, together with anything allocated from it, at the
+      /// end. Defined in intersect.cpp.
+      struct TemporaryScope;
+
       void init();
 
       void makeVertexIntersections();
 
       void groupIntersections();
 
-      void _generateVertexVertexIntersections(meshset_t::vertex_t *va,
+      /// Destination for intersections found by one worker of
+      /// generateIntersections(). Defined in intersect.cpp.
+      struct IntersectionScratch;
+
+      typedef void (CSG::*face_pair_pass_t)(IntersectionScratch &,
+                                            const face_pair_run_t &);
+
+      void _generateVertexVertexIntersections(IntersectionScratch &scratch,
+                                              meshset_t::vertex_t *va,
                                               meshset_t::edge_t *eb);
-      void generateVertexVertexIntersections(meshset_t::face_t *a,
-                                             const std::vector<meshset_t::face_t *> &b);
+      void generateVertexVertexIntersections(IntersectionScratch &scratch,
+                                             const face_pair_run_t &run);
 
-      void _generateVertexEdgeIntersections(meshset_t::vertex_t *va,
+      void _generateVertexEdgeIntersections(IntersectionScratch &scratch,
+                                            meshset_t::vertex_t *va,
                                             meshset_t::edge_t *eb);
-      void generateVertexEdgeIntersections(meshset_t::face_t *a,
-                                           const std::vector<meshset_t::face_t *> &b);
+      void generateVertexEdgeIntersections(IntersectionScratch &scratch,
+                                           const face_pair_run_t &run);
 
-      void _generateEdgeEdgeIntersections(meshset_t::edge_t *ea,
+      void _generateEdgeEdgeIntersections(IntersectionScratch &scratch,
+                                          meshset_t::edge_t *ea,
                                           meshset_t::edge_t *eb);
-      void generateEdgeEdgeIntersections(meshset_t::face_t *a,
-                                         const std::vector<meshset_t::face_t *> &b);
+      void generateEdgeEdgeIntersections(IntersectionScratch &scratch,
+                                         const face_pair_run_t &run);
 
-      void _generateVertexFaceIntersections(meshset_t::face_t *fa,
+      void _generateVertexFaceIntersections(IntersectionScratch &scratch,
+                                            meshset_t::face_t *fa,
                                             meshset_t::edge_t *eb);
-      void generateVertexFaceIntersections(meshset_t::face_t *a,
-                                           const std::vector<meshset_t::face_t *> &b);
+      void generateVertexFaceIntersections(IntersectionScratch &scratch,
+                                           const face_pair_run_t &run);
 
-      void _generateEdgeFaceIntersections(meshset_t::face_t *fa,
+      void _generateEdgeFaceIntersections(IntersectionScratch &scratch,
+                                          meshset_t::face_t *fa,
                                           meshset_t::edge_t *eb);
-      void generateEdgeFaceIntersections(meshset_t::face_t *a,
-                                         const std::vector<meshset_t::face_t *> &b);
+      void generateEdgeFaceIntersections(IntersectionScratch &scratch,
+                                         const face_pair_run_t &run);
+
+      /** 
+       * \brief Compute all intersections between a face and its
+       * candidate partners in a single pass.
+       *
+       * Equivalent to running the five generate*Intersections()
+       * passes over the run and over the reversed pairs, but each
+       * face's vertices are walked, and their distances from the
+       * other face's plane computed, once per pair. Those distances
+       * rule out most of the individual tests.
+       */
+      void generateFaceIntersections(IntersectionScratch &scratch,
+                                     const face_pair_run_t &run);
+
+      /** 
+       * \brief Run one intersection pass over a list of face pairs.
+       *
+       * When built with OpenMP the pairs are split into contiguous
+       * chunks, each of which records into its own table and vertex
+       * pool. The chunk tables are then merged into \a intersections
+       * in chunk order, so the result matches a serial pass.
+       * 
+       * @param pass The per-face pass to run.
+       * @param runs The face pair runs, in processing order.
+       */
+      void runIntersectionPass(face_pair_pass_t pass,
+                               const std::vector<face_pair_run_t> &runs);
 
       void generateIntersectionCandidates(meshset_t *a,
-                                          const face_rtree_t *a_node,
+                                          const face_rtree_t *a_rtree,
+                                          face_rtree_t::index_t a_node,
                                           meshset_t *b,
-                                          const face_rtree_t *b_node,
+                                          const face_rtree_t *b_rtree,
+                                          face_rtree_t::index_t b_node,
                                           face_pairs_t &face_pairs,
                                           bool descend_a = true);
+
+      /** 
+       * \brief Find the pairs of faces of \a a and \a b that may intersect.
+       *
+       * The two face trees are traversed together, in parallel when
+       * built with OpenMP. The result does not depend on the number
+       * of threads.
+       * 
+       * @param[out] face_pairs Duplicate free (face of a, face of b)
+       *             pairs, in the order of a serial traversal.
+       */
+      void findIntersectionCandidates(meshset_t *a,
+                                      const face_rtree_t *a_rtree,
+                                      meshset_t *b,
+                                      const face_rtree_t *b_rtree,
+                                      face_pairs_t &face_pairs);
       /** 
        * \brief Compute all points of intersection between poly \a a and poly \a b
        * 
@@ -271,7 +385,15 @@ namespace carve {
       size_t generateFaceLoops(
         meshset_t *poly,
         const detail::Data &data,
-        FaceLoopList &face_loops_out);
+        FaceLoopList &face_loops_out,
+        bool candidate_meshes_only = false,
+        std::vector<meshset_t::face_t *> *untouched_faces = NULL);
+
+      void attachUntouchedFaces(
+        meshset_t *poly,
+        const std::vector<meshset_t::face_t *> &untouched_faces,
+        const detail::LoopEdges &edge_map,
+        FLGroupList &out_loops);
 
 
 
@@ -416,6 +538,12 @@ namespace carve {
        * @param[out] b_face_loops 
        * @param[out] a_edge_count 
        * @param[out] b_edge_count 
+       * @param[out] a_disjoint If not NULL, the meshes of a that cannot touch b
+       *   are appended, and are not divided into face loops.
+       * @param[out] b_disjoint As \a a_disjoint, for the meshes of b.
+       * @param[out] a_untouched If not NULL, the faces of a that no
+       *   intersection touched are appended, and are not turned into face loops.
+       * @param[out] b_untouched As \a a_untouched, for the faces of b.
        */
       void calc(
         meshset_t  *a,
@@ -427,7 +555,31 @@ namespace carve {
         FaceLoopList &a_face_loops,
         FaceLoopList &b_face_loops,
         size_t &a_edge_count,
-        size_t &b_edge_count);
+        size_t &b_edge_count,
+        std::vector<meshset_t::mesh_t *> *a_disjoint = NULL,
+        std::vector<meshset_t::mesh_t *> *b_disjoint = NULL,
+        std::vector<meshset_t::face_t *> *a_untouched = NULL,
+        std::vector<meshset_t::face_t *> *b_untouched = NULL);
+
+      /** 
+       * \brief Classify and collect whole meshes that do not touch the other operand.
+       *
+       * Each mesh lies entirely inside or outside \a other_poly, so
+       * it is classified by a single point, and passed to the
+       * collector as one face loop group made of its unmodified faces.
+       *
+       * @param[in] meshes The meshes to collect.
+       * @param[in] poly The operand that \a meshes belong to.
+       * @param[in] other_poly The other operand.
+       * @param[in] other_rtree The face R-tree of \a other_poly.
+       * @param[in] collector The collector.
+       */
+      void collectDisjointMeshes(
+        const std::vector<meshset_t::mesh_t *> &meshes,
+        const meshset_t *poly,
+        const meshset_t *other_poly,
+        const face_rtree_t *other_rtree,
+        CSG::Collector &collector);
 
     public:
       /**
@@ -452,8 +604,43 @@ namespace carve {
         CLASSIFY_EDGE           /**< Edge classifier. */
       };
 
+      /**
+       * \enum INTERSECTION_KERNEL
+       * \brief The way in which intersections between candidate face pairs are computed.
+       */
+      enum INTERSECTION_KERNEL {
+        INTERSECTION_FUSED,     /**< All tests for a face pair in a single pass (default). */
+        INTERSECTION_PASSES     /**< One pass over all face pairs for each type of test. */
+      };
+
+      /**
+       * \enum POINT_CLASSIFIER
+       * \brief The way in which the group classifier decides whether a point is inside the other operand.
+       */
+      enum POINT_CLASSIFIER {
+        POINT_CLASSIFIER_RAY,            /**< Ray crossing parity (default). */
+        POINT_CLASSIFIER_WINDING_NUMBER  /**< Hierarchical generalized winding number; tolerates small holes and self intersections. */
+      };
+
       CSG::Hooks hooks;         /**< The manager for calculation hooks. */
 
+      INTERSECTION_KERNEL intersection_kernel; /**< The intersection kernel to use. */
+
+      POINT_CLASSIFIER point_classifier; /**< The point classifier used by the group classifier. */
+
+      /**
+       * \brief If true, compute() does not build face loops for faces
+       * that no intersection touched.
+       *
+       * Instead, each connected patch of untouched faces is attached to
+       * the face loop group that it borders, and its faces are copied
+       * to the result unchanged when that group is collected, so that
+       * the cost of an operation scales with the intersected region
+       * rather than the size of the operands. Only applies to the
+       * normal (group) classifier. Defaults to false.
+       */
+      bool pass_through_untouched_faces;
+
       CSG();
       ~CSG();
 
@@ -493,6 +680,61 @@ namespace carve {
         V2Set *shared_edges = NULL,
         CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
 
+      /** 
+       * \brief Compute a CSG operation between two prepared operands, \a a and \a b.
+       *
+       * As compute(meshset_t *, meshset_t *, CSG::Collector &, V2Set *, CLASSIFY_TYPE),
+       * but using the face trees held by the operands instead of building them.
+       * 
+       * @param a Prepared polyhedron a
+       * @param b Prepared polyhedron b
+       * @param collector The collector (determines the CSG operation performed)
+       * @param shared_edges A pointer to a set that will be populated with shared edges (if not NULL).
+       * @param classify_type The type of classifier to use.
+       * 
+       * @return 
+       */
+      meshset_t *compute(
+        const PreparedMeshSet &a,
+        const PreparedMeshSet &b,
+        CSG::Collector &collector,
+        V2Set *shared_edges = NULL,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+      /** 
+       * \brief Compute a CSG operation between two prepared closed operands, \a a and \a b.
+       * 
+       * @param a Prepared polyhedron a
+       * @param b Prepared polyhedron b
+       * @param op The CSG operation (A collector is created automatically).
+       * @param shared_edges A pointer to a set that will be populated with shared edges (if not NULL).
+       * @param classify_type The type of classifier to use.
+       * 
+       * @return 
+       */
+      meshset_t *compute(
+        const PreparedMeshSet &a,
+        const PreparedMeshSet &b,
+        OP op,
+        V2Set *shared_edges = NULL,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+      /// As compute(const PreparedMeshSet &, const PreparedMeshSet &, OP, V2Set *, CLASSIFY_TYPE), preparing only \a a.
+      meshset_t *compute(
+        meshset_t *a,
+        const PreparedMeshSet &b,
+        OP op,
+        V2Set *shared_edges = NULL,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+      /// As compute(const PreparedMeshSet &, const PreparedMeshSet &, OP, V2Set *, CLASSIFY_TYPE), preparing only \a b.
+      meshset_t *compute(
+        const PreparedMeshSet &a,
+        meshset_t *b,
+        OP op,
+        V2Set *shared_edges = NULL,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
       void slice(
         meshset_t *a,
         meshset_t *b,
@@ -500,11 +742,75 @@ namespace carve {
         std::list<meshset_t  *> &b_sliced,
         V2Set *shared_edges = NULL);
 
+      void slice(
+        const PreparedMeshSet &a,
+        const PreparedMeshSet &b,
+        std::list<meshset_t  *> &a_sliced,
+        std::list<meshset_t  *> &b_sliced,
+        V2Set *shared_edges = NULL);
+
       bool sliceAndClassify(
         meshset_t *closed,
         meshset_t *open,
         std::list<std::pair<FaceClass, meshset_t *> > &result,
         V2Set *shared_edges = NULL);
+
+      bool sliceAndClassify(
+        const PreparedMeshSet &closed,
+        const PreparedMeshSet &open,
+        std::list<std::pair<FaceClass, meshset_t *> > &result,
+        V2Set *shared_edges = NULL);
+
+      /**
+       * \brief Compute the union of any number of closed operands.
+       *
+       * Operands whose bounding boxes overlap, directly or through
+       * other operands, form a cluster. Each cluster is reduced by a
+       * balanced binary tree of unions whose leaves are ordered by
+       * position, and the unions of each level of every tree are
+       * computed in parallel. Operands that overlap no other are
+       * copied to the result as they are. Chaining binary unions
+       * instead intersects the growing result with every operand.
+       *
+       * In parallel, each union is computed by a separate CSG object
+       * with the settings of this one. If any hooks are registered,
+       * the unions are computed in turn by this object instead.
+       *
+       * @param operands The operands, which are not modified.
+       * @param classify_type The type of classifier to use.
+       *
+       * @return A new meshset holding the union.
+       */
+      meshset_t *computeUnion(
+        const std::vector<meshset_t *> &operands,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+    private:
+      meshset_t *_compute(
+        meshset_t *a,
+        const face_rtree_t *a_rtree,
+        meshset_t *b,
+        const face_rtree_t *b_rtree,
+        CSG::Collector &collector,
+        V2Set *shared_edges,
+        CLASSIFY_TYPE classify_type);
+
+      void _slice(
+        meshset_t *a,
+        const face_rtree_t *a_rtree,
+        meshset_t *b,
+        const face_rtree_t *b_rtree,
+        std::list<meshset_t  *> &a_sliced,
+        std::list<meshset_t  *> &b_sliced,
+        V2Set *shared_edges);
+
+      void _sliceAndClassify(
+        meshset_t *closed,
+        const face_rtree_t *closed_rtree,
+        meshset_t *open,
+        const face_rtree_t *open_rtree,
+        std::list<std::pair<FaceClass, meshset_t *> > &result,
+        V2Set *shared_edges);
     };
   }
 }
@@ -0,0 +1,154 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/csg.hpp>
+
+namespace carve {
+  namespace csg {
+
+    /**
+     * \class Arrangement
+     * \brief The division of space by a number of closed operands,
+     *        from which any boolean combination of them can be
+     *        collected.
+     *
+     * The surface of each operand is sliced by every other operand
+     * that it meets, once, when the arrangement is constructed. Each
+     * connected group of the resulting faces that is not crossed by
+     * another surface is then classified by the regions of space
+     * either side of it. A region is identified by a bitmask of the
+     * operands that contain it, where operand i is bit i.
+     *
+     * collect() keeps the groups that separate a region chosen by a
+     * Selector from one that is not, oriented away from the chosen
+     * region. This generalizes the classification of face loop groups
+     * against a single other operand, and the class bits chosen by the
+     * collectors of CSG::compute(): the A_MINUS_B collector, for
+     * instance, is equivalent to choosing the region 1 of the
+     * arrangement of A and B. Any number of results can be collected
+     * from one arrangement without repeating the intersection.
+     *
+     * Where the surfaces of two or more operands coincide, the group
+     * from the operand with the lowest index is used.
+     */
+    class Arrangement {
+    public:
+      typedef carve::mesh::MeshSet<3> meshset_t;
+      typedef uint64_t mask_t;
+
+      /// The maximum number of operands.
+      static const size_t MAX_OPERANDS = 64;
+
+      /// A connected group of faces lying on the surface of one operand.
+      struct Group {
+        /// The operand on whose surface the group lies.
+        size_t operand;
+        /// The region behind the faces, opposite their normals.
+        mask_t back;
+        /// The region in front of the faces.
+        mask_t front;
+        /// True if the surface of an operand with a lower index
+        /// coincides with the group.
+        bool coincident;
+        /// The faces of the group, as indices into faceLoops().
+        size_t face_begin, face_end;
+
+        Group(size_t _operand, mask_t _back, mask_t _front, bool _coincident) :
+            operand(_operand), back(_back), front(_front), coincident(_coincident), face_begin(0), face_end(0) {
+        }
+      };
+
+      /**
+       * \class Selector
+       * \brief Chooses the regions of an arrangement to collect.
+       */
+      class Selector {
+      public:
+        virtual bool select(mask_t region) const =0;
+
+        Selector() {}
+        virtual ~Selector() {}
+      };
+
+      /// Chooses a single region.
+      class RegionSelector : public Selector {
+        mask_t region;
+
+      public:
+        explicit RegionSelector(mask_t _region) : region(_region) {}
+
+        virtual bool select(mask_t _region) const { return _region == region; }
+      };
+
+    private:
+      size_t n_operands;
+      std::vector<carve::geom::vector<3> > points;
+      // the vertex indices of each face, in the order of groups.
+      std::vector<std::vector<size_t> > faces;
+      std::vector<Group> groups;
+
+      Arrangement(const Arrangement &);
+      Arrangement &operator=(const Arrangement &);
+
+      void addSurface(size_t operand,
+                      const meshset_t *surface,
+                      const std::vector<PreparedMeshSet *> &prepared,
+                      std::map<carve::geom::vector<3>, size_t> &vmap);
+
+    public:
+      /**
+       * @param[in] operands Closed meshsets, which are not modified.
+       *
+       * If there are more than MAX_OPERANDS operands, or an operand is
+       * not closed, or a group cannot be classified, a
+       * carve::exception is thrown.
+       */
+      Arrangement(const std::vector<meshset_t *> &operands);
+      ~Arrangement();
+
+      size_t operandCount() const { return n_operands; }
+
+      const std::vector<carve::geom::vector<3> > &vertices() const { return points; }
+      const std::vector<std::vector<size_t> > &faceLoops() const { return faces; }
+      const std::vector<Group> &faceGroups() const { return groups; }
+
+      /**
+       * \brief Collect the boundary of the regions chosen by a selector.
+       *
+       * @param[in] selector Chooses regions by the operands that
+       *            contain them. The region outside every operand,
+       *            0, should not be chosen, as it is unbounded.
+       *
+       * @return A new meshset.
+       */
+      meshset_t *collect(const Selector &selector) const;
+
+      /// Collect the region contained by exactly the operands in \a region.
+      meshset_t *collect(mask_t region) const {
+        return collect(RegionSelector(region));
+      }
+    };
+
+  }
+}
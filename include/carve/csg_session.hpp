@@ -0,0 +1,115 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/rtree.hpp>
+#include <carve/csg.hpp>
+
+namespace carve {
+  namespace csg {
+
+    /**
+     * \class SubtractionSession
+     * \brief Subtracts a sequence of closed tools from a closed stock
+     *        mesh, patching the stock in place.
+     *
+     * The session owns a copy of the stock surface and an R-tree of
+     * its faces, both kept up to date between calls. subtract() finds
+     * the stock faces whose bounding boxes meet the tool, slices just
+     * those faces against the tool, and replaces them with the pieces
+     * outside the tool, joined to the pieces of the tool inside the
+     * stock. The faces of the tool's neighbourhood are the only ones
+     * visited, so the cost of a step depends on the size of the tool
+     * and of the stock surface near it, not on the size of the stock.
+     *
+     * Pieces of the tool are classified against the stock by counting
+     * crossings along a segment to a nearby stock face, rather than
+     * along a ray to infinity, for the same reason. Faces of the
+     * neighbourhood that are not cut are left in place, unless they
+     * belong to a component of the stock that the tool encloses.
+     *
+     * The result matches that of repeated
+     * CSG::compute(stock, tool, CSG::A_MINUS_B). Vertices removed from
+     * the stock are not reclaimed until the session is destroyed.
+     */
+    class SubtractionSession {
+    public:
+      typedef carve::mesh::MeshSet<3> meshset_t;
+      typedef meshset_t::vertex_t vertex_t;
+      typedef meshset_t::face_t face_t;
+      typedef carve::geom::RTreeNode<3, face_t *> face_rtree_t;
+
+    private:
+      // vertex storage that does not move as it grows.
+      std::deque<vertex_t> vertices;
+      // the faces of the stock; the id of each face is its index.
+      std::vector<face_t *> faces;
+      face_rtree_t *rtree;
+      size_t leaf_size;
+      size_t internal_size;
+      CSG csg;
+
+      SubtractionSession(const SubtractionSession &);
+      SubtractionSession &operator=(const SubtractionSession &);
+
+      void addFace(face_t *face);
+      void removeFace(face_t *face);
+
+      // stock faces near a tool that has no stock face near it.
+      void findNearFaces(const carve::geom::aabb<3> &aabb, std::vector<face_t *> &near) const;
+
+      // classify a point against the stock, by crossings along a
+      // segment to one of the faces in near.
+      carve::PointClass classifyPoint(const carve::geom::vector<3> &v,
+                                      const std::vector<face_t *> &near) const;
+
+    public:
+      /**
+       * @param[in] stock A closed meshset, which is copied.
+       * @param[in] leaf_size The maximum number of faces in an R-tree leaf.
+       * @param[in] internal_size The maximum number of children of an
+       *            internal R-tree node.
+       */
+      SubtractionSession(const meshset_t *stock, size_t leaf_size = 4, size_t internal_size = 4);
+      ~SubtractionSession();
+
+      /**
+       * \brief Subtract a closed tool from the stock.
+       *
+       * If the tool cannot be classified against the stock, a
+       * carve::exception is thrown and the stock is unchanged.
+       *
+       * @param[in] tool The closed meshset to subtract.
+       *
+       * @return true if the stock was changed.
+       */
+      bool subtract(meshset_t *tool);
+
+      size_t faceCount() const { return faces.size(); }
+
+      /// Return a new meshset holding the stock in its current state.
+      meshset_t *result() const;
+    };
+
+  }
+}
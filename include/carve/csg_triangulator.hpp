@@ -81,7 +81,7 @@ namespace carve {
               fv[2] = vloop[result[i].c];
               out_faces.push_back(face->create(fv.begin(), fv.end(), false));
             }
-            delete face;
+            carve::mesh::MeshSet<3>::face_t::destroy(face);
           }
           std::swap(faces, out_faces);
         }
@@ -136,7 +136,7 @@ namespace carve {
               tri.v[i.idx()] = v;
             }
             result.push_back(tri);
-            delete face;
+            carve::mesh::MeshSet<3>::face_t::destroy(face);
           }
         }
 
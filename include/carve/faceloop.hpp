@@ -18,6 +18,7 @@
 #pragma once
 
 #include <carve/carve.hpp>
+#include <carve/arena.hpp>
 #include <carve/classification.hpp>
 #include <carve/collection_types.hpp>
 
@@ -31,8 +32,28 @@ namespace carve {
       const carve::mesh::MeshSet<3>::face_t *orig_face;
       std::vector<carve::mesh::MeshSet<3>::vertex_t *> vertices;
       FaceLoopGroup *group;
+      // true if this loop was placement constructed in an arena.
+      bool arena_owned;
+
+      FaceLoop(const carve::mesh::MeshSet<3>::face_t *f, const std::vector<carve::mesh::MeshSet<3>::vertex_t *> &v) : next(NULL), prev(NULL), orig_face(f), vertices(v), group(NULL), arena_owned(false) {}
+
+      // Construct a face loop in the calling thread's current arena,
+      // if there is one, and otherwise on the heap.
+      static FaceLoop *create(const carve::mesh::MeshSet<3>::face_t *f, const std::vector<carve::mesh::MeshSet<3>::vertex_t *> &v) {
+        carve::Arena *arena = carve::Arena::current();
+        if (arena == NULL) return new FaceLoop(f, v);
+        FaceLoop *fl = new (arena->allocateConcurrent(sizeof(FaceLoop))) FaceLoop(f, v);
+        fl->arena_owned = true;
+        return fl;
+      }
 
-      FaceLoop(const carve::mesh::MeshSet<3>::face_t *f, const std::vector<carve::mesh::MeshSet<3>::vertex_t *> &v) : next(NULL), prev(NULL), orig_face(f), vertices(v), group(NULL) {}
+      static void destroy(FaceLoop *fl) {
+        if (fl->arena_owned) {
+          fl->~FaceLoop();
+        } else {
+          delete fl;
+        }
+      }
     };
 
 
@@ -78,7 +99,7 @@ namespace carve {
         while (a) {
           b = a;
           a = a->next;
-          delete b;
+          FaceLoop::destroy(b);
         }
       }
     };
@@ -86,6 +107,9 @@ namespace carve {
     struct FaceLoopGroup {
       const carve::mesh::MeshSet<3> *src;
       FaceLoopList face_loops;
+      // input faces that no intersection touched, and which are
+      // collected unchanged along with face_loops.
+      std::vector<const carve::mesh::MeshSet<3>::face_t *> untouched_faces;
       V2Set perimeter;
       std::list<ClassificationInfo> classification;
 
@@ -0,0 +1,657 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
+namespace carve {
+
+
+
+  /**
+   * \class small_set
+   * \brief An ordered set stored as a sorted vector.
+   *
+   * Provides the subset of the std::set interface used by the
+   * library. Lookup is a binary search over contiguous storage, which
+   * is considerably faster and smaller than a node based set for the
+   * handful of elements typical of per-object intersection data.
+   * Unlike std::set, insertion and erasure invalidate iterators and
+   * references.
+   */
+  template<typename value_t,
+           typename compare_t = std::less<value_t>,
+           typename alloc_t = std::allocator<value_t> >
+  class small_set {
+    typedef std::vector<value_t, alloc_t> container_t;
+    container_t data;
+    compare_t comp;
+
+    bool equiv(const value_t &a, const value_t &b) const {
+      return !comp(a, b) && !comp(b, a);
+    }
+
+  public:
+    typedef value_t key_type;
+    typedef value_t value_type;
+    typedef compare_t key_compare;
+    typedef compare_t value_compare;
+    typedef alloc_t allocator_type;
+    typedef typename container_t::size_type size_type;
+    typedef typename container_t::difference_type difference_type;
+    typedef typename container_t::const_reference reference;
+    typedef typename container_t::const_reference const_reference;
+    typedef typename container_t::const_iterator iterator;
+    typedef typename container_t::const_iterator const_iterator;
+    typedef typename container_t::const_reverse_iterator reverse_iterator;
+    typedef typename container_t::const_reverse_iterator const_reverse_iterator;
+
+    small_set() : data(), comp() {
+    }
+
+    template<typename iter_t>
+    small_set(iter_t beg, iter_t end) : data(), comp() {
+      insert(beg, end);
+    }
+
+    const_iterator begin() const { return data.begin(); }
+    const_iterator end() const { return data.end(); }
+    const_reverse_iterator rbegin() const { return data.rbegin(); }
+    const_reverse_iterator rend() const { return data.rend(); }
+
+    size_type size() const { return data.size(); }
+    bool empty() const { return data.empty(); }
+    void clear() { data.clear(); }
+    void reserve(size_type n) { data.reserve(n); }
+
+    allocator_type get_allocator() const { return data.get_allocator(); }
+    key_compare key_comp() const { return comp; }
+
+    const_iterator lower_bound(const value_t &v) const {
+      return std::lower_bound(data.begin(), data.end(), v, comp);
+    }
+
+    const_iterator upper_bound(const value_t &v) const {
+      return std::upper_bound(data.begin(), data.end(), v, comp);
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const value_t &v) const {
+      const_iterator i = lower_bound(v);
+      if (i != data.end() && !comp(v, *i)) return std::make_pair(i, i + 1);
+      return std::make_pair(i, i);
+    }
+
+    const_iterator find(const value_t &v) const {
+      const_iterator i = lower_bound(v);
+      if (i != data.end() && !comp(v, *i)) return i;
+      return data.end();
+    }
+
+    size_type count(const value_t &v) const {
+      return find(v) != data.end() ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_t &v) {
+      typename container_t::iterator i = std::lower_bound(data.begin(), data.end(), v, comp);
+      if (i != data.end() && !comp(v, *i)) return std::make_pair(const_iterator(i), false);
+      i = data.insert(i, v);
+      return std::make_pair(const_iterator(i), true);
+    }
+
+    iterator insert(const_iterator, const value_t &v) {
+      return insert(v).first;
+    }
+
+    template<typename iter_t>
+    void insert(iter_t beg, iter_t end) {
+      size_t n = data.size();
+      data.insert(data.end(), beg, end);
+      if (data.size() - n > 8) {
+        std::sort(data.begin() + n, data.end(), comp);
+        std::inplace_merge(data.begin(), data.begin() + n, data.end(), comp);
+      } else {
+        for (size_t i = n; i < data.size(); ++i) {
+          value_t v = data[i];
+          size_t j = i;
+          for (; j > 0 && comp(v, data[j - 1]); --j) data[j] = data[j - 1];
+          data[j] = v;
+        }
+      }
+      size_t o = 0;
+      for (size_t i = 0; i < data.size(); ++i) {
+        if (o == 0 || !equiv(data[o - 1], data[i])) {
+          if (o != i) data[o] = data[i];
+          ++o;
+        }
+      }
+      data.erase(data.begin() + o, data.end());
+    }
+
+    void erase(const_iterator i) {
+      data.erase(data.begin() + (i - data.begin()));
+    }
+
+    void erase(const_iterator beg, const_iterator end) {
+      data.erase(data.begin() + (beg - data.begin()), data.begin() + (end - data.begin()));
+    }
+
+    size_type erase(const value_t &v) {
+      const_iterator i = find(v);
+      if (i == data.end()) return 0;
+      erase(i);
+      return 1;
+    }
+
+    void swap(small_set &other) {
+      data.swap(other.data);
+      std::swap(comp, other.comp);
+    }
+
+    bool operator==(const small_set &other) const {
+      return data == other.data;
+    }
+
+    bool operator!=(const small_set &other) const {
+      return data != other.data;
+    }
+
+    bool operator<(const small_set &other) const {
+      return std::lexicographical_compare(data.begin(), data.end(), other.data.begin(), other.data.end(), comp);
+    }
+  };
+
+
+
+  /**
+   * \class small_map
+   * \brief An ordered map stored as a vector of pairs sorted by key.
+   *
+   * As for small_set, but associating a value with each key. The
+   * key of each element is not const; it must not be modified
+   * through an iterator.
+   */
+  template<typename key_t,
+           typename mapped_t,
+           typename compare_t = std::less<key_t>,
+           typename alloc_t = std::allocator<std::pair<key_t, mapped_t> > >
+  class small_map {
+  public:
+    typedef key_t key_type;
+    typedef mapped_t mapped_type;
+    typedef mapped_t data_type;
+    typedef std::pair<key_t, mapped_t> value_type;
+    typedef compare_t key_compare;
+    typedef alloc_t allocator_type;
+
+  private:
+    typedef std::vector<value_type, alloc_t> container_t;
+    container_t data;
+    compare_t comp;
+
+    struct key_less {
+      compare_t comp;
+      key_less(const compare_t &_comp) : comp(_comp) {}
+      bool operator()(const value_type &a, const key_t &b) const { return comp(a.first, b); }
+      bool operator()(const key_t &a, const value_type &b) const { return comp(a, b.first); }
+    };
+
+  public:
+    typedef typename container_t::size_type size_type;
+    typedef typename container_t::difference_type difference_type;
+    typedef typename container_t::reference reference;
+    typedef typename container_t::const_reference const_reference;
+    typedef typename container_t::iterator iterator;
+    typedef typename container_t::const_iterator const_iterator;
+    typedef typename container_t::reverse_iterator reverse_iterator;
+    typedef typename container_t::const_reverse_iterator const_reverse_iterator;
+
+    small_map() : data(), comp() {
+    }
+
+    iterator begin() { return data.begin(); }
+    iterator end() { return data.end(); }
+    const_iterator begin() const { return data.begin(); }
+    const_iterator end() const { return data.end(); }
+    reverse_iterator rbegin() { return data.rbegin(); }
+    reverse_iterator rend() { return data.rend(); }
+    const_reverse_iterator rbegin() const { return data.rbegin(); }
+    const_reverse_iterator rend() const { return data.rend(); }
+
+    size_type size() const { return data.size(); }
+    bool empty() const { return data.empty(); }
+    void clear() { data.clear(); }
+    void reserve(size_type n) { data.reserve(n); }
+
+    allocator_type get_allocator() const { return data.get_allocator(); }
+    key_compare key_comp() const { return comp; }
+
+    iterator lower_bound(const key_t &k) {
+      return std::lower_bound(data.begin(), data.end(), k, key_less(comp));
+    }
+
+    const_iterator lower_bound(const key_t &k) const {
+      return std::lower_bound(data.begin(), data.end(), k, key_less(comp));
+    }
+
+    iterator upper_bound(const key_t &k) {
+      return std::upper_bound(data.begin(), data.end(), k, key_less(comp));
+    }
+
+    const_iterator upper_bound(const key_t &k) const {
+      return std::upper_bound(data.begin(), data.end(), k, key_less(comp));
+    }
+
+    iterator find(const key_t &k) {
+      iterator i = lower_bound(k);
+      if (i != data.end() && !comp(k, (*i).first)) return i;
+      return data.end();
+    }
+
+    const_iterator find(const key_t &k) const {
+      const_iterator i = lower_bound(k);
+      if (i != data.end() && !comp(k, (*i).first)) return i;
+      return data.end();
+    }
+
+    size_type count(const key_t &k) const {
+      return find(k) != data.end() ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &v) {
+      iterator i = lower_bound(v.first);
+      if (i != data.end() && !comp(v.first, (*i).first)) return std::make_pair(i, false);
+      i = data.insert(i, v);
+      return std::make_pair(i, true);
+    }
+
+    template<typename iter_t>
+    void insert(iter_t beg, iter_t end) {
+      for (; beg != end; ++beg) insert(value_type((*beg).first, (*beg).second));
+    }
+
+    mapped_t &operator[](const key_t &k) {
+      iterator i = lower_bound(k);
+      if (i == data.end() || comp(k, (*i).first)) {
+        i = data.insert(i, value_type(k, mapped_t()));
+      }
+      return (*i).second;
+    }
+
+    void erase(iterator i) {
+      data.erase(i);
+    }
+
+    void erase(iterator beg, iterator end) {
+      data.erase(beg, end);
+    }
+
+    size_type erase(const key_t &k) {
+      iterator i = find(k);
+      if (i == data.end()) return 0;
+      data.erase(i);
+      return 1;
+    }
+
+    void swap(small_map &other) {
+      data.swap(other.data);
+      std::swap(comp, other.comp);
+    }
+  };
+
+
+
+  /**
+   * \struct flat_hash
+   * \brief The default hash function of flat_hash_map.
+   *
+   * Pointers and integers hash to their own value; flat_hash_map
+   * scrambles hash values itself, so an identity hash is adequate.
+   */
+  template<typename key_t>
+  struct flat_hash {
+    size_t operator()(const key_t &k) const { return (size_t)k; }
+  };
+
+  template<typename T>
+  struct flat_hash<T *> {
+    size_t operator()(T *k) const { return (size_t)k; }
+  };
+
+  template<typename A, typename B>
+  struct flat_hash<std::pair<A, B> > {
+    size_t operator()(const std::pair<A, B> &k) const {
+      size_t a = flat_hash<A>()(k.first);
+      size_t b = flat_hash<B>()(k.second);
+      return a ^ (b + (size_t)0x9e3779b9 + (a << 6) + (a >> 2));
+    }
+  };
+
+
+
+  /**
+   * \class flat_hash_map
+   * \brief An open addressing hash map with linear probing.
+   *
+   * Elements are stored inline in a single power of two sized table,
+   * so that a lookup touches one or two cache lines rather than
+   * following bucket chains. Erased slots are marked rather than
+   * refilled, so that erasure does not move other elements:
+   * references and iterators to other elements remain valid across
+   * erase(), but not across an insertion that grows the table.
+   *
+   * Iteration order is table order, and as for std::unordered_map
+   * should not be relied upon.
+   */
+  template<typename key_t,
+           typename mapped_t,
+           typename hash_t = flat_hash<key_t>,
+           typename equal_t = std::equal_to<key_t> >
+  class flat_hash_map {
+  public:
+    typedef key_t key_type;
+    typedef mapped_t mapped_type;
+    typedef mapped_t data_type;
+    typedef std::pair<const key_t, mapped_t> value_type;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_type &reference;
+    typedef const value_type &const_reference;
+    typedef hash_t hasher;
+    typedef equal_t key_equal;
+
+  private:
+    enum { SLOT_EMPTY = 0, SLOT_FULL = 1, SLOT_ERASED = 2 };
+
+    value_type *slots;
+    unsigned char *state;
+    size_t n_slots;
+    size_t n_full;
+    size_t n_erased;
+    unsigned shift;
+    hash_t hash;
+    equal_t eq;
+
+    size_t home(const key_t &k) const {
+      // fibonacci hashing; the high bits of the product depend on
+      // all bits of the hash.
+      size_t h = hash(k);
+      if (sizeof(size_t) > 4) {
+        h *= (size_t)0x9e3779b97f4a7c15ULL;
+      } else {
+        h *= (size_t)0x9e3779b9UL;
+      }
+      return h >> shift;
+    }
+
+    size_t findSlot(const key_t &k) const {
+      if (!n_full) return n_slots;
+      const size_t mask = n_slots - 1;
+      for (size_t i = home(k); ; i = (i + 1) & mask) {
+        if (state[i] == SLOT_EMPTY) return n_slots;
+        if (state[i] == SLOT_FULL && eq(slots[i].first, k)) return i;
+      }
+    }
+
+    // the slot into which a key not present in the table is placed.
+    size_t freeSlot(const key_t &k) const {
+      const size_t mask = n_slots - 1;
+      size_t i = home(k);
+      while (state[i] == SLOT_FULL) i = (i + 1) & mask;
+      return i;
+    }
+
+    void allocate(size_t n) {
+      n_slots = n;
+      shift = sizeof(size_t) * 8;
+      for (size_t t = n; t > 1; t >>= 1) --shift;
+      slots = static_cast<value_type *>(::operator new(n * sizeof(value_type)));
+      state = new unsigned char[n];
+      memset(state, SLOT_EMPTY, n);
+    }
+
+    void release() {
+      if (!slots) return;
+      for (size_t i = 0; i < n_slots; ++i) {
+        if (state[i] == SLOT_FULL) slots[i].~value_type();
+      }
+      ::operator delete(slots);
+      delete [] state;
+      slots = NULL;
+      state = NULL;
+      n_slots = n_full = n_erased = 0;
+    }
+
+    void rehash(size_t n) {
+      value_type *old_slots = slots;
+      unsigned char *old_state = state;
+      size_t old_n = n_slots;
+
+      allocate(n);
+      n_erased = 0;
+
+      for (size_t i = 0; i < old_n; ++i) {
+        if (old_state[i] != SLOT_FULL) continue;
+        size_t j = freeSlot(old_slots[i].first);
+        new (slots + j) value_type(old_slots[i].first, mapped_t());
+        // swap rather than copy, so that containers are not duplicated.
+        std::swap(slots[j].second, old_slots[i].second);
+        state[j] = SLOT_FULL;
+        old_slots[i].~value_type();
+      }
+
+      if (old_slots) {
+        ::operator delete(old_slots);
+        delete [] old_state;
+      }
+    }
+
+    // make room for one more element.
+    void grow() {
+      if (!n_slots) {
+        rehash(16);
+      } else if ((n_full + n_erased + 1) * 4 > n_slots * 3) {
+        // only grow if the table is genuinely full; otherwise
+        // rebuilding at the same size clears erased slots.
+        rehash((n_full + 1) * 2 > n_slots ? n_slots * 2 : n_slots);
+      }
+    }
+
+  public:
+    template<typename map_t, typename value_t>
+    class iter_t : public std::iterator<std::forward_iterator_tag, value_t> {
+      friend class flat_hash_map;
+      map_t *map;
+      size_t i;
+
+      void skip() {
+        while (i < map->n_slots && map->state[i] != SLOT_FULL) ++i;
+      }
+
+    public:
+      iter_t() : map(NULL), i(0) {}
+      iter_t(map_t *_map, size_t _i) : map(_map), i(_i) {}
+
+      template<typename map2_t, typename value2_t>
+      iter_t(const iter_t<map2_t, value2_t> &other) : map(other.map), i(other.i) {}
+
+      value_t &operator*() const { return map->slots[i]; }
+      value_t *operator->() const { return map->slots + i; }
+
+      iter_t &operator++() { ++i; skip(); return *this; }
+      iter_t operator++(int) { iter_t r(*this); ++i; skip(); return r; }
+
+      template<typename map2_t, typename value2_t>
+      bool operator==(const iter_t<map2_t, value2_t> &other) const { return i == other.i; }
+      template<typename map2_t, typename value2_t>
+      bool operator!=(const iter_t<map2_t, value2_t> &other) const { return i != other.i; }
+
+      template<typename map2_t, typename value2_t> friend class iter_t;
+    };
+
+    typedef iter_t<flat_hash_map, value_type> iterator;
+    typedef iter_t<const flat_hash_map, const value_type> const_iterator;
+
+    flat_hash_map() :
+        slots(NULL), state(NULL), n_slots(0), n_full(0), n_erased(0), shift(0), hash(), eq() {
+    }
+
+    flat_hash_map(const flat_hash_map &other) :
+        slots(NULL), state(NULL), n_slots(0), n_full(0), n_erased(0), shift(0), hash(other.hash), eq(other.eq) {
+      reserve(other.size());
+      insert(other.begin(), other.end());
+    }
+
+    flat_hash_map &operator=(const flat_hash_map &other) {
+      if (this != &other) {
+        flat_hash_map temp(other);
+        swap(temp);
+      }
+      return *this;
+    }
+
+    ~flat_hash_map() {
+      release();
+    }
+
+    iterator begin() { iterator i(this, 0); i.skip(); return i; }
+    iterator end() { return iterator(this, n_slots); }
+    const_iterator begin() const { const_iterator i(this, 0); i.skip(); return i; }
+    const_iterator end() const { return const_iterator(this, n_slots); }
+
+    size_type size() const { return n_full; }
+    bool empty() const { return n_full == 0; }
+
+    /// Remove all elements, retaining the table.
+    void clear() {
+      for (size_t i = 0; i < n_slots; ++i) {
+        if (state[i] == SLOT_FULL) slots[i].~value_type();
+      }
+      if (n_slots) memset(state, SLOT_EMPTY, n_slots);
+      n_full = n_erased = 0;
+    }
+
+    /// Size the table to hold \a n elements without growing.
+    void reserve(size_t n) {
+      size_t want = 16;
+      while (want * 3 < n * 4 + 4) want *= 2;
+      if (want > n_slots) rehash(want);
+    }
+
+    iterator find(const key_t &k) {
+      return iterator(this, findSlot(k));
+    }
+
+    const_iterator find(const key_t &k) const {
+      return const_iterator(this, findSlot(k));
+    }
+
+    size_type count(const key_t &k) const {
+      return findSlot(k) != n_slots ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &v) {
+      size_t i = findSlot(v.first);
+      if (i != n_slots) return std::make_pair(iterator(this, i), false);
+      grow();
+      i = freeSlot(v.first);
+      if (state[i] == SLOT_ERASED) --n_erased;
+      new (slots + i) value_type(v);
+      state[i] = SLOT_FULL;
+      ++n_full;
+      return std::make_pair(iterator(this, i), true);
+    }
+
+    template<typename in_iter_t>
+    void insert(in_iter_t beg, in_iter_t end) {
+      for (; beg != end; ++beg) insert(*beg);
+    }
+
+    mapped_t &operator[](const key_t &k) {
+      size_t i = findSlot(k);
+      if (i == n_slots) {
+        grow();
+        i = freeSlot(k);
+        if (state[i] == SLOT_ERASED) --n_erased;
+        new (slots + i) value_type(k, mapped_t());
+        state[i] = SLOT_FULL;
+        ++n_full;
+      }
+      return slots[i].second;
+    }
+
+    void erase(iterator i) {
+      slots[i.i].~value_type();
+      state[i.i] = SLOT_ERASED;
+      --n_full;
+      ++n_erased;
+    }
+
+    size_type erase(const key_t &k) {
+      size_t i = findSlot(k);
+      if (i == n_slots) return 0;
+      erase(iterator(this, i));
+      return 1;
+    }
+
+    void swap(flat_hash_map &other) {
+      std::swap(slots, other.slots);
+      std::swap(state, other.state);
+      std::swap(n_slots, other.n_slots);
+      std::swap(n_full, other.n_full);
+      std::swap(n_erased, other.n_erased);
+      std::swap(shift, other.shift);
+      std::swap(hash, other.hash);
+      std::swap(eq, other.eq);
+    }
+  };
+
+
+
+}
+
+
+
+namespace std {
+  template<typename value_t, typename compare_t, typename alloc_t>
+  inline void swap(carve::small_set<value_t, compare_t, alloc_t> &a,
+                   carve::small_set<value_t, compare_t, alloc_t> &b) {
+    a.swap(b);
+  }
+
+  template<typename key_t, typename mapped_t, typename compare_t, typename alloc_t>
+  inline void swap(carve::small_map<key_t, mapped_t, compare_t, alloc_t> &a,
+                   carve::small_map<key_t, mapped_t, compare_t, alloc_t> &b) {
+    a.swap(b);
+  }
+
+  template<typename key_t, typename mapped_t, typename hash_t, typename equal_t>
+  inline void swap(carve::flat_hash_map<key_t, mapped_t, hash_t, equal_t> &a,
+                   carve::flat_hash_map<key_t, mapped_t, hash_t, equal_t> &b) {
+    a.swap(b);
+  }
+}
@@ -0,0 +1,516 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/geom.hpp>
+#include <carve/aabb.hpp>
+#include <carve/packed_aabb.hpp>
+#include <carve/rtree.hpp>
+
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+
+namespace carve {
+  namespace geom {
+
+    /**
+     * \class FlatRTree
+     * \brief An R-tree stored in flat arrays, without per node
+     *        allocations or pointers.
+     *
+     * Nodes are identified by 32 bit indices into a single node
+     * array. The root is node 0, nodes are laid out a level at a
+     * time, and the children of each internal node are contiguous.
+     * Each leaf refers to a contiguous range of a single data array.
+     * Node bounding boxes are stored in a packed_aabb, so that the
+     * children of a node are tested against a query a block at a
+     * time.
+     *
+     * construct_STR() partitions its input exactly as
+     * RTreeNode::construct_STR() does, so the two trees have the same
+     * shape and searches return results in the same order. Trees
+     * made by the other RTreeNode builders can be flattened. The tree
+     * can not grow once built, but data may be removed, and bounding
+     * boxes refitted with updateExtents() or refit(). RTreeNode
+     * supports insertion.
+     */
+    template<unsigned ndim,
+             typename data_t,
+             typename aabb_calc_t = carve::geom::get_aabb<ndim, data_t> >
+    class FlatRTree {
+    public:
+      typedef aabb<ndim> aabb_t;
+      typedef vector<ndim> vector_t;
+      typedef FlatRTree<ndim, data_t, aabb_calc_t> tree_t;
+      typedef RTreeNode<ndim, data_t, aabb_calc_t> rtree_node_t;
+      typedef typename rtree_node_t::data_aabb_t data_aabb_t;
+      typedef typename std::vector<data_t>::const_iterator data_iter_t;
+      typedef uint32_t index_t;
+
+    private:
+      // set in node_t::count for leaves.
+      static const index_t LEAF = 0x80000000U;
+
+      struct node_t {
+        // the first child of an internal node, or the index of the
+        // first datum of a leaf.
+        index_t first;
+        // the number of children or data, with LEAF set for leaves.
+        index_t count;
+      };
+
+      // a node under construction.
+      struct build_t {
+        aabb_t bbox;
+        index_t first;
+        index_t count;
+
+        aabb_t getAABB() const { return bbox; }
+      };
+
+      struct bbox_of {
+        const aabb_t &operator()(const build_t &a) const { return a.bbox; }
+        const aabb_t &operator()(const data_aabb_t &a) const { return a.bbox; }
+      };
+
+      std::vector<node_t> nodes;
+      // the bounding box of nodes[i] is bounds.get(i).
+      packed_aabb<ndim> bounds;
+      std::vector<data_t> data;
+
+      index_t _count(index_t node) const { return nodes[node].count & ~LEAF; }
+
+      template<typename obj_t, typename out_iter_t>
+      void _search(index_t node, const obj_t &obj, out_iter_t &out) const {
+        if (!bounds.get(node).intersects(obj)) return;
+        if (isLeaf(node)) {
+          out = std::copy(begin(node), end(node), out);
+        } else {
+          for (index_t c = childBegin(node); c != childEnd(node); ++c) {
+            _search(c, obj, out);
+          }
+        }
+      }
+
+      // search below a node known to intersect obj.
+      template<typename out_iter_t>
+      void _searchChildren(index_t node, const aabb_t &obj, out_iter_t &out) const {
+        if (isLeaf(node)) {
+          out = std::copy(begin(node), end(node), out);
+        } else {
+          intersecting_children children(*this, node, obj);
+          for (index_t c; children.next(c); ) {
+            _searchChildren(c, obj, out);
+          }
+        }
+      }
+
+      template<typename obj_t>
+      void _updateExtents(index_t node, const obj_t &obj) {
+        aabb_t bbox = bounds.get(node);
+        if (!bbox.intersects(obj)) return;
+
+        if (isLeaf(node)) {
+          if (!_count(node)) return;
+          bbox.fit(begin(node), end(node));
+        } else {
+          for (index_t c = childBegin(node); c != childEnd(node); ++c) {
+            _updateExtents(c, obj);
+          }
+          if (!_fitChildren(node, bbox)) return;
+        }
+        bounds.set(node, bbox);
+      }
+
+      // true for a leaf with no data, or a node whose leaves have none.
+      bool _isEmpty(index_t node) const {
+        if (isLeaf(node)) return _count(node) == 0;
+        for (index_t c = childBegin(node); c != childEnd(node); ++c) {
+          if (!_isEmpty(c)) return false;
+        }
+        return true;
+      }
+
+      // fit bbox to the children of an internal node, skipping empty
+      // ones, whose boxes are stale. false if every child is empty.
+      bool _fitChildren(index_t node, aabb_t &bbox) const {
+        bool fitted = false;
+        for (index_t c = childBegin(node); c != childEnd(node); ++c) {
+          if (_isEmpty(c)) continue;
+          if (fitted) {
+            bbox.unionAABB(bounds.get(c));
+          } else {
+            bbox = bounds.get(c);
+            fitted = true;
+          }
+        }
+        return fitted;
+      }
+
+      bool _remove(index_t node, const data_t &val, const aabb_t &val_aabb) {
+        aabb_t bbox = bounds.get(node);
+        if (!bbox.intersects(val_aabb)) return false;
+
+        if (isLeaf(node)) {
+          typename std::vector<data_t>::iterator b = data.begin() + nodes[node].first;
+          typename std::vector<data_t>::iterator e = b + _count(node);
+          typename std::vector<data_t>::iterator i = std::remove(b, e, val);
+          if (i == e) {
+            return false;
+          }
+          // the data range of the leaf shrinks, leaving a gap before
+          // the next leaf. an emptied leaf keeps its box, which its
+          // parent ignores.
+          nodes[node].count = (index_t)(i - b) | LEAF;
+          if (i != b) {
+            bbox.fit(begin(node), end(node));
+            bounds.set(node, bbox);
+          }
+          return true;
+        } else {
+          index_t c = childBegin(node);
+          for (; c != childEnd(node); ++c) {
+            if (_remove(c, val, val_aabb)) break;
+          }
+          if (c == childEnd(node)) return false;
+          if (_fitChildren(node, bbox)) bounds.set(node, bbox);
+          return true;
+        }
+      }
+
+      bool _refit(index_t node, const data_t &val, const aabb_t &old_aabb) {
+        aabb_t bbox = bounds.get(node);
+        if (!bbox.intersects(old_aabb)) return false;
+
+        if (isLeaf(node)) {
+          if (std::find(begin(node), end(node), val) == end(node)) return false;
+          bbox.fit(begin(node), end(node));
+        } else {
+          index_t c = childBegin(node);
+          for (; c != childEnd(node); ++c) {
+            if (_refit(c, val, old_aabb)) break;
+          }
+          if (c == childEnd(node)) return false;
+          _fitChildren(node, bbox);
+        }
+        bounds.set(node, bbox);
+        return true;
+      }
+
+      FlatRTree() : nodes(), bounds(), data() {
+      }
+
+      // make a node for each run of entries ending at ends.
+      template<typename entry_t>
+      static void makeLevel(const std::vector<entry_t> &entries,
+                            const std::vector<size_t> &ends,
+                            index_t flags,
+                            std::vector<build_t> &out) {
+        const int n = (int)ends.size();
+        out.resize(n);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static) if (detail::parallelBuild(entries.size()))
+#endif
+        for (int i = 0; i < n; ++i) {
+          const size_t s = i ? ends[i - 1] : 0;
+          out[i].bbox.fit(entries.begin() + s, entries.begin() + ends[i]);
+          out[i].first = (index_t)s;
+          out[i].count = (index_t)(ends[i] - s) | flags;
+        }
+      }
+
+    public:
+      /**
+       * \class intersecting_children
+       * \brief Visits, in order, the children of an internal node whose
+       * bounding boxes intersect a query box.
+       *
+       * Equivalent to testing tree.bbox(c).intersects(obj) for each
+       * child c in turn, or obj.intersects(tree.bbox(c)) if
+       * query_first is true.
+       */
+      class intersecting_children {
+        const packed_aabb<ndim> &bounds;
+        const aabb_t &obj;
+        bool query_first;
+        index_t first;
+        index_t curr;
+        index_t last;
+        unsigned mask;
+
+      public:
+        intersecting_children(const tree_t &tree, index_t parent, const aabb_t &_obj, bool _query_first = false) :
+            bounds(tree.bounds), obj(_obj), query_first(_query_first),
+            first(tree.childBegin(parent)), curr(first), last(tree.childEnd(parent)), mask(0) {
+        }
+
+        // set child to the next intersecting child, or return false.
+        bool next(index_t &child) {
+          while (curr != last) {
+            const size_t lane = (curr - first) % packed_aabb<ndim>::WIDTH;
+            if (lane == 0) {
+              mask = bounds.intersectsAt(curr, obj, query_first);
+            }
+            const index_t c = curr++;
+            if (mask & (1U << lane)) {
+              child = c;
+              return true;
+            }
+          }
+          return false;
+        }
+      };
+
+      index_t root() const { return 0; }
+
+      // the number of nodes.
+      size_t size() const { return nodes.size(); }
+
+      aabb_t getAABB() const { return bounds.get(root()); }
+
+      aabb_t bbox(index_t node) const { return bounds.get(node); }
+
+      bool isLeaf(index_t node) const { return (nodes[node].count & LEAF) != 0; }
+
+      // the children of an internal node are [childBegin(), childEnd()).
+      index_t childBegin(index_t node) const {
+        CARVE_ASSERT(!isLeaf(node));
+        return nodes[node].first;
+      }
+
+      index_t childEnd(index_t node) const {
+        CARVE_ASSERT(!isLeaf(node));
+        return nodes[node].first + nodes[node].count;
+      }
+
+      // the data of a leaf are [begin(), end()).
+      data_iter_t begin(index_t node) const {
+        CARVE_ASSERT(isLeaf(node));
+        return data.begin() + nodes[node].first;
+      }
+
+      data_iter_t end(index_t node) const {
+        CARVE_ASSERT(isLeaf(node));
+        return data.begin() + nodes[node].first + _count(node);
+      }
+
+      // the approximate heap footprint of the tree, in bytes.
+      size_t memoryUsed() const {
+        return
+          nodes.capacity() * sizeof(node_t) +
+          bounds.memoryUsed() +
+          data.capacity() * sizeof(data_t);
+      }
+
+      // Search the rtree for objects that intersect obj (generally an aabb).
+      // The aabb class must provide a method intersects(obj_t).
+      template<typename obj_t, typename out_iter_t>
+      void search(const obj_t &obj, out_iter_t out) const {
+        _search(root(), obj, out);
+      }
+
+      // Search the rtree for objects whose bounding boxes intersect an
+      // aabb, testing the children of each node together.
+      template<typename out_iter_t>
+      void search(const aabb_t &obj, out_iter_t out) const {
+        if (!bounds.intersects(root(), obj)) return;
+        _searchChildren(root(), obj, out);
+      }
+
+      template<typename out_iter_t>
+      void search(const vector_t &obj, out_iter_t out) const {
+        search(aabb_t(obj), out);
+      }
+
+      // update the bounding box extents of nodes that intersect obj (generally an aabb).
+      // The aabb class must provide a method intersects(obj_t).
+      template<typename obj_t>
+      void updateExtents(const obj_t &obj) {
+        _updateExtents(root(), obj);
+      }
+
+      // remove val, whose bounding box when inserted or last updated
+      // was val_aabb, from the leaf that holds it.
+      bool remove(const data_t &val, const aabb_t &val_aabb) {
+        return _remove(root(), val, val_aabb);
+      }
+
+      // recompute the bounding boxes of the nodes on the path to the
+      // leaf holding val, whose bounding box when inserted or last
+      // updated was old_aabb. As RTreeNode::refit().
+      bool refit(const data_t &val, const aabb_t &old_aabb) {
+        return _refit(root(), val, old_aabb);
+      }
+
+      /**
+       * \brief Copy an RTreeNode tree.
+       *
+       * Nodes are laid out breadth first, so that searches of the
+       * copy return results in the same order as searches of \a root.
+       */
+      static tree_t *flatten(const rtree_node_t *root) {
+        std::vector<const rtree_node_t *> order(1, root);
+        size_t n_data = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+          for (const rtree_node_t *c = order[i]->child; c; c = c->sibling) order.push_back(c);
+          n_data += order[i]->data.size();
+        }
+
+        CARVE_ASSERT(order.size() < LEAF && n_data < LEAF);
+
+        tree_t *tree = new tree_t;
+        tree->nodes.resize(order.size());
+        tree->bounds.resize(order.size(), packed_aabb<ndim>::WIDTH - 1);
+        tree->data.reserve(n_data);
+
+        index_t next = 1;
+        for (size_t i = 0; i < order.size(); ++i) {
+          const rtree_node_t *node = order[i];
+          node_t &out = tree->nodes[i];
+          if (node->child) {
+            out.first = next;
+            out.count = 0;
+            for (const rtree_node_t *c = node->child; c; c = c->sibling) ++out.count;
+            next += out.count;
+          } else {
+            out.first = (index_t)tree->data.size();
+            out.count = (index_t)node->data.size() | LEAF;
+            tree->data.insert(tree->data.end(), node->data.begin(), node->data.end());
+          }
+          tree->bounds.set(i, node->bbox);
+        }
+
+        return tree;
+      }
+
+      // construct with RTreeNode::construct_SAH(), and flatten.
+      static tree_t *construct_SAH(std::vector<data_aabb_t> &data, size_t leaf_size, size_t internal_size) {
+        std::auto_ptr<rtree_node_t> root(rtree_node_t::construct_SAH(data.begin(), data.end(), leaf_size, internal_size));
+        return flatten(root.get());
+      }
+
+      template<typename iter_t>
+      static tree_t *construct_SAH(const iter_t &begin,
+                                   const iter_t &end,
+                                   size_t leaf_size,
+                                   size_t internal_size) {
+        std::auto_ptr<rtree_node_t> root(rtree_node_t::construct_SAH(begin, end, leaf_size, internal_size));
+        return flatten(root.get());
+      }
+
+      // construct with RTreeNode::construct_TGS(), and flatten.
+      template<typename iter_t>
+      static tree_t *construct_TGS(const iter_t &begin,
+                                   const iter_t &end,
+                                   size_t leaf_size,
+                                   size_t internal_size) {
+        std::auto_ptr<rtree_node_t> root(rtree_node_t::construct_TGS(begin, end, leaf_size, internal_size));
+        return flatten(root.get());
+      }
+
+      static tree_t *construct_STR(std::vector<data_aabb_t> &data, size_t leaf_size, size_t internal_size) {
+        std::vector<std::vector<build_t> > levels(1);
+        std::vector<size_t> ends;
+
+        if (data.size()) {
+          detail::partitionSTR<ndim>(data.begin(), data.end(), 0, 0, leaf_size, bbox_of(), ends);
+        } else {
+          ends.push_back(0);
+        }
+        makeLevel(data, ends, LEAF, levels.back());
+
+        size_t n_nodes = levels.back().size();
+        while (levels.back().size() > 1) {
+          std::vector<build_t> &curr = levels.back();
+          std::vector<build_t> next;
+          ends.clear();
+          detail::partitionSTR<ndim>(curr.begin(), curr.end(), 0, 0, internal_size, bbox_of(), ends);
+          // child indices are relative to the start of this level, for now.
+          makeLevel(curr, ends, 0, next);
+          n_nodes += next.size();
+          levels.push_back(std::vector<build_t>());
+          levels.back().swap(next);
+        }
+
+        CARVE_ASSERT(n_nodes < LEAF && data.size() < LEAF);
+
+        // lay the levels out from the root down.
+        std::vector<size_t> base(levels.size());
+        for (size_t l = levels.size(), b = 0; l--; ) {
+          base[l] = b;
+          b += levels[l].size();
+        }
+
+        tree_t *tree = new tree_t;
+        tree->nodes.resize(n_nodes);
+        tree->bounds.resize(n_nodes, packed_aabb<ndim>::WIDTH - 1);
+        for (size_t l = 0; l < levels.size(); ++l) {
+          for (size_t i = 0; i < levels[l].size(); ++i) {
+            const build_t &node = levels[l][i];
+            node_t &out = tree->nodes[base[l] + i];
+            out.first = l ? (index_t)base[l - 1] + node.first : node.first;
+            out.count = node.count;
+            tree->bounds.set(base[l] + i, node.bbox);
+          }
+        }
+
+        tree->data.reserve(data.size());
+        for (size_t i = 0; i < data.size(); ++i) {
+          tree->data.push_back(data[i].data);
+        }
+
+        return tree;
+      }
+
+      template<typename iter_t>
+      static tree_t *construct_STR(const iter_t &begin,
+                                   const iter_t &end,
+                                   size_t leaf_size,
+                                   size_t internal_size) {
+        std::vector<data_aabb_t> data;
+        data.reserve(std::distance(begin, end));
+        detail::appendDataAABBs(begin, end, data);
+        return construct_STR(data, leaf_size, internal_size);
+      }
+
+      template<typename iter_t>
+      static tree_t *construct_STR(const iter_t &begin1,
+                                   const iter_t &end1,
+                                   const iter_t &begin2,
+                                   const iter_t &end2,
+                                   size_t leaf_size,
+                                   size_t internal_size) {
+        std::vector<data_aabb_t> data;
+        data.reserve(std::distance(begin1, end1) + std::distance(begin2, end2));
+        detail::appendDataAABBs(begin1, end1, data);
+        detail::appendDataAABBs(begin2, end2, data);
+        return construct_STR(data, leaf_size, internal_size);
+      }
+    };
+
+
+
+    template<unsigned ndim, typename data_t, typename aabb_calc_t>
+    const typename FlatRTree<ndim, data_t, aabb_calc_t>::index_t FlatRTree<ndim, data_t, aabb_calc_t>::LEAF;
+
+  }
+}
@@ -370,6 +370,71 @@ namespace carve {
 
 
 
+    /**
+     * \brief pointInPolySimple() for a triangle.
+     *
+     * Tests the side of each edge on which \a p lies, rather than
+     * summing winding angles. Degenerate triangles fall back to
+     * pointInPolySimple().
+     *
+     * @param[in] tri The three triangle vertices.
+     * @param[in] p The point to test.
+     */
+    inline bool pointInTriangleSimple(const P2 *tri, const P2 &p) {
+      double o = orient2d(tri[0], tri[1], tri[2]);
+      if (o == 0.0) {
+        return pointInPolySimple(std::vector<P2>(tri, tri + 3), p);
+      }
+      if (o < 0.0) {
+        return
+          orient2d(tri[0], tri[1], p) <= 0.0 &&
+          orient2d(tri[1], tri[2], p) <= 0.0 &&
+          orient2d(tri[2], tri[0], p) <= 0.0;
+      }
+      return
+        orient2d(tri[0], tri[1], p) >= 0.0 &&
+        orient2d(tri[1], tri[2], p) >= 0.0 &&
+        orient2d(tri[2], tri[0], p) >= 0.0;
+    }
+
+
+
+    /**
+     * \brief pointInPoly() for a triangle.
+     *
+     * Vertex and edge classification is as for pointInPoly(); interior
+     * points are classified by pointInTriangleSimple().
+     *
+     * @param[in] tri The three triangle vertices.
+     * @param[in] p The point to test.
+     */
+    inline PolyInclusionInfo pointInTriangle(const P2 *tri, const P2 &p) {
+      for (unsigned i = 0; i < 3; i++) {
+        if (equal(tri[i], p)) return PolyInclusionInfo(POINT_VERTEX, (int)i);
+      }
+
+      for (unsigned i = 0; i < 3; i++) {
+        const P2 &a = tri[i];
+        const P2 &b = tri[i == 2 ? 0 : i + 1];
+
+        if (std::min(a.x, b.x) - EPSILON < p.x &&
+            std::max(a.x, b.x) + EPSILON > p.x &&
+            std::min(a.y, b.y) - EPSILON < p.y &&
+            std::max(a.y, b.y) + EPSILON > p.y &&
+            distance2(carve::geom::rayThrough(a, b), p) < EPSILON2) {
+          return PolyInclusionInfo(POINT_EDGE, (int)i);
+        }
+      }
+
+      if (pointInTriangleSimple(tri, p)) {
+        return PolyInclusionInfo(POINT_IN);
+      }
+
+      return PolyInclusionInfo(POINT_OUT);
+    }
+
+
+
     bool pickContainedPoint(const std::vector<P2> &poly, P2 &result);
 
     template<typename T, typename adapt_t>
@@ -99,6 +99,26 @@ namespace carve {
       return true;
     }
 
+    // fitPlane() for the vertices of a triangle, without gathering
+    // them into temporary storage. The result is identical.
+    inline bool fitPlane(const Vector &a, const Vector &b, const Vector &c, Plane &plane) {
+      Vector C = (a + b + c) / 3.0;
+      Vector n = cross(b - a, c - a);
+
+      if (n.length() == 0.0) {
+        n.x = 1.0;
+        n.y = 0.0;
+        n.z = 0.0;
+      } else {
+        n.normalize();
+      }
+
+      plane.N = n;
+      plane.d = -dot(n, C);
+
+      return true;
+    }
+
     bool planeIntersection(const Plane &a, const Plane &b, Ray &r);
 
     IntersectionClass rayPlaneIntersection(const Plane &p,
@@ -320,5 +340,29 @@ namespace carve {
 
 
 
+    /**
+     * \class RayDirections
+     * \brief A deterministic sequence of well distributed unit vectors.
+     *
+     * Used to pick ray directions for point containment tests. The
+     * directions are a shifted Halton (2,3) sequence mapped onto the
+     * unit sphere, so successive directions spread evenly over the
+     * sphere and avoid the coordinate axes, and every instance
+     * produces the same sequence. Each containment query should use
+     * its own instance, which makes queries reentrant and
+     * reproducible.
+     */
+    class RayDirections {
+      unsigned index;
+
+    public:
+      RayDirections() : index(0) {
+      }
+
+      Vector next();
+    };
+
+
+
   }
 }
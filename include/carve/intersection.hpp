@@ -29,12 +29,12 @@ namespace carve {
      * \brief Storage for computed intersections between vertices, edges and faces.
      * 
      */
-    struct Intersections : public std::unordered_map<IObj, IObjVMapSmall, IObj_hash> {
+    struct Intersections : public carve::flat_hash_map<IObj, IObjVMapSmall, IObj_hash> {
       typedef carve::mesh::MeshSet<3>::vertex_t vertex_t;
       typedef carve::mesh::MeshSet<3>::edge_t   edge_t;
       typedef carve::mesh::MeshSet<3>::face_t   face_t;
 
-      typedef std::unordered_map<IObj, IObjVMapSmall, IObj_hash> super;
+      typedef carve::flat_hash_map<IObj, IObjVMapSmall, IObj_hash> super;
 
       ~Intersections() {
       }
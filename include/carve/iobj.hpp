@@ -18,6 +18,8 @@
 #pragma once
 
 #include <carve/carve.hpp>
+#include <carve/arena.hpp>
+#include <carve/flat_collection.hpp>
 
 namespace carve {
   namespace csg {
@@ -59,10 +61,13 @@ namespace carve {
     typedef std::unordered_set<std::pair<const IObj, const IObj>, IObj_hash> IObjPairSet;
 
     typedef std::unordered_map<IObj, carve::mesh::MeshSet<3>::vertex_t *, IObj_hash> IObjVMap;
-    typedef std::map<IObj, carve::mesh::MeshSet<3>::vertex_t *> IObjVMapSmall;
+    typedef carve::small_map<IObj,
+                             carve::mesh::MeshSet<3>::vertex_t *,
+                             std::less<IObj>,
+                             carve::arena_allocator<std::pair<IObj, carve::mesh::MeshSet<3>::vertex_t *> > > IObjVMapSmall;
 
     class VertexIntersections :
-      public std::unordered_map<carve::mesh::MeshSet<3>::vertex_t *, IObjPairSet> {
+      public carve::flat_hash_map<carve::mesh::MeshSet<3>::vertex_t *, IObjPairSet> {
     };
 
 
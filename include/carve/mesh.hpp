@@ -19,14 +19,16 @@
 
 #include <carve/carve.hpp>
 
+#include <carve/arena.hpp>
 #include <carve/geom.hpp>
 #include <carve/geom3d.hpp>
 #include <carve/tag.hpp>
 #include <carve/djset.hpp>
 #include <carve/aabb.hpp>
-#include <carve/rtree.hpp>
+#include <carve/flat_rtree.hpp>
 
 #include <iostream>
+#include <memory>
 
 namespace carve {
   namespace poly {
@@ -40,6 +42,7 @@ namespace carve {
     template<unsigned ndim> class Face;
     template<unsigned ndim> class Mesh;
     template<unsigned ndim> class MeshSet;
+    template<unsigned ndim> class FaceGeometry;
 
 
 
@@ -132,6 +135,11 @@ namespace carve {
     // incident on each edge).
     template<unsigned ndim>
     class Edge : public tagable {
+      // true if this edge was placement constructed in the arena of
+      // its MeshSet. Declared first so that it packs into the padding
+      // following tagable.
+      bool arena_owned;
+
     public:
       typedef Vertex<ndim> vertex_t;
       typedef Face<ndim> face_t;
@@ -140,6 +148,10 @@ namespace carve {
       face_t *face;
       Edge *prev, *next, *rev;
 
+      // the dense index of this half-edge within its MeshSet; see
+      // MeshSet::renumber().
+      size_t id;
+
     private:
       static void _link(Edge *a, Edge *b) {
         a->next = b; b->prev = a;
@@ -149,7 +161,7 @@ namespace carve {
         Edge *e = s;
         do {
           Edge *n = e->next;
-          delete e;
+          destroy(e);
           e = n;
         } while (e != s);
       }
@@ -240,6 +252,17 @@ namespace carve {
       Edge(vertex_t *_vert, face_t *_face);
 
       ~Edge();
+
+      bool isArenaOwned() const { return arena_owned; }
+
+      // Construct an edge in \a arena, or on the heap if \a arena is
+      // NULL.
+      static Edge *allocate(carve::Arena *arena, vertex_t *_vert, face_t *_face);
+
+      // Destroy an edge, releasing its storage unless it is owned by
+      // an arena. Edges must be disposed of with destroy() rather
+      // than delete.
+      static void destroy(Edge *e);
     };
 
 
@@ -248,6 +271,9 @@ namespace carve {
     // circular list that defines its boundary.
     template<unsigned ndim>
     class Face : public tagable {
+      // as for Edge::arena_owned.
+      bool arena_owned;
+
     public:
       typedef Vertex<ndim> vertex_t;
       typedef Edge<ndim> edge_t;
@@ -295,11 +321,11 @@ namespace carve {
       Face &operator=(const Face &other);
 
     protected:
-      Face() : edge(NULL), n_edges(0), mesh(NULL), id(0), plane(), project(NULL), unproject(NULL) {
+      Face() : arena_owned(false), edge(NULL), n_edges(0), mesh(NULL), id(0), plane(), project(NULL), unproject(NULL) {
       }
 
       Face(const Face &other) :
-        edge(NULL), n_edges(other.n_edges), mesh(NULL), id(other.id),
+        arena_owned(false), edge(NULL), n_edges(other.n_edges), mesh(NULL), id(other.id),
         plane(other.plane), project(other.project), unproject(other.unproject) {
       }
 
@@ -333,11 +359,11 @@ namespace carve {
 
       // build an edge loop in forward orientation from an iterator pair
       template<typename iter_t>
-      void loopFwd(iter_t vbegin, iter_t vend);
+      void loopFwd(iter_t vbegin, iter_t vend, carve::Arena *arena = NULL);
 
       // build an edge loop in reverse orientation from an iterator pair
       template<typename iter_t>
-      void loopRev(iter_t vbegin, iter_t vend);
+      void loopRev(iter_t vbegin, iter_t vend, carve::Arena *arena = NULL);
 
       // initialize a face from an ordered list of vertices.
       template<typename iter_t>
@@ -352,11 +378,26 @@ namespace carve {
       void getVertices(std::vector<vertex_t *> &verts) const;
       void getProjectedVertices(std::vector<carve::geom::vector<2> > &verts) const;
 
+      // as getProjectedVertices(), for a face with three edges.
+      void getProjectedTriangle(carve::geom::vector<2> *tri) const {
+        CARVE_ASSERT(n_edges == 3);
+        tri[0] = project(edge->vert->v);
+        tri[1] = project(edge->next->vert->v);
+        tri[2] = project(edge->prev->vert->v);
+      }
+
       projection_mapping projector() const {
         return projection_mapping(project);
       }
 
       std::pair<double, double> rangeInDirection(const vector_t &v, const vector_t &b) const {
+        if (n_edges == 3) {
+          double d0 = carve::geom::dot(v, edge->vert->v - b);
+          double d1 = carve::geom::dot(v, edge->next->vert->v - b);
+          double d2 = carve::geom::dot(v, edge->prev->vert->v - b);
+          return std::make_pair(std::min(std::min(d0, d1), d2), std::max(std::max(d0, d1), d2));
+        }
+
         edge_t *e = edge;
         double lo, hi;
         lo = hi = carve::geom::dot(v, e->vert->v - b);
@@ -381,7 +422,7 @@ namespace carve {
 
       static Face *closeLoop(edge_t *open_edge);
 
-      Face(edge_t *e) : edge(e), n_edges(0), mesh(NULL) {
+      Face(edge_t *e) : arena_owned(false), edge(e), n_edges(0), mesh(NULL), id(0) {
         do {
           e->face = this;
           n_edges++;
@@ -390,18 +431,18 @@ namespace carve {
         recalc();
       }
 
-      Face(vertex_t *a, vertex_t *b, vertex_t *c) : edge(NULL), n_edges(0), mesh(NULL) {
+      Face(vertex_t *a, vertex_t *b, vertex_t *c) : arena_owned(false), edge(NULL), n_edges(0), mesh(NULL), id(0) {
         init(a, b, c);
         recalc();
       }
 
-      Face(vertex_t *a, vertex_t *b, vertex_t *c, vertex_t *d) : edge(NULL), n_edges(0), mesh(NULL) {
+      Face(vertex_t *a, vertex_t *b, vertex_t *c, vertex_t *d) : arena_owned(false), edge(NULL), n_edges(0), mesh(NULL), id(0) {
         init(a, b, c, d);
         recalc();
       }
 
       template<typename iter_t>
-      Face(iter_t begin, iter_t end) : edge(NULL), n_edges(0), mesh(NULL) {
+      Face(iter_t begin, iter_t end) : arena_owned(false), edge(NULL), n_edges(0), mesh(NULL), id(0) {
         init(begin, end);
         recalc();
       }
@@ -409,7 +450,21 @@ namespace carve {
       template<typename iter_t>
       Face *create(iter_t beg, iter_t end, bool reversed) const;
 
-      Face *clone(const vertex_t *old_base, vertex_t *new_base, std::unordered_map<const edge_t *, edge_t *> &edge_map) const;
+      // Construct a face from an ordered list of vertices, placing
+      // the face and its edges in \a arena.
+      template<typename iter_t>
+      static Face *allocate(carve::Arena &arena, iter_t begin, iter_t end);
+
+      // Destroy a face and its edges, releasing storage that is not
+      // owned by an arena.
+      static void destroy(Face *f);
+
+      bool isArenaOwned() const { return arena_owned; }
+
+      Face *clone(const vertex_t *old_base,
+                  vertex_t *new_base,
+                  std::unordered_map<const edge_t *, edge_t *> &edge_map,
+                  carve::Arena *arena = NULL) const;
 
       void remove() {
         edge_t *e = edge;
@@ -703,14 +758,31 @@ namespace carve {
         if (isClosed()) is_negative = !is_negative;
       }
 
-      Mesh *clone(const vertex_t *old_base, vertex_t *new_base) const;
+      Mesh *clone(const vertex_t *old_base, vertex_t *new_base, carve::Arena *arena = NULL) const;
     };
 
     // A MeshSet manages vertex storage, and a collection of meshes.
     // It should be easy to turn a vertex pointer into its index in
     // its MeshSet vertex_storage.
+    //
+    // Faces and edges built by the index buffer constructors and by
+    // clone() are placed contiguously in an arena owned by the
+    // MeshSet, and are released in bulk when it is destroyed. Such
+    // faces may still be destroyed individually, but must not
+    // outlive the MeshSet. Meshes detached from one MeshSet and
+    // passed to MeshSet(std::vector<mesh_t *> &) are copied into the
+    // arena of the new MeshSet if they hold any, so the old MeshSet
+    // may then be destroyed.
     template<unsigned ndim>
     class MeshSet {
+      carve::Arena arena;
+
+      size_t n_edge_ids;
+      size_t n_face_ids;
+
+      // built on demand by faceGeometry().
+      std::auto_ptr<FaceGeometry<ndim> > face_geometry;
+
       MeshSet();
       MeshSet(const MeshSet &);
       MeshSet &operator=(const MeshSet &);
@@ -801,13 +873,27 @@ namespace carve {
         for (size_t i = 0; i < meshes.size(); ++i) {
           meshes[i]->recalc();
         }
+        invalidateFaceGeometry();
       }
 
+      // Construct a mesh set from a vertex list and a face list in
+      // which each face is given by its vertex count followed by its
+      // vertex indices.
       MeshSet(const std::vector<typename vertex_t::vector_t> &points,
               size_t n_faces,
               const std::vector<int> &face_indices,
               const MeshOptions &opts = MeshOptions());
 
+      // Construct a mesh set from flat buffers: n_vertices * ndim
+      // vertex coordinates, the vertex count of each of n_faces
+      // faces, and the concatenated vertex indices of those faces.
+      MeshSet(const double *coords,
+              size_t n_vertices,
+              const int *face_sizes,
+              size_t n_faces,
+              const int *face_vertices,
+              const MeshOptions &opts = MeshOptions());
+
       // Construct a mesh set from a set of disconnected faces. Takes
       // posession of the face pointers.
       MeshSet(std::vector<face_t *> &faces,
@@ -820,7 +906,8 @@ namespace carve {
               std::vector<mesh_t *> &_meshes);
 
       // This constructor consolidates and rewrites vertex pointers in
-      // each mesh, repointing them to local storage.
+      // each mesh, repointing them to local storage. Meshes with faces
+      // in the arena of another MeshSet are replaced by copies.
       MeshSet(std::vector<mesh_t *> &_meshes);
 
       MeshSet *clone() const;
@@ -846,18 +933,277 @@ namespace carve {
       void canonicalize();
 
       void separateMeshes();
+
+      // Dense element indices, suitable for indexing side tables
+      // (see ElementAttribute). A vertex is indexed by its offset in
+      // vertex_storage. Half-edges and faces are indexed by their id
+      // members, which are assigned in face iteration order by
+      // renumber(). Constructors, clone() and canonicalize() keep the
+      // indices valid; code that adds or removes faces or edges in
+      // place must call renumber() before indices are next used.
+      void renumber();
+
+      size_t vertexIndex(const vertex_t *v) const {
+        CARVE_ASSERT(v >= &vertex_storage[0] && v < &vertex_storage[0] + vertex_storage.size());
+        return (size_t)(v - &vertex_storage[0]);
+      }
+      size_t edgeIndex(const edge_t *e) const { return e->id; }
+      size_t faceIndex(const face_t *f) const { return f->id; }
+
+      size_t vertexCount() const { return vertex_storage.size(); }
+      size_t edgeCount() const { return n_edge_ids; }
+      size_t faceCount() const { return n_face_ids; }
+
+      // Cached face geometry; see FaceGeometry. The cache is built by
+      // the first call to faceGeometry(), and discarded by
+      // transform(), by recalc() of any face, and by renumber().
+      const FaceGeometry<ndim> &faceGeometry();
+
+      // The face geometry cache, or NULL if it has not been built.
+      const FaceGeometry<ndim> *cachedFaceGeometry() const { return face_geometry.get(); }
+
+      void invalidateFaceGeometry() { face_geometry.reset(); }
+    };
+
+
+
+    namespace detail {
+      template<typename elem_t> struct element_index;
+
+      template<unsigned ndim>
+      struct element_index<Vertex<ndim> > {
+        typedef MeshSet<ndim> meshset_t;
+        static size_t count(const meshset_t *m) { return m->vertexCount(); }
+        static size_t index(const meshset_t *m, const Vertex<ndim> *v) { return m->vertexIndex(v); }
+      };
+
+      template<unsigned ndim>
+      struct element_index<Edge<ndim> > {
+        typedef MeshSet<ndim> meshset_t;
+        static size_t count(const meshset_t *m) { return m->edgeCount(); }
+        static size_t index(const meshset_t *m, const Edge<ndim> *e) { return m->edgeIndex(e); }
+      };
+
+      template<unsigned ndim>
+      struct element_index<Face<ndim> > {
+        typedef MeshSet<ndim> meshset_t;
+        static size_t count(const meshset_t *m) { return m->faceCount(); }
+        static size_t index(const meshset_t *m, const Face<ndim> *f) { return m->faceIndex(f); }
+      };
+    }
+
+
+
+    /**
+     * \class ElementAttribute
+     * \brief A value for each vertex, half-edge or face of a MeshSet.
+     *
+     * Stored as a flat array indexed by the dense element indices of
+     * the MeshSet, as a replacement for pointer keyed maps. The array
+     * is sized when it is constructed, and is invalidated by
+     * MeshSet::renumber().
+     *
+     * \tparam elem_t One of Vertex<ndim>, Edge<ndim> or Face<ndim>.
+     * \tparam value_t The attribute type.
+     */
+    template<typename elem_t, typename value_t>
+    class ElementAttribute {
+      typedef detail::element_index<elem_t> index_t;
+      typedef typename index_t::meshset_t meshset_t;
+      typedef std::vector<value_t> container_t;
+
+      const meshset_t *meshset;
+      container_t values;
+
+    public:
+      typedef typename container_t::reference reference;
+      typedef typename container_t::const_reference const_reference;
+      typedef typename container_t::iterator iterator;
+      typedef typename container_t::const_iterator const_iterator;
+
+      ElementAttribute(const meshset_t *_meshset, const value_t &init = value_t()) :
+          meshset(_meshset), values(index_t::count(_meshset), init) {
+      }
+
+      reference operator[](const elem_t *e) { return values[index_t::index(meshset, e)]; }
+      const_reference operator[](const elem_t *e) const { return values[index_t::index(meshset, e)]; }
+
+      reference operator[](size_t i) { return values[i]; }
+      const_reference operator[](size_t i) const { return values[i]; }
+
+      iterator begin() { return values.begin(); }
+      iterator end() { return values.end(); }
+      const_iterator begin() const { return values.begin(); }
+      const_iterator end() const { return values.end(); }
+
+      size_t size() const { return values.size(); }
+
+      void fill(const value_t &v) { std::fill(values.begin(), values.end(), v); }
+    };
+
+
+
+    /**
+     * \class FaceGeometry
+     * \brief Cached geometric data for the faces of a MeshSet.
+     *
+     * Holds, for each face, its bounding box and its extent along its
+     * own normal, and for each half-edge, the projection of its vertex
+     * into the plane of its face. Data are stored as structure of
+     * arrays indexed by the dense face and half-edge indices of the
+     * MeshSet, so that filtering passes over many faces touch only
+     * the values they test. Values are exactly those computed by the
+     * corresponding Face methods.
+     */
+    template<unsigned ndim>
+    class FaceGeometry {
+    public:
+      typedef Face<ndim> face_t;
+      typedef carve::geom::aabb<ndim> aabb_t;
+      typedef carve::geom::vector<2> vector2_t;
+
+      // bounding box centre and half extent, for each axis.
+      std::vector<double> centre[ndim];
+      std::vector<double> extent[ndim];
+
+      // the range of face vertices along the face normal, relative to
+      // the first vertex of the face.
+      std::vector<double> normal_lo;
+      std::vector<double> normal_hi;
+
+      // projected vertex coordinates; the half-edges of a face are
+      // numbered consecutively from face->edge.
+      std::vector<double> proj_x;
+      std::vector<double> proj_y;
+
+      // the vertex indices of each triangular face, in edge order
+      // from face->edge, three to a face. Other faces have
+      // NOT_TRIANGLE as their first index.
+      std::vector<size_t> tri_vertex;
+      const std::vector<Vertex<ndim> > *vertices;
+
+      static const size_t NOT_TRIANGLE = ~(size_t)0;
+
+      FaceGeometry(const MeshSet<ndim> *meshset);
+
+      bool isTriangle(size_t f) const {
+        return tri_vertex[f * 3] != NOT_TRIANGLE;
+      }
+
+      aabb_t getAABB(size_t f) const {
+        aabb_t r;
+        for (unsigned i = 0; i < ndim; ++i) {
+          r.pos.v[i] = centre[i][f];
+          r.extent.v[i] = extent[i][f];
+        }
+        return r;
+      }
+
+      // as aabb_t::maxAxisSeparation().
+      double maxAxisSeparation(size_t f, const aabb_t &other) const {
+        double m = fabs(other.pos.v[0] - centre[0][f]) - extent[0][f] - other.extent.v[0];
+        for (unsigned i = 1; i < ndim; ++i) {
+          m = std::max(m, fabs(other.pos.v[i] - centre[i][f]) - extent[i][f] - other.extent.v[i]);
+        }
+        return m;
+      }
+
+      double maxAxisSeparation(size_t f, const FaceGeometry &other, size_t g) const {
+        double m = fabs(other.centre[0][g] - centre[0][f]) - extent[0][f] - other.extent[0][g];
+        for (unsigned i = 1; i < ndim; ++i) {
+          m = std::max(m, fabs(other.centre[i][g] - centre[i][f]) - extent[i][f] - other.extent[i][g]);
+        }
+        return m;
+      }
+
+      // as face->rangeInDirection(face->plane.N, face->edge->vert->v).
+      std::pair<double, double> normalRange(size_t f) const {
+        return std::make_pair(normal_lo[f], normal_hi[f]);
+      }
+
+      // as face->rangeInDirection(v, b).
+      std::pair<double, double> rangeInDirection(const face_t *face,
+                                                 const typename face_t::vector_t &v,
+                                                 const typename face_t::vector_t &b) const {
+        const size_t *t = &tri_vertex[face->id * 3];
+        if (t[0] == NOT_TRIANGLE) return face->rangeInDirection(v, b);
+
+        double d0 = carve::geom::dot(v, (*vertices)[t[0]].v - b);
+        double d1 = carve::geom::dot(v, (*vertices)[t[1]].v - b);
+        double d2 = carve::geom::dot(v, (*vertices)[t[2]].v - b);
+        return std::make_pair(std::min(std::min(d0, d1), d2), std::max(std::max(d0, d1), d2));
+      }
+
+      // as face->getProjectedTriangle().
+      void getProjectedTriangle(const face_t *face, vector2_t *tri) const {
+        const size_t b = face->edge->id;
+        for (size_t i = 0; i < 3; ++i) {
+          tri[i].x = proj_x[b + i];
+          tri[i].y = proj_y[b + i];
+        }
+      }
+
+      // as face->getProjectedVertices().
+      void getProjectedVertices(const face_t *face, std::vector<vector2_t> &verts) const {
+        const size_t b = face->edge->id, n = face->n_edges;
+        verts.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+          verts[i].x = proj_x[b + i];
+          verts[i].y = proj_y[b + i];
+        }
+      }
     };
 
 
 
     carve::PointClass classifyPoint(
         const carve::mesh::MeshSet<3> *meshset,
-        const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *face_rtree,
+        const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *face_rtree,
         const carve::geom::vector<3> &v,
         bool even_odd = false,
         const carve::mesh::Mesh<3> *mesh = NULL,
         const carve::mesh::Face<3> **hit_face = NULL);
 
+    /** 
+     * \brief Classify a batch of points against a MeshSet.
+     *
+     * Equivalent to calling classifyPoint() for each point, but the
+     * points are visited in spatially coherent (Morton) order, so that
+     * R-tree traversal for the faces surrounding a group of nearby
+     * points is shared, and classification state is reused between
+     * points. When built with OpenMP, groups are classified in
+     * parallel.
+     *
+     * @param[in] meshset The MeshSet to classify against.
+     * @param[in] face_rtree An R-tree of the faces of \a meshset.
+     * @param[in] points The points to classify.
+     * @param[in] n_points The number of points.
+     * @param[out] result The classification of each point; must have room for \a n_points values.
+     * @param[in] even_odd Use the even-odd rule to classify points.
+     * @param[in] mesh If not NULL, only classify against this mesh of \a meshset.
+     */
+    void classifyPoints(
+        const carve::mesh::MeshSet<3> *meshset,
+        const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *face_rtree,
+        const carve::geom::vector<3> *points,
+        size_t n_points,
+        carve::PointClass *result,
+        bool even_odd = false,
+        const carve::mesh::Mesh<3> *mesh = NULL);
+
+    inline void classifyPoints(
+        const carve::mesh::MeshSet<3> *meshset,
+        const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *face_rtree,
+        const std::vector<carve::geom::vector<3> > &points,
+        std::vector<carve::PointClass> &result,
+        bool even_odd = false,
+        const carve::mesh::Mesh<3> *mesh = NULL) {
+      result.resize(points.size());
+      if (points.size()) {
+        classifyPoints(meshset, face_rtree, &points[0], points.size(), &result[0], even_odd, mesh);
+      }
+    }
+
 
 
   }
@@ -154,7 +154,7 @@ namespace carve {
         prev->next = next;
         n = next;
       }
-      delete this;
+      destroy(this);
       return n;
     }
 
@@ -251,7 +251,7 @@ namespace carve {
 
     template<unsigned ndim>
     Edge<ndim>::Edge(vertex_t *_vert, face_t *_face) :
-        vert(_vert), face(_face), prev(NULL), next(NULL), rev(NULL) {
+        arena_owned(false), vert(_vert), face(_face), prev(NULL), next(NULL), rev(NULL), id(0) {
       prev = next = this;
     }
 
@@ -263,10 +263,35 @@ namespace carve {
 
 
 
+    template<unsigned ndim>
+    Edge<ndim> *Edge<ndim>::allocate(carve::Arena *arena, vertex_t *_vert, face_t *_face) {
+      if (arena == NULL) return new Edge(_vert, _face);
+      Edge *e = new (arena->allocate(sizeof(Edge))) Edge(_vert, _face);
+      e->arena_owned = true;
+      return e;
+    }
+
+
+
+    template<unsigned ndim>
+    void Edge<ndim>::destroy(Edge *e) {
+      if (e->arena_owned) {
+        e->~Edge();
+      } else {
+        delete e;
+      }
+    }
+
+
+
     template<unsigned ndim>
     typename Face<ndim>::aabb_t Face<ndim>::getAABB() const {
       aabb_t aabb;
-      aabb.fit(begin(), end(), vector_mapping());
+      if (n_edges == 3) {
+        aabb.fit(edge->vert->v, edge->next->vert->v, edge->prev->vert->v);
+      } else {
+        aabb.fit(begin(), end(), vector_mapping());
+      }
       return aabb;
     }
 
@@ -274,12 +299,26 @@ namespace carve {
 
     template<unsigned ndim>
     bool Face<ndim>::recalc() {
-      if (!carve::geom3d::fitPlane(begin(), end(), vector_mapping(), plane)) {
-        return false;
-      }
+      int da;
+      double A;
+
+      if (n_edges == 3) {
+        const vector_t &a = edge->vert->v;
+        const vector_t &b = edge->next->vert->v;
+        const vector_t &c = edge->prev->vert->v;
+        carve::geom3d::fitPlane(a, b, c, plane);
+
+        da = carve::geom::largestAxis(plane.N);
+        project_t p = getProjector(false, da);
+        A = carve::geom2d::signedArea(p(a), p(b), p(c));
+      } else {
+        if (!carve::geom3d::fitPlane(begin(), end(), vector_mapping(), plane)) {
+          return false;
+        }
 
-      int da = carve::geom::largestAxis(plane.N);
-      double A = carve::geom2d::signedArea(begin(), end(), projection_mapping(getProjector(false, da)));
+        da = carve::geom::largestAxis(plane.N);
+        A = carve::geom2d::signedArea(begin(), end(), projection_mapping(getProjector(false, da)));
+      }
 
       if ((A < 0.0) ^ (plane.N.v[da] < 0.0)) {
         plane.negate();
@@ -288,6 +327,10 @@ namespace carve {
       project = getProjector(plane.N.v[da] > 0, da);
       unproject = getUnprojector(plane.N.v[da] > 0, da);
 
+      if (mesh != NULL && mesh->meshset != NULL) {
+        mesh->meshset->invalidateFaceGeometry();
+      }
+
       return true;
     }
 
@@ -300,7 +343,7 @@ namespace carve {
       edge_t *curr = edge;
       do {
         edge_t *next = curr->next;
-        delete curr;
+        edge_t::destroy(curr);
         curr = next;
       } while (curr != edge);
 
@@ -313,12 +356,12 @@ namespace carve {
 
     template<unsigned ndim>
     template<typename iter_t>
-    void Face<ndim>::loopFwd(iter_t begin, iter_t end) {
+    void Face<ndim>::loopFwd(iter_t begin, iter_t end, carve::Arena *arena) {
       clearEdges();
       if (begin == end) return;
-      edge = new edge_t(*begin, this); ++n_edges; ++begin;
+      edge = edge_t::allocate(arena, *begin, this); ++n_edges; ++begin;
       while (begin != end) {
-        edge_t *e = new edge_t(*begin, this);
+        edge_t *e = edge_t::allocate(arena, *begin, this);
         e->insertAfter(edge->prev);
         ++n_edges;
         ++begin;
@@ -329,12 +372,12 @@ namespace carve {
 
     template<unsigned ndim>
     template<typename iter_t>
-    void Face<ndim>::loopRev(iter_t begin, iter_t end) {
+    void Face<ndim>::loopRev(iter_t begin, iter_t end, carve::Arena *arena) {
       clearEdges();
       if (begin == end) return;
-      edge = new edge_t(*begin, this); ++n_edges; ++begin;
+      edge = edge_t::allocate(arena, *begin, this); ++n_edges; ++begin;
       while (begin != end) {
-        edge_t *e = new edge_t(*begin, this);
+        edge_t *e = edge_t::allocate(arena, *begin, this);
         e->insertBefore(edge->next);
         ++n_edges;
         ++begin;
@@ -453,17 +496,47 @@ namespace carve {
 
 
 
+    template<unsigned ndim>
+    template<typename iter_t>
+    Face<ndim> *Face<ndim>::allocate(carve::Arena &arena, iter_t begin, iter_t end) {
+      Face *r = new (arena.allocate(sizeof(Face))) Face();
+      r->arena_owned = true;
+      r->loopFwd(begin, end, &arena);
+      r->recalc();
+      return r;
+    }
+
+
+
+    template<unsigned ndim>
+    void Face<ndim>::destroy(Face *f) {
+      if (f->arena_owned) {
+        f->~Face();
+      } else {
+        delete f;
+      }
+    }
+
+
+
     template<unsigned ndim>
     Face<ndim> *Face<ndim>::clone(const vertex_t *old_base,
                                   vertex_t *new_base,
-                                  std::unordered_map<const edge_t *, edge_t *> &edge_map) const {
-      Face *r = new Face(*this);
+                                  std::unordered_map<const edge_t *, edge_t *> &edge_map,
+                                  carve::Arena *arena) const {
+      Face *r;
+      if (arena == NULL) {
+        r = new Face(*this);
+      } else {
+        r = new (arena->allocate(sizeof(Face))) Face(*this);
+        r->arena_owned = true;
+      }
 
       edge_t *e = edge;
       edge_t *r_p = NULL;
       edge_t *r_e;
       do {
-        r_e = new edge_t(e->vert - old_base + new_base, r);
+        r_e = edge_t::allocate(arena, e->vert - old_base + new_base, r);
         edge_map[e] = r_e;
         if (r_p) {
           r_p->next = r_e;
@@ -682,7 +755,8 @@ namespace carve {
 
     template<unsigned ndim>
     Mesh<ndim> *Mesh<ndim>::clone(const vertex_t *old_base,
-                                  vertex_t *new_base) const {
+                                  vertex_t *new_base,
+                                  carve::Arena *arena) const {
       std::vector<face_t *> r_faces;
       std::vector<edge_t *> r_open_edges;
       std::vector<edge_t *> r_closed_edges;
@@ -693,7 +767,7 @@ namespace carve {
       r_closed_edges.reserve(r_closed_edges.size());
 
       for (size_t i = 0; i < faces.size(); ++i) {
-        r_faces.push_back(faces[i]->clone(old_base, new_base, edge_map));
+        r_faces.push_back(faces[i]->clone(old_base, new_base, edge_map, arena));
       }
       for (size_t i = 0; i < closed_edges.size(); ++i) {
         r_closed_edges.push_back(edge_map[closed_edges[i]]);
@@ -711,7 +785,7 @@ namespace carve {
     template<unsigned ndim>
     Mesh<ndim>::~Mesh() {
       for (size_t i = 0; i < faces.size(); ++i) {
-        delete faces[i];
+        face_t::destroy(faces[i]);
       }
     }
 
@@ -771,6 +845,8 @@ namespace carve {
       for (size_t i = 0; i < meshes.size(); ++i) {
         meshes[i]->meshset = this;
       }
+
+      renumber();
     }
 
 
@@ -787,6 +863,8 @@ namespace carve {
         vertex_storage.push_back(vertex_t(points[i]));
       }
 
+      arena.reserve(n_faces * sizeof(face_t) + (face_indices.size() - n_faces) * sizeof(edge_t));
+
       std::vector<vertex_t *> v;
       size_t p = 0;
       for (size_t i = 0; i < n_faces; ++i) {
@@ -798,7 +876,7 @@ namespace carve {
         for (size_t j = 0; j < N; ++j) {
           v.push_back(&vertex_storage[face_indices[p++]]);
         }
-        faces.push_back(new face_t(v.begin(), v.end()));
+        faces.push_back(face_t::allocate(arena, v.begin(), v.end()));
       }
       CARVE_ASSERT(p == face_indices.size());
       mesh_t::create(faces.begin(), faces.end(), meshes, opts);
@@ -806,6 +884,53 @@ namespace carve {
       for (size_t i = 0; i < meshes.size(); ++i) {
         meshes[i]->meshset = this;
       }
+
+      renumber();
+    }
+
+
+
+    template<unsigned ndim>
+    MeshSet<ndim>::MeshSet(const double *coords,
+                           size_t n_vertices,
+                           const int *face_sizes,
+                           size_t n_faces,
+                           const int *face_vertices,
+                           const MeshOptions &opts) {
+      vertex_storage.resize(n_vertices);
+      for (size_t i = 0; i < n_vertices; ++i) {
+        for (unsigned j = 0; j < ndim; ++j) {
+          vertex_storage[i].v.v[j] = *coords++;
+        }
+      }
+
+      size_t n_edges = 0;
+      for (size_t i = 0; i < n_faces; ++i) {
+        CARVE_ASSERT(face_sizes[i] > 1);
+        n_edges += (size_t)face_sizes[i];
+      }
+      arena.reserve(n_faces * sizeof(face_t) + n_edges * sizeof(edge_t));
+
+      std::vector<face_t *> faces;
+      faces.reserve(n_faces);
+      std::vector<vertex_t *> v;
+      for (size_t i = 0; i < n_faces; ++i) {
+        const size_t N = (size_t)face_sizes[i];
+        v.resize(N);
+        for (size_t j = 0; j < N; ++j) {
+          CARVE_ASSERT(face_vertices[j] >= 0 && (size_t)face_vertices[j] < n_vertices);
+          v[j] = &vertex_storage[face_vertices[j]];
+        }
+        face_vertices += N;
+        faces.push_back(face_t::allocate(arena, v.begin(), v.end()));
+      }
+      mesh_t::create(faces.begin(), faces.end(), meshes, opts);
+
+      for (size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i]->meshset = this;
+      }
+
+      renumber();
     }
 
 
@@ -833,6 +958,8 @@ namespace carve {
       for (size_t i = 0; i < meshes.size(); ++i) {
         meshes[i]->meshset = this;
       }
+
+      renumber();
     }
 
 
@@ -874,6 +1001,24 @@ namespace carve {
           } while (edge != face->edge);
         }
       }
+
+      // faces in the arena of another meshset do not outlive it, so
+      // meshes holding any are copied into the arena of this one.
+      for (size_t m = 0; m < meshes.size(); ++m) {
+        mesh_t *mesh = meshes[m];
+        bool arena_owned = false;
+        for (size_t f = 0; !arena_owned && f < mesh->faces.size(); ++f) {
+          arena_owned = mesh->faces[f]->isArenaOwned();
+        }
+        if (!arena_owned) continue;
+
+        mesh_t *copy = mesh->clone(&vertex_storage[0], &vertex_storage[0], &arena);
+        copy->meshset = this;
+        delete mesh;
+        meshes[m] = copy;
+      }
+
+      renumber();
     }
 
 
@@ -882,11 +1027,25 @@ namespace carve {
     MeshSet<ndim> *MeshSet<ndim>::clone() const {
       std::vector<vertex_t> r_vertex_storage = vertex_storage;
       std::vector<mesh_t *> r_meshes;
+      carve::Arena r_arena;
+
+      size_t n_faces = 0, n_edges = 0;
       for (size_t i = 0; i < meshes.size(); ++i) {
-        r_meshes.push_back(meshes[i]->clone(&vertex_storage[0], &r_vertex_storage[0]));
+        for (size_t j = 0; j < meshes[i]->faces.size(); ++j) {
+          n_edges += meshes[i]->faces[j]->n_edges;
+        }
+        n_faces += meshes[i]->faces.size();
       }
+      r_arena.reserve(n_faces * sizeof(face_t) + n_edges * sizeof(edge_t));
 
-      return new MeshSet(r_vertex_storage, r_meshes);
+      r_meshes.reserve(meshes.size());
+      for (size_t i = 0; i < meshes.size(); ++i) {
+        r_meshes.push_back(meshes[i]->clone(&vertex_storage[0], &r_vertex_storage[0], &r_arena));
+      }
+
+      MeshSet *r = new MeshSet(r_vertex_storage, r_meshes);
+      r->arena.swap(r_arena);
+      return r;
     }
 
 
@@ -982,6 +1141,92 @@ namespace carve {
 
 
 
+    template<unsigned ndim>
+    void MeshSet<ndim>::renumber() {
+      size_t face_id = 0, edge_id = 0;
+      for (size_t m = 0; m < meshes.size(); ++m) {
+        mesh_t *mesh = meshes[m];
+        for (size_t f = 0; f < mesh->faces.size(); ++f) {
+          face_t *face = mesh->faces[f];
+          face->id = face_id++;
+          edge_t *edge = face->edge;
+          do {
+            edge->id = edge_id++;
+            edge = edge->next;
+          } while (edge != face->edge);
+        }
+      }
+      n_face_ids = face_id;
+      n_edge_ids = edge_id;
+
+      invalidateFaceGeometry();
+    }
+
+
+
+    template<unsigned ndim>
+    const FaceGeometry<ndim> &MeshSet<ndim>::faceGeometry() {
+      if (!face_geometry.get()) {
+        face_geometry.reset(new FaceGeometry<ndim>(this));
+      }
+      return *face_geometry;
+    }
+
+
+
+    template<unsigned ndim>
+    const size_t FaceGeometry<ndim>::NOT_TRIANGLE;
+
+
+
+    template<unsigned ndim>
+    FaceGeometry<ndim>::FaceGeometry(const MeshSet<ndim> *meshset) {
+      const size_t n_faces = meshset->faceCount();
+      const size_t n_edges = meshset->edgeCount();
+
+      for (unsigned i = 0; i < ndim; ++i) {
+        centre[i].resize(n_faces);
+        extent[i].resize(n_faces);
+      }
+      normal_lo.resize(n_faces);
+      normal_hi.resize(n_faces);
+      proj_x.resize(n_edges);
+      proj_y.resize(n_edges);
+      tri_vertex.resize(n_faces * 3, NOT_TRIANGLE);
+      vertices = &meshset->vertex_storage;
+
+      for (typename MeshSet<ndim>::const_face_iter i = meshset->faceBegin(); i != meshset->faceEnd(); ++i) {
+        const face_t *face = *i;
+        const size_t f = face->id;
+
+        aabb_t aabb = face->getAABB();
+        for (unsigned j = 0; j < ndim; ++j) {
+          centre[j][f] = aabb.pos.v[j];
+          extent[j][f] = aabb.extent.v[j];
+        }
+
+        std::pair<double, double> r = face->rangeInDirection(face->plane.N, face->edge->vert->v);
+        normal_lo[f] = r.first;
+        normal_hi[f] = r.second;
+
+        if (face->n_edges == 3) {
+          tri_vertex[f * 3 + 0] = meshset->vertexIndex(face->edge->vert);
+          tri_vertex[f * 3 + 1] = meshset->vertexIndex(face->edge->next->vert);
+          tri_vertex[f * 3 + 2] = meshset->vertexIndex(face->edge->prev->vert);
+        }
+
+        const Edge<ndim> *e = face->edge;
+        do {
+          vector2_t p = face->project(e->vert->v);
+          proj_x[e->id] = p.x;
+          proj_y[e->id] = p.y;
+          e = e->next;
+        } while (e != face->edge);
+      }
+    }
+
+
+
     template<unsigned ndim>
     void MeshSet<ndim>::collectVertices() {
       std::unordered_map<vertex_t *, size_t> vert_idx;
@@ -1021,6 +1266,7 @@ namespace carve {
       }
 
       std::swap(vertex_storage, new_vertex_storage);
+      invalidateFaceGeometry();
     }
 
 
@@ -1054,6 +1300,9 @@ namespace carve {
       }
 
       vertex_storage.swap(vout);
+
+      // face canonicalization moves the first edge of each loop.
+      renumber();
     }
 
 
@@ -1090,6 +1339,7 @@ namespace carve {
       }
 
       vertex_storage.swap(vout);
+      invalidateFaceGeometry();
     }
 
   }
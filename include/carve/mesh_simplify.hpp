@@ -22,7 +22,7 @@
 #include <carve/mesh_ops.hpp>
 #include <carve/geom2d.hpp>
 #include <carve/heap.hpp>
-#include <carve/rtree.hpp>
+#include <carve/flat_rtree.hpp>
 #include <carve/triangle_intersection.hpp>
 
 #include <fstream>
@@ -48,7 +48,7 @@ namespace carve {
       typedef mesh_t::face_t face_t;
       typedef face_t::aabb_t aabb_t;
 
-      typedef carve::geom::RTreeNode<3, carve::mesh::Face<3> *> face_rtree_t;
+      typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
 
 
       struct EdgeInfo {
@@ -429,26 +429,32 @@ namespace carve {
 
 
 
-      int _findSelfIntersections(const face_rtree_t *a_node,
-                                 const face_rtree_t *b_node,
+      int _findSelfIntersections(const face_rtree_t *tree,
+                                 face_rtree_t::index_t a_node,
+                                 face_rtree_t::index_t b_node,
                                  bool descend_a = true) {
         int r = 0;
 
-        if (!a_node->bbox.intersects(b_node->bbox)) {
+        const aabb_t a_bbox = tree->bbox(a_node);
+        const aabb_t b_bbox = tree->bbox(b_node);
+
+        if (!a_bbox.intersects(b_bbox)) {
           return 0;
         }
 
-        if (a_node->child && (descend_a || !b_node->child)) {
-          for (face_rtree_t *node = a_node->child; node; node = node->sibling) {
-            r += _findSelfIntersections(node, b_node, false);
+        if (!tree->isLeaf(a_node) && (descend_a || tree->isLeaf(b_node))) {
+          face_rtree_t::intersecting_children children(*tree, a_node, b_bbox);
+          for (face_rtree_t::index_t node; children.next(node); ) {
+            r += _findSelfIntersections(tree, node, b_node, false);
           }
-        } else if (b_node->child) {
-          for (face_rtree_t *node = b_node->child; node; node = node->sibling) {
-            r += _findSelfIntersections(a_node, node, true);
+        } else if (!tree->isLeaf(b_node)) {
+          face_rtree_t::intersecting_children children(*tree, b_node, a_bbox, true);
+          for (face_rtree_t::index_t node; children.next(node); ) {
+            r += _findSelfIntersections(tree, a_node, node, true);
           }
         } else {
-          for (size_t i = 0; i < a_node->data.size(); ++i) {
-            face_t *fa = a_node->data[i];
+          for (face_rtree_t::data_iter_t i = tree->begin(a_node); i != tree->end(a_node); ++i) {
+            face_t *fa = *i;
             if (fa->nVertices() != 3) continue;
 
             aabb_t aabb_a = fa->getAABB();
@@ -458,10 +464,10 @@ namespace carve {
             tri_a[1] = fa->edge->next->vert->v;
             tri_a[2] = fa->edge->next->next->vert->v;
 
-            if (!aabb_a.intersects(b_node->bbox)) continue;
+            if (!aabb_a.intersects(b_bbox)) continue;
 
-            for (size_t j = 0; j < b_node->data.size(); ++j) {
-              face_t *fb = b_node->data[j];
+            for (face_rtree_t::data_iter_t j = tree->begin(b_node); j != tree->end(b_node); ++j) {
+              face_t *fb = *j;
               if (fb->nVertices() != 3) continue;
 
               vector_t tri_b[3];
@@ -596,7 +602,10 @@ namespace carve {
 
           carve::mesh::flipTriEdge(e->edge);
 
-          tree->updateExtents(aabb);
+          // the flipped faces stay in their leaves; aabb bounds both
+          // of their boxes before the flip.
+          tree->refit(e->edge->face, aabb);
+          tree->refit(e->edge->rev->face, aabb);
 
           updateEdgeFlipHeap(edge_heap, e->edge, flipper);
           updateEdgeFlipHeap(edge_heap, e->edge->rev, flipper);
@@ -615,6 +624,8 @@ namespace carve {
 
         delete tree;
 
+        mesh->renumber();
+
         return n_mods;
       }
 
@@ -859,6 +870,8 @@ namespace carve {
 
         delete tree;
 
+        mesh->renumber();
+
         return n_mods;
       }
 
@@ -897,8 +910,8 @@ namespace carve {
             do {
               edge_t *n = e->next;
               coplanar_face_edges.erase(std::min(e, e->rev));
-              delete e->rev;
-              delete e;
+              edge_t::destroy(e->rev);
+              edge_t::destroy(e);
               e = n;
             } while (e != removed);
           }
@@ -1087,6 +1100,7 @@ namespace carve {
         for (size_t i = 0; i < mesh->meshes.size(); ++i) {
           n_removed += cleanFaceEdges(mesh->meshes[i]);
         }
+        mesh->renumber();
         return n_removed;
       }
 
@@ -1096,7 +1110,7 @@ namespace carve {
         size_t n = 0;
         for (size_t i = 0; i < mesh->faces.size(); ++i) {
           if (mesh->faces[i]->nEdges() == 0) {
-            delete mesh->faces[i];
+            face_t::destroy(mesh->faces[i]);
           } else {
             mesh->faces[n++] = mesh->faces[i];
           }
@@ -1110,6 +1124,8 @@ namespace carve {
         for (size_t i = 0; i < mesh->meshes.size(); ++i) {
           removeRemnantFaces(mesh->meshes[i]);
         }
+
+        mesh->renumber();
       }
 
 
@@ -1174,6 +1190,7 @@ namespace carve {
           cleanFaceEdges(meshset->meshes[i]);
           meshset->meshes[i]->cacheEdges();
         }
+        meshset->renumber();
         return n_removed;
       }
 
@@ -1336,6 +1353,8 @@ namespace carve {
             vert->v = v_best;
           }
         }
+
+        meshset->renumber();
       }
 
 
@@ -1408,6 +1427,7 @@ namespace carve {
         for (size_t i = 0; i < meshset->meshes.size(); ++i) {
           n_removed += removeFins(meshset->meshes[i]);
         }
+        meshset->renumber();
         return n_removed;
       }
 
@@ -1426,6 +1446,7 @@ namespace carve {
                                              meshset->meshes.end(),
                                              std::bind2nd(std::equal_to<mesh_t *>(), (mesh_t *)NULL)),
                               meshset->meshes.end());
+        meshset->renumber();
         return n_removed;
       }
 
@@ -1566,6 +1587,8 @@ namespace carve {
 
           if (!quantized.size()) break;
         }
+
+        meshset->renumber();
       }
 
 
@@ -0,0 +1,269 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/geom.hpp>
+#include <carve/aabb.hpp>
+
+#include <vector>
+#include <limits>
+#include <cmath>
+
+// The number of boxes tested together by packed_aabb::intersectsBlock()
+// depends on the instruction set targeted by the compiler: 8 for
+// AVX-512, otherwise 4, using AVX, SSE2 or scalar code.
+#if defined(__AVX512F__)
+#  include <immintrin.h>
+#  define CARVE_PACKED_AABB_WIDTH 8
+#elif defined(__AVX__)
+#  include <immintrin.h>
+#  define CARVE_PACKED_AABB_WIDTH 4
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define CARVE_PACKED_AABB_SSE2
+#  define CARVE_PACKED_AABB_WIDTH 4
+#else
+#  define CARVE_PACKED_AABB_WIDTH 4
+#endif
+
+namespace carve {
+  namespace geom {
+
+    /**
+     * \class packed_aabb
+     * \brief A sequence of axis aligned bounding boxes, stored as
+     * structure of arrays so that a query box can be tested against
+     * several of them at once.
+     *
+     * Boxes are tested in blocks of WIDTH. The test for each box is
+     * exactly that of aabb::intersects(const aabb &), so results do
+     * not depend on the instruction set in use. Storage is padded to
+     * a multiple of the largest block width with boxes that intersect
+     * nothing.
+     */
+    template<unsigned ndim>
+    class packed_aabb {
+    public:
+      typedef aabb<ndim> aabb_t;
+      typedef vector<ndim> vector_t;
+
+      static const size_t WIDTH = CARVE_PACKED_AABB_WIDTH;
+
+    private:
+      static const size_t PAD = 8;
+
+      // centres of each box along axis i are at [i * stride], and
+      // extents at [(ndim + i) * stride].
+      std::vector<double> data;
+      size_t n;
+      size_t stride;
+
+      const double *centre(unsigned axis) const { return &data[axis * stride]; }
+      const double *extent(unsigned axis) const { return &data[(ndim + axis) * stride]; }
+
+    public:
+      packed_aabb() : data(), n(0), stride(0) {
+      }
+
+      size_t size() const { return n; }
+
+      bool empty() const { return n == 0; }
+
+      // the heap footprint of the boxes, in bytes.
+      size_t memoryUsed() const { return data.capacity() * sizeof(double); }
+
+      void clear() {
+        data.clear();
+        n = stride = 0;
+      }
+
+      /**
+       * \brief Resize to \a _n boxes, all of which intersect nothing until set.
+       *
+       * @param[in] _n The number of boxes.
+       * @param[in] slack The number of padding boxes required after
+       *            the last. A slack of WIDTH - 1 allows intersectsAt()
+       *            to be called for any box.
+       */
+      void resize(size_t _n, size_t slack = 0) {
+        n = _n;
+        stride = (n + slack + PAD - 1) / PAD * PAD;
+        data.assign(2 * ndim * stride, 0.0);
+        for (unsigned i = 0; i < ndim; ++i) {
+          std::fill(data.begin() + i * stride, data.begin() + (i + 1) * stride,
+                    std::numeric_limits<double>::infinity());
+        }
+      }
+
+      void set(size_t i, const aabb_t &box) {
+        CARVE_ASSERT(i < n);
+        for (unsigned j = 0; j < ndim; ++j) {
+          data[j * stride + i] = box.pos.v[j];
+          data[(ndim + j) * stride + i] = box.extent.v[j];
+        }
+      }
+
+      aabb_t get(size_t i) const {
+        CARVE_ASSERT(i < n);
+        aabb_t box;
+        for (unsigned j = 0; j < ndim; ++j) {
+          box.pos.v[j] = data[j * stride + i];
+          box.extent.v[j] = data[(ndim + j) * stride + i];
+        }
+        return box;
+      }
+
+      /// As get(i).intersects(q), or q.intersects(get(i)) if \a query_first.
+      bool intersects(size_t i, const aabb_t &q, bool query_first = false) const {
+        for (unsigned j = 0; j < ndim; ++j) {
+          double d = fabs(q.pos.v[j] - centre(j)[i]);
+          d = query_first ? d - q.extent.v[j] - extent(j)[i] : d - extent(j)[i] - q.extent.v[j];
+          if (!(d <= 0.0)) return false;
+        }
+        return true;
+      }
+
+      /// The number of blocks of WIDTH boxes.
+      size_t blocks() const { return (n + WIDTH - 1) / WIDTH; }
+
+      /**
+       * \brief Test a block of boxes against \a q.
+       *
+       * @param[in] block The block index.
+       * @param[in] q The query box.
+       * @param[in] query_first If true, test as q.intersects(get(i))
+       *            rather than get(i).intersects(q). The two sum
+       *            extents in a different order, and so can differ in
+       *            the last bit for boxes that just touch.
+       *
+       * @return A mask in which bit i is set if box (block * WIDTH +
+       *         i) intersects \a q.
+       */
+      unsigned intersectsBlock(size_t block, const aabb_t &q, bool query_first = false) const {
+        return intersectsAt(block * WIDTH, q, query_first);
+      }
+
+      /**
+       * \brief Test the WIDTH boxes starting at box \a first against \a q.
+       *
+       * Boxes past the end of the sequence may only be tested if
+       * enough slack was requested when resizing.
+       *
+       * @return A mask in which bit i is set if box (first + i)
+       *         intersects \a q.
+       */
+      unsigned intersectsAt(size_t first, const aabb_t &q, bool query_first = false) const;
+    };
+
+
+
+    template<unsigned ndim>
+    const size_t packed_aabb<ndim>::WIDTH;
+
+    template<unsigned ndim>
+    const size_t packed_aabb<ndim>::PAD;
+
+
+
+#if defined(__AVX512F__)
+
+    template<unsigned ndim>
+    inline unsigned packed_aabb<ndim>::intersectsAt(size_t first, const aabb_t &q, bool query_first) const {
+      const __m512d zero = _mm512_setzero_pd();
+      __mmask8 mask = 0xff;
+      for (unsigned j = 0; j < ndim && mask; ++j) {
+        __m512d d = _mm512_sub_pd(_mm512_set1_pd(q.pos.v[j]), _mm512_loadu_pd(centre(j) + first));
+        const __m512d e = _mm512_loadu_pd(extent(j) + first);
+        const __m512d qe = _mm512_set1_pd(q.extent.v[j]);
+        d = _mm512_abs_pd(d);
+        d = _mm512_sub_pd(_mm512_sub_pd(d, query_first ? qe : e), query_first ? e : qe);
+        mask = _mm512_mask_cmp_pd_mask(mask, d, zero, _CMP_LE_OQ);
+      }
+      return (unsigned)mask;
+    }
+
+#elif defined(__AVX__)
+
+    template<unsigned ndim>
+    inline unsigned packed_aabb<ndim>::intersectsAt(size_t first, const aabb_t &q, bool query_first) const {
+      const __m256d zero = _mm256_setzero_pd();
+      const __m256d sign = _mm256_set1_pd(-0.0);
+      __m256d in = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+      for (unsigned j = 0; j < ndim; ++j) {
+        __m256d d = _mm256_sub_pd(_mm256_set1_pd(q.pos.v[j]), _mm256_loadu_pd(centre(j) + first));
+        const __m256d e = _mm256_loadu_pd(extent(j) + first);
+        const __m256d qe = _mm256_set1_pd(q.extent.v[j]);
+        d = _mm256_andnot_pd(sign, d);
+        d = _mm256_sub_pd(_mm256_sub_pd(d, query_first ? qe : e), query_first ? e : qe);
+        in = _mm256_and_pd(in, _mm256_cmp_pd(d, zero, _CMP_LE_OQ));
+      }
+      return (unsigned)_mm256_movemask_pd(in);
+    }
+
+#elif defined(CARVE_PACKED_AABB_SSE2)
+
+    template<unsigned ndim>
+    inline unsigned packed_aabb<ndim>::intersectsAt(size_t first, const aabb_t &q, bool query_first) const {
+      const __m128d zero = _mm_setzero_pd();
+      const __m128d sign = _mm_set1_pd(-0.0);
+      __m128d in_lo = _mm_castsi128_pd(_mm_set1_epi32(-1));
+      __m128d in_hi = in_lo;
+      for (unsigned j = 0; j < ndim; ++j) {
+        const __m128d qc = _mm_set1_pd(q.pos.v[j]);
+        const __m128d qe = _mm_set1_pd(q.extent.v[j]);
+        const __m128d e_lo = _mm_loadu_pd(extent(j) + first);
+        const __m128d e_hi = _mm_loadu_pd(extent(j) + first + 2);
+        __m128d d_lo = _mm_andnot_pd(sign, _mm_sub_pd(qc, _mm_loadu_pd(centre(j) + first)));
+        __m128d d_hi = _mm_andnot_pd(sign, _mm_sub_pd(qc, _mm_loadu_pd(centre(j) + first + 2)));
+        if (query_first) {
+          d_lo = _mm_sub_pd(_mm_sub_pd(d_lo, qe), e_lo);
+          d_hi = _mm_sub_pd(_mm_sub_pd(d_hi, qe), e_hi);
+        } else {
+          d_lo = _mm_sub_pd(_mm_sub_pd(d_lo, e_lo), qe);
+          d_hi = _mm_sub_pd(_mm_sub_pd(d_hi, e_hi), qe);
+        }
+        in_lo = _mm_and_pd(in_lo, _mm_cmple_pd(d_lo, zero));
+        in_hi = _mm_and_pd(in_hi, _mm_cmple_pd(d_hi, zero));
+      }
+      return (unsigned)(_mm_movemask_pd(in_lo) | (_mm_movemask_pd(in_hi) << 2));
+    }
+
+#else
+
+    template<unsigned ndim>
+    inline unsigned packed_aabb<ndim>::intersectsAt(size_t first, const aabb_t &q, bool query_first) const {
+      unsigned mask = (1U << WIDTH) - 1;
+      for (unsigned j = 0; j < ndim; ++j) {
+        const double *c = centre(j) + first;
+        const double *e = extent(j) + first;
+        const double qc = q.pos.v[j], qe = q.extent.v[j];
+        for (size_t i = 0; i < WIDTH; ++i) {
+          double d = fabs(qc - c[i]);
+          d = query_first ? d - qe - e[i] : d - e[i] - qe;
+          mask &= ~((unsigned)!(d <= 0.0) << i);
+        }
+      }
+      return mask;
+    }
+
+#endif
+
+  }
+}
@@ -21,15 +21,274 @@
 
 #include <carve/geom.hpp>
 #include <carve/aabb.hpp>
+#include <carve/packed_aabb.hpp>
 
 #include <iostream>
 
 #include <cmath>
 #include <limits>
 
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
 namespace carve {
   namespace geom {
 
+    namespace detail {
+
+      // the number of entries below which R-tree construction is
+      // not worth splitting between threads.
+      const size_t PARALLEL_BUILD_MIN = 8192;
+
+      // true if a construction step over n entries should be split
+      // between threads. Steps nested in a parallel step are serial.
+      inline bool parallelBuild(size_t n) {
+#if defined(_OPENMP)
+        return n >= PARALLEL_BUILD_MIN && !omp_in_parallel() && omp_get_max_threads() > 1;
+#else
+        return false;
+#endif
+      }
+
+      /**
+       * \brief Append a (data, aabb) pair for each of a sequence of
+       *        data to \a out.
+       *
+       * Bounding boxes of long sequences are computed in parallel, so
+       * the aabb calculator of data_aabb_t must be safe to call from
+       * several threads at once.
+       */
+      template<typename data_aabb_t, typename iter_t>
+      void appendDataAABBs(iter_t begin, iter_t end, std::vector<data_aabb_t> &out) {
+        const size_t base = out.size();
+        for (iter_t i = begin; i != end; ++i) {
+          out.push_back(data_aabb_t());
+          out.back().data = *i;
+        }
+        const int n = (int)(out.size() - base);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static) if (parallelBuild(n))
+#endif
+        for (int i = 0; i < n; ++i) {
+          out[base + i] = data_aabb_t(out[base + i].data);
+        }
+      }
+
+      // orders entries by increasing aabb midpoint along an axis.
+      template<typename bbox_of_t>
+      struct str_cmp_mid {
+        size_t dim;
+        bbox_of_t bbox_of;
+        str_cmp_mid(size_t _dim, bbox_of_t _bbox_of) : dim(_dim), bbox_of(_bbox_of) { }
+
+        template<typename entry_t>
+        bool operator()(const entry_t &a, const entry_t &b) const {
+          return bbox_of(a).mid(dim) < bbox_of(b).mid(dim);
+        }
+      };
+
+      /**
+       * \brief Sort-Tile-Recursive partitioning of a range of entries
+       *        into runs that become the nodes of one level of an R-tree.
+       *
+       * The range is reordered so that each run is contiguous, by
+       * recursively sorting along the sparsest remaining axis and
+       * splitting into slabs.
+       *
+       * @param[in] begin, end The entries to partition.
+       * @param[in] dim_num The number of axes already split along.
+       * @param[in] dim_mask The axes already split along.
+       * @param[in] child_size The maximum number of entries in a run.
+       * @param[in] bbox_of Maps an entry to its bounding box.
+       * @param[out] ends The offset from \a begin of the end of each run,
+       *             plus \a base.
+       * @param[in] base The offset of \a begin within the full range.
+       */
+      template<unsigned ndim, typename iter_t, typename bbox_of_t>
+      void partitionSTR(const iter_t begin,
+                        const iter_t end,
+                        size_t dim_num,
+                        uint32_t dim_mask,
+                        size_t child_size,
+                        bbox_of_t bbox_of,
+                        std::vector<size_t> &ends,
+                        size_t base = 0) {
+        const size_t N = std::distance(begin, end);
+
+        size_t dim = ndim;
+        double r_best = N+1;
+
+        // find the sparsest remaining dimension to partition by.
+        for (size_t i = 0; i < ndim; ++i) {
+          if (dim_mask & (1U << i)) continue;
+          double dmin, dmax, dsum;
+
+          dmin = bbox_of(*begin).pos.v[i] - bbox_of(*begin).extent.v[i];
+          dmax = bbox_of(*begin).pos.v[i] + bbox_of(*begin).extent.v[i];
+          dsum = 0.0;
+          for (iter_t j = begin; j != end; ++j) {
+            const aabb<ndim> &box = bbox_of(*j);
+            dmin = std::min(dmin, box.pos.v[i] - box.extent.v[i]);
+            dmax = std::max(dmax, box.pos.v[i] + box.extent.v[i]);
+            dsum += 2.0 * box.extent.v[i];
+          }
+          double r = dsum ? dsum / (dmax - dmin) : 0.0;
+          if (r_best > r) {
+            dim = i;
+            r_best = r;
+          }
+        }
+
+        CARVE_ASSERT(dim < ndim);
+
+        const size_t P = (N + child_size - 1) / child_size;
+        const size_t n_parts = (size_t)std::ceil(std::pow((double)P, 1.0 / (ndim - dim_num)));
+
+        std::sort(begin, end, str_cmp_mid<bbox_of_t>(dim, bbox_of));
+
+        if (dim_num == ndim - 1 || n_parts == 1) {
+          for (size_t i = 0, s = 0, e = 0; i < P; ++i, s = e) {
+            e = N * (i+1) / P;
+            CARVE_ASSERT(e - s <= child_size);
+            ends.push_back(base + e);
+          }
+        } else if (parallelBuild(N)) {
+          // the slabs are independent, and each is sorted and
+          // partitioned by its own thread. runs are gathered in slab
+          // order, as a serial build produces them.
+          std::vector<std::vector<size_t> > slab_ends(n_parts);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+          for (int i = 0; i < (int)n_parts; ++i) {
+            const size_t s = N * i / n_parts;
+            const size_t e = N * (i+1) / n_parts;
+            partitionSTR<ndim>(begin + s, begin + e, dim_num + 1, dim_mask | (1U << dim), child_size, bbox_of, slab_ends[i], base + s);
+          }
+          for (size_t i = 0; i < n_parts; ++i) {
+            ends.insert(ends.end(), slab_ends[i].begin(), slab_ends[i].end());
+          }
+        } else {
+          for (size_t i = 0, s = 0, e = 0; i < n_parts; ++i, s = e) {
+            e = N * (i+1) / n_parts;
+            partitionSTR<ndim>(begin + s, begin + e, dim_num + 1, dim_mask | (1U << dim), child_size, bbox_of, ends, base + s);
+          }
+        }
+      }
+
+      // the volume of the intersection of two boxes.
+      template<unsigned ndim>
+      double overlapVolume(const aabb<ndim> &a, const aabb<ndim> &b) {
+        double v = 1.0;
+        for (unsigned i = 0; i < ndim; ++i) {
+          const double d = std::min(a.max(i), b.max(i)) - std::max(a.min(i), b.min(i));
+          if (!(d > 0.0)) return 0.0;
+          v *= d;
+        }
+        return v;
+      }
+
+      // orders entries by increasing lower, or upper, bound along an axis.
+      template<typename bbox_of_t>
+      struct rstar_cmp {
+        size_t dim;
+        bool upper;
+        bbox_of_t bbox_of;
+        rstar_cmp(size_t _dim, bool _upper, bbox_of_t _bbox_of) : dim(_dim), upper(_upper), bbox_of(_bbox_of) { }
+
+        template<typename entry_t>
+        bool operator()(const entry_t &a, const entry_t &b) const {
+          return upper ? bbox_of(a).max(dim) < bbox_of(b).max(dim) : bbox_of(a).min(dim) < bbox_of(b).min(dim);
+        }
+      };
+
+      // lo[i] bounds entries [0, i], and hi[i] entries [i, N).
+      template<unsigned ndim, typename entry_t, typename bbox_of_t>
+      void boundRuns(const std::vector<entry_t> &entries,
+                     bbox_of_t bbox_of,
+                     std::vector<aabb<ndim> > &lo,
+                     std::vector<aabb<ndim> > &hi) {
+        const size_t N = entries.size();
+        lo[0] = bbox_of(entries[0]);
+        for (size_t i = 1; i < N; ++i) {
+          lo[i] = lo[i - 1];
+          lo[i].unionAABB(bbox_of(entries[i]));
+        }
+        hi[N - 1] = bbox_of(entries[N - 1]);
+        for (size_t i = N - 1; i > 0; --i) {
+          hi[i - 1] = hi[i];
+          hi[i - 1].unionAABB(bbox_of(entries[i - 1]));
+        }
+      }
+
+      /**
+       * \brief R*-tree split of the entries of an overflowing node
+       *        into two groups.
+       *
+       * Entries are sorted by lower and by upper bound along each
+       * axis. The split axis is the one for which the candidate
+       * groups have the least summed margin (the sum of box extents).
+       * Along it, the candidate with the least overlap between
+       * groups, then the least summed surface area, is chosen.
+       * Surface area rather than volume breaks ties, as the boxes of
+       * axis aligned faces are flat.
+       *
+       * @param[in,out] entries The entries, reordered so that the
+       *                first group precedes the second.
+       * @param[in] min_fill The minimum number of entries in a group.
+       * @param[in] bbox_of Maps an entry to its bounding box.
+       *
+       * @return The number of entries in the first group.
+       */
+      template<unsigned ndim, typename entry_t, typename bbox_of_t>
+      size_t splitRStar(std::vector<entry_t> &entries, size_t min_fill, bbox_of_t bbox_of) {
+        const size_t N = entries.size();
+        CARVE_ASSERT(min_fill >= 1 && 2 * min_fill <= N);
+
+        std::vector<entry_t> sorted(entries);
+        std::vector<aabb<ndim> > lo(N), hi(N);
+
+        size_t axis = 0;
+        double best_margin = std::numeric_limits<double>::max();
+        for (size_t dim = 0; dim < ndim; ++dim) {
+          double margin = 0.0;
+          for (int upper = 0; upper < 2; ++upper) {
+            std::sort(sorted.begin(), sorted.end(), rstar_cmp<bbox_of_t>(dim, upper != 0, bbox_of));
+            boundRuns(sorted, bbox_of, lo, hi);
+            for (size_t k = min_fill; k <= N - min_fill; ++k) {
+              for (unsigned i = 0; i < ndim; ++i) margin += lo[k - 1].extent.v[i] + hi[k].extent.v[i];
+            }
+          }
+          if (margin < best_margin) {
+            axis = dim;
+            best_margin = margin;
+          }
+        }
+
+        size_t split = 0;
+        double best_overlap = 0.0, best_area = 0.0;
+        for (int upper = 0; upper < 2; ++upper) {
+          std::sort(sorted.begin(), sorted.end(), rstar_cmp<bbox_of_t>(axis, upper != 0, bbox_of));
+          boundRuns(sorted, bbox_of, lo, hi);
+          for (size_t k = min_fill; k <= N - min_fill; ++k) {
+            const double overlap = overlapVolume(lo[k - 1], hi[k]);
+            const double area = lo[k - 1].surfaceArea() + hi[k].surfaceArea();
+            if (!split || overlap < best_overlap || (overlap == best_overlap && area < best_area)) {
+              split = k;
+              best_overlap = overlap;
+              best_area = area;
+              entries = sorted;
+            }
+          }
+        }
+        return split;
+      }
+
+    }
+
+
+
     template<unsigned ndim,
              typename data_t,
              typename aabb_calc_t = carve::geom::get_aabb<ndim, data_t> >
@@ -43,8 +302,62 @@ namespace carve {
       node_t *sibling;
       std::vector<data_t> data;
 
+      // the bounding boxes of the children of an internal node, in
+      // sibling order, packed so that a query can be tested against
+      // several children at once. Empty for leaves.
+      packed_aabb<ndim> child_bbox;
+
       aabb_t getAABB() const { return bbox; }
 
+      // refresh child_bbox from the bounding boxes of the children.
+      void packChildren() {
+        size_t n = 0;
+        for (node_t *node = child; node; node = node->sibling) ++n;
+        child_bbox.resize(n);
+        n = 0;
+        for (node_t *node = child; node; node = node->sibling) child_bbox.set(n++, node->bbox);
+      }
+
+      /**
+       * \class intersecting_children
+       * \brief Visits, in sibling order, the children of a node whose
+       * bounding boxes intersect a query box.
+       *
+       * Child boxes are tested a block at a time from the packed
+       * child bounds of the parent. Visiting the children of a node
+       * this way is equivalent to testing node->bbox.intersects(obj)
+       * for each child in turn, or obj.intersects(node->bbox) if
+       * query_first is true.
+       */
+      class intersecting_children {
+        const node_t *parent;
+        const aabb_t &obj;
+        bool query_first;
+        const node_t *node;
+        size_t index;
+        unsigned mask;
+
+      public:
+        intersecting_children(const node_t *_parent, const aabb_t &_obj, bool _query_first = false) :
+            parent(_parent), obj(_obj), query_first(_query_first), node(_parent->child), index(0), mask(0) {
+        }
+
+        // the next intersecting child, or NULL.
+        const node_t *next() {
+          while (node) {
+            const size_t lane = index % packed_aabb<ndim>::WIDTH;
+            if (lane == 0) {
+              mask = parent->child_bbox.intersectsBlock(index / packed_aabb<ndim>::WIDTH, obj, query_first);
+            }
+            const node_t *curr = node;
+            node = node->sibling;
+            ++index;
+            if (mask & (1U << lane)) return curr;
+          }
+          return NULL;
+        }
+      };
+
       struct data_aabb_t {
         aabb_t bbox;
         data_t data;
@@ -92,6 +405,7 @@ namespace carve {
           curr = curr->sibling;
         }
         bbox.fit(begin, end);
+        packChildren();
       }
 
       // Search the rtree for objects that intersect obj (generally an aabb).
@@ -108,6 +422,31 @@ namespace carve {
         }
       }
 
+      // Search the rtree for objects whose bounding boxes intersect an
+      // aabb, testing the children of each node together.
+      template<typename out_iter_t>
+      void search(const aabb_t &obj, out_iter_t out) const {
+        if (!bbox.intersects(obj)) return;
+        _search(obj, out);
+      }
+
+      template<typename out_iter_t>
+      void search(const vector_t &obj, out_iter_t out) const {
+        search(aabb_t(obj), out);
+      }
+
+      template<typename out_iter_t>
+      void _search(const aabb_t &obj, out_iter_t &out) const {
+        if (child) {
+          intersecting_children children(this, obj);
+          for (const node_t *node; (node = children.next()) != NULL; ) {
+            node->_search(obj, out);
+          }
+        } else {
+          out = std::copy(data.begin(), data.end(), out);
+        }
+      }
+
       // update the bounding box extents of nodes that intersect obj (generally an aabb).
       // The aabb class must provide a method intersects(obj_t).
       template<typename obj_t>
@@ -122,25 +461,37 @@ namespace carve {
             node->updateExtents(obj);
             bbox.unionAABB(node->bbox);
           }
+          packChildren();
         } else {
           bbox.fit(data.begin(), data.end());
         }
       }
 
-      // update the bounding box extents of nodes that intersect obj (generally an aabb).
-      // The aabb class must provide a method intersects(obj_t).
+      // remove val, whose bounding box when inserted or last updated
+      // was val_aabb, from the leaf that holds it. Nodes left empty
+      // are unlinked from the tree.
       bool remove(const data_t &val, const aabb_t &val_aabb) {
         if (!bbox.intersects(val_aabb)) return false;
 
         if (child) {
-          node_t *node = child;
-          node->remove(val, val_aabb);
-          bbox = node->bbox;
           bool removed = false;
-          for (node = node->sibling; node; node = node->sibling) {
+          for (node_t *node = child; node; node = node->sibling) {
             if (!removed) removed = node->remove(val, val_aabb);
-            bbox.unionAABB(node->bbox);
           }
+          if (removed) {
+            node_t **link = &child;
+            while (*link) {
+              node_t *node = *link;
+              if (node->isEmpty()) {
+                *link = node->sibling;
+                node->sibling = NULL;
+                delete node;
+              } else {
+                link = &node->sibling;
+              }
+            }
+          }
+          _refitNode();
           return removed;
         } else {
           typename std::vector<data_t>::iterator i = std::remove(data.begin(), data.end(), val);
@@ -153,8 +504,180 @@ namespace carve {
         }
       }
 
+      // true for a leaf with no data.
+      bool isEmpty() const { return !child && data.empty(); }
+
+      // recompute the bounding box of this node from its children or data.
+      void _refitNode() {
+        if (child) {
+          bbox = child->bbox;
+          for (node_t *node = child->sibling; node; node = node->sibling) {
+            bbox.unionAABB(node->bbox);
+          }
+          packChildren();
+        } else {
+          bbox.fit(data.begin(), data.end());
+        }
+      }
+
+      // the minimum number of entries in each half of a split node
+      // of capacity max_size: 40% as in the R*-tree, and at least 2
+      // where the node has room.
+      static size_t minFill(size_t max_size) {
+        return std::min((max_size + 1) / 2, std::max<size_t>(2, (max_size + 1) * 2 / 5));
+      }
+
+      // the child into which an entry with bounding box val_aabb is
+      // inserted. Above leaves, the child whose box needs least
+      // enlargement is chosen; directly above leaves, the one whose
+      // enlargement adds least overlap with its siblings.
+      node_t *_chooseSubtree(const aabb_t &val_aabb) const {
+        bool above_leaves = true;
+        for (node_t *node = child; node; node = node->sibling) {
+          if (node->child) above_leaves = false;
+        }
+
+        node_t *best = NULL;
+        double best_overlap = 0.0, best_growth = 0.0, best_area = 0.0;
+        for (node_t *node = child; node; node = node->sibling) {
+          aabb_t grown = node->bbox;
+          grown.unionAABB(val_aabb);
+          const double area = node->bbox.surfaceArea();
+          const double growth = grown.surfaceArea() - area;
+          double overlap = 0.0;
+          if (above_leaves) {
+            for (node_t *other = child; other; other = other->sibling) {
+              if (other == node) continue;
+              overlap += detail::overlapVolume(grown, other->bbox) - detail::overlapVolume(node->bbox, other->bbox);
+            }
+          }
+          if (!best ||
+              overlap < best_overlap ||
+              (overlap == best_overlap && (growth < best_growth ||
+                                           (growth == best_growth && area < best_area)))) {
+            best = node;
+            best_overlap = overlap;
+            best_growth = growth;
+            best_area = area;
+          }
+        }
+        return best;
+      }
+
+      // insert val below this node, returning the new sibling of this
+      // node if it had to be split, or NULL.
+      node_t *_insert(const data_t &val, const aabb_t &val_aabb, size_t leaf_size, size_t internal_size) {
+        if (!child) {
+          data.push_back(val);
+          if (data.size() <= leaf_size) {
+            bbox.fit(data.begin(), data.end());
+            return NULL;
+          }
+
+          std::vector<data_aabb_t> entries;
+          entries.reserve(data.size());
+          for (size_t i = 0; i < data.size(); ++i) entries.push_back(data_aabb_t(data[i]));
+          const size_t k = detail::splitRStar<ndim>(entries, minFill(leaf_size), bbox_of());
+
+          data.clear();
+          _fill(entries.begin(), entries.begin() + k, data_aabb_t());
+          return new node_t(entries.begin() + k, entries.end());
+        }
+
+        node_t *node = _chooseSubtree(val_aabb);
+        node_t *split = node->_insert(val, val_aabb, leaf_size, internal_size);
+        if (split) {
+          split->sibling = node->sibling;
+          node->sibling = split;
+        }
+
+        std::vector<node_t *> entries;
+        for (node = child; node; node = node->sibling) entries.push_back(node);
+        if (entries.size() <= internal_size) {
+          _refitNode();
+          return NULL;
+        }
+
+        const size_t k = detail::splitRStar<ndim>(entries, minFill(internal_size), bbox_of());
+        for (size_t i = 0; i < entries.size(); ++i) entries[i]->sibling = NULL;
+
+        _fill(entries.begin(), entries.begin() + k, (node_t *)NULL);
+        return new node_t(entries.begin() + k, entries.end());
+      }
+
+      /**
+       * \brief Insert val, R*-tree style.
+       *
+       * The leaf to hold val is chosen by least overlap, then least
+       * enlargement, and overflowing nodes are split along the axis
+       * and at the position that minimise margin and overlap. If the
+       * root splits, the tree grows a level below this node, so
+       * pointers to the root remain valid.
+       *
+       * @param[in] val The value to insert.
+       * @param[in] leaf_size The maximum number of entries in a leaf.
+       * @param[in] internal_size The maximum number of children of an
+       *            internal node; at least 2.
+       */
+      void insert(const data_t &val, size_t leaf_size, size_t internal_size) {
+        CARVE_ASSERT(leaf_size >= 1 && internal_size >= 2);
+
+        node_t *split = _insert(val, aabb_calc_t()(val), leaf_size, internal_size);
+        if (!split) return;
+
+        node_t *node = new node_t;
+        node->child = child;
+        node->data.swap(data);
+        node->_refitNode();
+        node->sibling = split;
+        child = node;
+        _refitNode();
+      }
+
+      // recompute the bounding boxes of all nodes, bottom up, after
+      // the bounding boxes of the data have changed.
+      void refit() {
+        for (node_t *node = child; node; node = node->sibling) node->refit();
+        _refitNode();
+      }
+
+      /**
+       * \brief Recompute the bounding boxes of the nodes between this
+       *        node and the leaf holding val, after the bounding box of
+       *        val has changed.
+       *
+       * Refitting keeps val in its leaf, so the tree degrades if
+       * values move far; remove() and insert() them instead.
+       *
+       * @param[in] val The value whose bounding box has changed.
+       * @param[in] old_aabb The bounding box of val when inserted or
+       *            last refitted.
+       *
+       * @return true if val was found.
+       */
+      bool refit(const data_t &val, const aabb_t &old_aabb) {
+        if (!bbox.intersects(old_aabb)) return false;
+
+        if (child) {
+          for (node_t *node = child; node; node = node->sibling) {
+            if (node->refit(val, old_aabb)) {
+              _refitNode();
+              return true;
+            }
+          }
+          return false;
+        }
+
+        if (std::find(data.begin(), data.end(), val) == data.end()) return false;
+        bbox.fit(data.begin(), data.end());
+        return true;
+      }
+
+      RTreeNode() : bbox(), child(NULL), sibling(NULL), data(), child_bbox() {
+      }
+
       template<typename iter_t>
-      RTreeNode(iter_t begin, iter_t end) : bbox(), child(NULL), sibling(NULL), data() {
+      RTreeNode(iter_t begin, iter_t end) : bbox(), child(NULL), sibling(NULL), data(), child_bbox() {
         _fill(begin, end, typename std::iterator_traits<iter_t>::value_type());
       }
 
@@ -210,17 +733,10 @@ namespace carve {
         }
       };
 
-      // facade for projecting node bounding box onto an axis.
-      struct aabb_extent {
-        size_t dim;
-        aabb_extent(size_t _dim) : dim(_dim) { }
-
-        double min(const node_t *a) { return a->bbox.pos.v[dim] - a->bbox.extent.v[dim]; }
-        double max(const node_t *a) { return a->bbox.pos.v[dim] + a->bbox.extent.v[dim]; }
-        double len(const node_t *a) { return 2.0 * a->bbox.extent.v[dim]; }
-        double min(const data_aabb_t &a) { return a.bbox.pos.v[dim] - a.bbox.extent.v[dim]; }
-        double max(const data_aabb_t &a) { return a.bbox.pos.v[dim] + a.bbox.extent.v[dim]; }
-        double len(const data_aabb_t &a) { return 2.0 * a.bbox.extent.v[dim]; }
+      // the bounding box of a node or of a (data, aabb) pair.
+      struct bbox_of {
+        const aabb_t &operator()(const node_t *a) const { return a->bbox; }
+        const aabb_t &operator()(const data_aabb_t &a) const { return a.bbox; }
       };
 
       template<typename iter_t>
@@ -230,52 +746,17 @@ namespace carve {
                             uint32_t dim_mask,
                             size_t child_size,
                             std::vector<node_t *> &out) {
-        const size_t N = std::distance(begin, end);
-
-        size_t dim = ndim;
-        double r_best = N+1;
-
-        // find the sparsest remaining dimension to partition by.
-        for (size_t i = 0; i < ndim; ++i) {
-          if (dim_mask & (1U << i)) continue;
-          aabb_extent extent(i);
-          double dmin, dmax, dsum;
-
-          dmin = extent.min(*begin);
-          dmax = extent.max(*begin);
-          dsum = 0.0;
-          for (iter_t j = begin; j != end; ++j) {
-            dmin = std::min(dmin, extent.min(*j));
-            dmax = std::max(dmax, extent.max(*j));
-            dsum += extent.len(*j);
-          }
-          double r = dsum ? dsum / (dmax - dmin) : 0.0;
-          if (r_best > r) {
-            dim = i;
-            r_best = r;
-          }
-        }
-
-        CARVE_ASSERT(dim < ndim);
-
-        // dim = dim_num;
-
-        const size_t P = (N + child_size - 1) / child_size;
-        const size_t n_parts = (size_t)std::ceil(std::pow((double)P, 1.0 / (ndim - dim_num)));
-
-        std::sort(begin, end, aabb_cmp_mid(dim));
-
-        if (dim_num == ndim - 1 || n_parts == 1) {
-          for (size_t i = 0, s = 0, e = 0; i < P; ++i, s = e) {
-            e = N * (i+1) / P;
-            CARVE_ASSERT(e - s <= child_size);
-            out.push_back(new node_t(begin + s, begin + e));
-          }
-        } else {
-          for (size_t i = 0, s = 0, e = 0; i < n_parts; ++i, s = e) {
-            e = N * (i+1) / n_parts;
-            makeNodes(begin + s, begin + e, dim_num + 1, dim_mask | (1U << dim), child_size, out);
-          }
+        std::vector<size_t> ends;
+        detail::partitionSTR<ndim>(begin, end, dim_num, dim_mask, child_size, bbox_of(), ends);
+
+        const size_t first = out.size();
+        const int n = (int)ends.size();
+        out.resize(first + n);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static) if (detail::parallelBuild(std::distance(begin, end)))
+#endif
+        for (int i = 0; i < n; ++i) {
+          out[first + i] = new node_t(begin + (i ? ends[i - 1] : 0), begin + ends[i]);
         }
       }
 
@@ -300,9 +781,7 @@ namespace carve {
                                    size_t internal_size) {
         std::vector<data_aabb_t> data;
         data.reserve(std::distance(begin, end));
-        for (iter_t i = begin; i != end; ++i) {
-          data.push_back(*i);
-        }
+        detail::appendDataAABBs(begin, end, data);
         return construct_STR(data, leaf_size, internal_size);
       }
 
@@ -316,12 +795,8 @@ namespace carve {
                                    size_t internal_size) {
         std::vector<data_aabb_t> data;
         data.reserve(std::distance(begin1, end1) + std::distance(begin2, end2));
-        for (iter_t i = begin1; i != end1; ++i) {
-          data.push_back(*i);
-        }
-        for (iter_t i = begin2; i != end2; ++i) {
-          data.push_back(*i);
-        }
+        detail::appendDataAABBs(begin1, end1, data);
+        detail::appendDataAABBs(begin2, end2, data);
         return construct_STR(data, leaf_size, internal_size);
       }
 
@@ -349,16 +824,16 @@ namespace carve {
 
         std::vector<double> rhs_vol(N, 0.0);
 
-        aabb_t rhs = base[begin[N-1]].aabb;
+        aabb_t rhs = base[begin[N-1]].bbox;
         rhs_vol[N-1] = rhs.volume();
         for (size_t i = N - 1; i > 0; ) {
-          rhs.unionAABB(base[begin[--i]].aabb);
+          rhs.unionAABB(base[begin[--i]].bbox);
           rhs_vol[i] = rhs.volume();
         }
 
-        aabb_t lhs = base[begin[0]].aabb;
+        aabb_t lhs = base[begin[0]].bbox;
         for (size_t i = 1; i < N; ++i) {
-          lhs.unionAABB(base[begin[i]].aabb);
+          lhs.unionAABB(base[begin[i]].bbox);
           if (i % part_size == 0 || (N - i) % part_size == 0) {
             partition_info curr(lhs.volume() + rhs_vol[i], i);
             if (best.score > curr.score) best = curr;
@@ -367,6 +842,19 @@ namespace carve {
         return best;
       }
 
+      // sort entry indices by candidate ordering c: by the minimum,
+      // midpoint or maximum of the bounding box along axis c / 3.
+      static void sortCandidate(typename std::vector<data_aabb_t>::iterator base,
+                                int c,
+                                std::vector<size_t> &idx) {
+        const size_t dim = c / 3;
+        switch (c % 3) {
+        case 0: std::sort(idx.begin(), idx.end(), make_index_sort(base, aabb_cmp_min(dim))); break;
+        case 1: std::sort(idx.begin(), idx.end(), make_index_sort(base, aabb_cmp_mid(dim))); break;
+        case 2: std::sort(idx.begin(), idx.end(), make_index_sort(base, aabb_cmp_max(dim))); break;
+        }
+      }
+
       static void partition(typename std::vector<data_aabb_t>::iterator base,
                             std::vector<size_t>::iterator begin,
                             std::vector<size_t>::iterator end,
@@ -377,34 +865,39 @@ namespace carve {
 
         const size_t N = (size_t)std::distance(begin, end);
 
-        partition_info best;
-        partition_info curr;
         size_t part_curr = part_num[*begin];
 
-        std::vector<size_t> tmp(begin, end);
-
-        for (size_t dim = 0; dim < ndim; ++dim) {
-          std::sort(tmp.begin(), tmp.end(), make_index_sort(base, aabb_cmp_min(dim)));
-          curr = findPartition(base, tmp.begin(), tmp.end(), part_size);
-          if (best.score > curr.score) {
-            best = curr;
-            std::copy(tmp.begin(), tmp.end(), begin);
-          }
-
-          std::sort(tmp.begin(), tmp.end(), make_index_sort(base, aabb_cmp_mid(dim)));
-          curr = findPartition(base, tmp.begin(), tmp.end(), part_size);
-          if (best.score > curr.score) {
-            best = curr;
-            std::copy(tmp.begin(), tmp.end(), begin);
+        // each candidate ordering sorts its own copy of the entries, so
+        // that the chosen ordering does not depend on the order in
+        // which candidates are evaluated.
+        const std::vector<size_t> orig(begin, end);
+        const int n_cand = 3 * ndim;
+        std::vector<partition_info> cand(n_cand);
+
+#if defined(_OPENMP)
+#pragma omp parallel if (detail::parallelBuild(N))
+#endif
+        {
+          std::vector<size_t> tmp;
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 1)
+#endif
+          for (int c = 0; c < n_cand; ++c) {
+            tmp = orig;
+            sortCandidate(base, c, tmp);
+            cand[c] = findPartition(base, tmp.begin(), tmp.end(), part_size);
           }
+        }
 
-          std::sort(tmp.begin(), tmp.end(), make_index_sort(base, aabb_cmp_max(dim)));
-          curr = findPartition(base, tmp.begin(), tmp.end(), part_size);
-          if (best.score > curr.score) {
-            best = curr;
-            std::copy(tmp.begin(), tmp.end(), begin);
-          }
+        int best_cand = 0;
+        for (int c = 1; c < n_cand; ++c) {
+          if (cand[best_cand].score > cand[c].score) best_cand = c;
         }
+        const partition_info best = cand[best_cand];
+
+        std::vector<size_t> tmp(orig);
+        sortCandidate(base, best_cand, tmp);
+        std::copy(tmp.begin(), tmp.end(), begin);
 
         for (size_t j = 0; j < best.partition_pos; ++j) part_num[begin[(ssize_t)j]] = part_curr;
         for (size_t j = best.partition_pos; j < N; ++j) part_num[begin[(ssize_t)j]] = part_next;
@@ -445,8 +938,9 @@ namespace carve {
           std::vector<size_t> part_num(N, 0);
           P = makePartitions(begin, end, P, part_num);
 
-          size_t S = 0, E = 0;
-          std::vector<node_t *> children;
+          // gather each partition into a contiguous range.
+          size_t S = 0;
+          std::vector<size_t> part_end(P);
           for (size_t i = 0; i < P; ++i) {
             size_t j = S, k = N;
             while (true) {
@@ -466,9 +960,16 @@ namespace carve {
               ++j;
             }
           done:
-            E = j;
-            children.push_back(construct_TGS(begin + S, begin + E, leaf_size, internal_size));
-            S = E;
+            part_end[i] = S = j;
+          }
+
+          // the subtrees of the partitions are independent.
+          std::vector<node_t *> children(P);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) if (detail::parallelBuild(N))
+#endif
+          for (int i = 0; i < (int)P; ++i) {
+            children[i] = construct_TGS(begin + (i ? part_end[i - 1] : 0), begin + part_end[i], leaf_size, internal_size);
           }
           return new node_t(children.begin(), children.end());
         }
@@ -481,9 +982,7 @@ namespace carve {
                                    size_t internal_size) {
         std::vector<data_aabb_t> data;
         data.reserve(std::distance(begin, end));
-        for (iter_t i = begin; i != end; ++i) {
-          data.push_back(*i);
-        }
+        detail::appendDataAABBs(begin, end, data);
         return construct_TGS(data.begin(), data.end(), leaf_size, internal_size);
       }
 
@@ -496,15 +995,187 @@ namespace carve {
                                    size_t internal_size) {
         std::vector<data_aabb_t> data;
         data.reserve(std::distance(begin1, end1) + std::distance(begin2, end2));
-        for (iter_t i = begin1; i != end1; ++i) {
-          data.push_back(*i);
+        detail::appendDataAABBs(begin1, end1, data);
+        detail::appendDataAABBs(begin2, end2, data);
+        return construct_TGS(data.begin(), data.end(), leaf_size, internal_size);
+      }
+
+
+
+      // the number of bins in which construct_SAH() evaluates splits.
+      static const size_t SAH_BINS = 16;
+
+      static size_t sahBin(double c, double lo, double scale) {
+        const size_t b = (size_t)((c - lo) * scale);
+        return std::min(b, SAH_BINS - 1);
+      }
+
+      struct sah_below {
+        size_t dim;
+        double lo;
+        double scale;
+        size_t bin;
+        sah_below(size_t _dim, double _lo, double _scale, size_t _bin) : dim(_dim), lo(_lo), scale(_scale), bin(_bin) { }
+        bool operator()(const data_aabb_t &a) const {
+          return sahBin(a.bbox.pos.v[dim], lo, scale) < bin;
         }
-        for (iter_t i = begin2; i != end2; ++i) {
-          data.push_back(*i);
+      };
+
+      /**
+       * \brief Split a range of entries in two by the binned surface
+       *        area heuristic.
+       *
+       * Along each axis, entries are binned by the centre of their
+       * bounding box, and the boundary between bins is chosen that
+       * minimises the sum, over both sides, of surface area times the
+       * number of entries. Ties go to the lowest axis and boundary.
+       * If all centres coincide, the range is split in half.
+       *
+       * @return The offset from \a begin of the first entry of the
+       *         second part, which is neither 0 nor the size of the range.
+       */
+      static size_t splitSAH(typename std::vector<data_aabb_t>::iterator begin,
+                             typename std::vector<data_aabb_t>::iterator end) {
+        const size_t N = std::distance(begin, end);
+        CARVE_ASSERT(N >= 2);
+
+        vector_t lo = begin->bbox.pos, hi = lo;
+        for (typename std::vector<data_aabb_t>::iterator i = begin; i != end; ++i) {
+          for (size_t dim = 0; dim < ndim; ++dim) {
+            lo.v[dim] = std::min(lo.v[dim], i->bbox.pos.v[dim]);
+            hi.v[dim] = std::max(hi.v[dim], i->bbox.pos.v[dim]);
+          }
         }
-        return construct_TGS(data.begin(), data.end(), leaf_size, internal_size);
+
+        double best_cost = std::numeric_limits<double>::max();
+        size_t best_dim = ndim, best_bin = 0;
+        double best_scale = 0.0;
+
+        for (size_t dim = 0; dim < ndim; ++dim) {
+          if (!(hi.v[dim] > lo.v[dim])) continue;
+          const double scale = SAH_BINS / (hi.v[dim] - lo.v[dim]);
+
+          size_t count[SAH_BINS];
+          aabb_t bin_bbox[SAH_BINS];
+          std::fill(count, count + SAH_BINS, 0);
+          for (typename std::vector<data_aabb_t>::iterator i = begin; i != end; ++i) {
+            const size_t b = sahBin(i->bbox.pos.v[dim], lo.v[dim], scale);
+            if (count[b]++) {
+              bin_bbox[b].unionAABB(i->bbox);
+            } else {
+              bin_bbox[b] = i->bbox;
+            }
+          }
+
+          // the cost of the entries in bins [b, SAH_BINS).
+          double rhs_cost[SAH_BINS];
+          aabb_t acc;
+          size_t n = 0;
+          for (size_t b = SAH_BINS; b-- > 1; ) {
+            if (count[b]) {
+              if (n) acc.unionAABB(bin_bbox[b]); else acc = bin_bbox[b];
+              n += count[b];
+            }
+            rhs_cost[b] = n ? acc.surfaceArea() * n : 0.0;
+          }
+
+          n = 0;
+          for (size_t b = 0; b + 1 < SAH_BINS; ++b) {
+            if (count[b]) {
+              if (n) acc.unionAABB(bin_bbox[b]); else acc = bin_bbox[b];
+              n += count[b];
+            }
+            if (!n || n == N) continue;
+            const double cost = acc.surfaceArea() * n + rhs_cost[b + 1];
+            if (cost < best_cost) {
+              best_cost = cost;
+              best_dim = dim;
+              best_bin = b + 1;
+              best_scale = scale;
+            }
+          }
+        }
+
+        if (best_dim == ndim) {
+          return N / 2;
+        }
+
+        return std::distance(begin, std::partition(begin, end, sah_below(best_dim, lo.v[best_dim], best_scale, best_bin)));
+      }
+
+      /**
+       * \brief Construct an R-tree top down by the binned surface area
+       *        heuristic.
+       *
+       * Each node is split in two with splitSAH(), and its largest
+       * child by surface area is split again, until it has
+       * \a internal_size children or no child has more than
+       * \a leaf_size entries. The subtrees of a node are built
+       * concurrently.
+       *
+       * @param[in] leaf_size The maximum number of entries in a leaf.
+       * @param[in] internal_size The maximum number of children of an
+       *            internal node; at least 2.
+       */
+      static node_t *construct_SAH(typename std::vector<data_aabb_t>::iterator begin,
+                                   typename std::vector<data_aabb_t>::iterator end,
+                                   size_t leaf_size,
+                                   size_t internal_size) {
+        CARVE_ASSERT(internal_size >= 2);
+        const size_t N = std::distance(begin, end);
+
+        if (N <= leaf_size) {
+          return new node_t(begin, end);
+        }
+
+        // parts are contiguous, and part i ends at part_end[i].
+        std::vector<size_t> part_end(1, N);
+        std::vector<double> part_area(1, aabb_t(begin, end).surfaceArea());
+
+        while (part_end.size() < internal_size) {
+          size_t split = part_end.size();
+          for (size_t i = 0; i < part_end.size(); ++i) {
+            const size_t size = part_end[i] - (i ? part_end[i - 1] : 0);
+            if (size > leaf_size && (split == part_end.size() || part_area[i] > part_area[split])) {
+              split = i;
+            }
+          }
+          if (split == part_end.size()) break;
+
+          const size_t s = split ? part_end[split - 1] : 0;
+          const size_t e = part_end[split];
+          const size_t m = s + splitSAH(begin + s, begin + e);
+          part_end.insert(part_end.begin() + split, m);
+          part_area[split] = aabb_t(begin + s, begin + m).surfaceArea();
+          part_area.insert(part_area.begin() + split + 1, aabb_t(begin + m, begin + e).surfaceArea());
+        }
+
+        std::vector<node_t *> children(part_end.size());
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) if (detail::parallelBuild(N))
+#endif
+        for (int i = 0; i < (int)part_end.size(); ++i) {
+          children[i] = construct_SAH(begin + (i ? part_end[i - 1] : 0), begin + part_end[i], leaf_size, internal_size);
+        }
+        return new node_t(children.begin(), children.end());
+      }
+
+      template<typename iter_t>
+      static node_t *construct_SAH(const iter_t &begin,
+                                   const iter_t &end,
+                                   size_t leaf_size,
+                                   size_t internal_size) {
+        std::vector<data_aabb_t> data;
+        data.reserve(std::distance(begin, end));
+        detail::appendDataAABBs(begin, end, data);
+        return construct_SAH(data.begin(), data.end(), leaf_size, internal_size);
       }
     };
 
+
+
+    template<unsigned ndim, typename data_t, typename aabb_calc_t>
+    const size_t RTreeNode<ndim, data_t, aabb_calc_t>::SAH_BINS;
+
   }
 }
@@ -0,0 +1,131 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/geom.hpp>
+#include <carve/flat_rtree.hpp>
+#include <carve/mesh.hpp>
+
+#include <vector>
+
+namespace carve {
+  namespace mesh {
+
+
+
+    /**
+     * \class WindingNumber
+     * \brief Generalized winding number evaluation over a face R-tree.
+     *
+     * The winding number of a point is the signed solid angle
+     * subtended by the surface, divided by 4pi. It is 1 inside and 0
+     * outside a closed, outward oriented mesh, and degrades smoothly
+     * for meshes with small holes or self intersections, so
+     * thresholding it at 0.5 gives a robust inside/outside test where
+     * ray parity would be ambiguous.
+     *
+     * Each node of the face R-tree is annotated with the summed area
+     * vector of the faces below it, their area weighted centre, and a
+     * bounding radius. A subtree whose centre is more than \a accuracy
+     * radii from the query point is evaluated as a single dipole;
+     * otherwise it is descended, and the faces of nearby leaves are
+     * evaluated exactly.
+     *
+     * The R-tree must not be modified while a WindingNumber built
+     * from it is in use.
+     */
+    class WindingNumber {
+    public:
+      typedef carve::geom::FlatRTree<3, Face<3> *> face_rtree_t;
+
+    private:
+      struct node_data_t {
+        carve::geom::vector<3> centre;
+        carve::geom::vector<3> normal;
+        double radius;
+      };
+
+      const MeshSet<3> *meshset;
+      const face_rtree_t *rtree;
+      const Mesh<3> *mesh;
+      double accuracy;
+      double offset;
+      // indexed by R-tree node.
+      std::vector<node_data_t> nodes;
+
+      WindingNumber(const WindingNumber &);
+      WindingNumber &operator=(const WindingNumber &);
+
+      bool included(const Face<3> *face) const {
+        return mesh == NULL || face->mesh == mesh;
+      }
+
+      void build(face_rtree_t::index_t node);
+
+      double evaluate(face_rtree_t::index_t node,
+                      const carve::geom::vector<3> &v) const;
+
+    public:
+      /**
+       * \brief Annotate the R-tree of a MeshSet for winding number queries.
+       *
+       * @param[in] _meshset The MeshSet to evaluate against.
+       * @param[in] _rtree An R-tree of the faces of \a _meshset.
+       * @param[in] _mesh If not NULL, only consider this mesh of \a _meshset.
+       * @param[in] _accuracy The distance, in subtree radii, beyond
+       *   which a subtree is approximated by a dipole.
+       */
+      WindingNumber(const MeshSet<3> *_meshset,
+                    const face_rtree_t *_rtree,
+                    const Mesh<3> *_mesh = NULL,
+                    double _accuracy = 2.0);
+
+      /// The generalized winding number of \a v.
+      double operator()(const carve::geom::vector<3> &v) const;
+
+      /**
+       * \brief Classify a point by its winding number.
+       *
+       * Points that lie on a face are POINT_ON, as for
+       * classifyPoint(); otherwise the point is POINT_IN if its
+       * winding number exceeds 0.5.
+       *
+       * @param[in] v The point to classify.
+       * @param[out] hit_face If not NULL, set to the face \a v lies on, if any.
+       */
+      carve::PointClass classify(const carve::geom::vector<3> &v,
+                                 const Face<3> **hit_face = NULL) const;
+    };
+
+
+
+    /// Classify \a v using a winding number evaluator, as an
+    /// alternative to classifyPoint(const MeshSet<3> *, ...).
+    inline carve::PointClass classifyPoint(
+        const WindingNumber &winding_number,
+        const carve::geom::vector<3> &v,
+        const Face<3> **hit_face = NULL) {
+      return winding_number.classify(v, hit_face);
+    }
+
+
+
+  }
+}
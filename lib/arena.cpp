@@ -0,0 +1,40 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/arena.hpp>
+
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
+CARVE_THREAD_LOCAL carve::Arena *carve::Arena::s_current = NULL;
+
+void *carve::Arena::allocateConcurrent(size_t size, size_t alignment) {
+#if defined(_OPENMP)
+  if (omp_in_parallel()) {
+    void *p;
+#pragma omp critical(carve_arena)
+    p = allocate(size, alignment);
+    return p;
+  }
+#endif
+  return allocate(size, alignment);
+}
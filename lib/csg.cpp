@@ -20,6 +20,7 @@
 #endif
 
 #include <carve/csg.hpp>
+#include <carve/timing.hpp>
 #include "csg_detail.hpp"
 
 
@@ -91,3 +92,46 @@ carve::csg::FaceClass carve::csg::FaceLoopGroup::classificationAgainst(const car
   }
   return FACE_UNCLASSIFIED;
 }
+
+
+
+carve::csg::PreparedMeshSet::PreparedMeshSet(meshset_t *_meshset) :
+    meshset(_meshset), rtree(NULL), aabb(), closed(false) {
+  update();
+}
+
+
+
+carve::csg::PreparedMeshSet::~PreparedMeshSet() {
+  delete rtree;
+}
+
+
+
+void carve::csg::PreparedMeshSet::update() {
+  static carve::TimingName FUNC_NAME("PreparedMeshSet::update()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  delete rtree;
+  rtree = NULL;
+
+  std::vector<face_rtree_t::data_aabb_t> data;
+  data.reserve(meshset->faceCount());
+
+  const carve::mesh::FaceGeometry<3> &geom = meshset->faceGeometry();
+
+  for (meshset_t::face_iter i = meshset->faceBegin(); i != meshset->faceEnd(); ++i) {
+    meshset_t::face_t *f = *i;
+    data.push_back(face_rtree_t::data_aabb_t());
+    data.back().data = f;
+    data.back().bbox = geom.getAABB(f->id);
+  }
+
+  rtree = face_rtree_t::construct_STR(data, 4, 4);
+  aabb = rtree->getAABB();
+
+  closed = true;
+  for (size_t i = 0; i < meshset->meshes.size(); ++i) {
+    closed = closed && meshset->meshes[i]->isClosed();
+  }
+}
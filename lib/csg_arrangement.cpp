@@ -0,0 +1,372 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg_arrangement.hpp>
+#include <carve/geom2d.hpp>
+#include <carve/timing.hpp>
+
+#include <list>
+#include <memory>
+#include <algorithm>
+
+namespace {
+
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  typedef carve::geom::vector<3> vector_t;
+  typedef carve::csg::Arrangement::mask_t mask_t;
+
+  // a point strictly inside f to classify it by: the centroid, or
+  // failing that, the centroid of a triangle of consecutive vertices.
+  // A point on the boundary of f may lie on a surface that only
+  // touches f there.
+  bool facePoint(const meshset_t::face_t *f, vector_t &v) {
+    std::vector<carve::geom::vector<2> > verts;
+    f->getProjectedVertices(verts);
+    v = f->centroid();
+    if (carve::geom2d::pointInPoly(verts, f->project(v)).iclass == carve::POINT_IN) return true;
+    const meshset_t::edge_t *e = f->edge;
+    do {
+      v = (e->prev->vert->v + e->vert->v + e->next->vert->v) / 3.0;
+      if (carve::geom2d::pointInPoly(verts, f->project(v)).iclass == carve::POINT_IN) return true;
+      e = e->next;
+    } while (e != f->edge);
+    return false;
+  }
+
+  size_t mapVertex(const vector_t &v,
+                   std::map<vector_t, size_t> &vmap,
+                   std::vector<vector_t> &points) {
+    std::map<vector_t, size_t>::iterator i = vmap.find(v);
+    if (i != vmap.end()) return (*i).second;
+    vmap[v] = points.size();
+    points.push_back(v);
+    return points.size() - 1;
+  }
+
+  // the vertex loop of a face, without repeated consecutive
+  // vertices. Returns false if fewer than three remain.
+  bool faceLoop(const meshset_t::face_t *f,
+                std::map<vector_t, size_t> &vmap,
+                std::vector<vector_t> &points,
+                std::vector<size_t> &loop) {
+    loop.clear();
+    for (meshset_t::face_t::const_edge_iter_t e = f->begin(); e != f->end(); ++e) {
+      const size_t v = mapVertex((*e).vert->v, vmap, points);
+      if (loop.empty() || loop.back() != v) loop.push_back(v);
+    }
+    while (loop.size() > 1 && loop.back() == loop.front()) loop.pop_back();
+    return loop.size() >= 3;
+  }
+
+  // join the pieces sliced from a surface back into one meshset. The
+  // pieces hold copies of the same vertices along the cuts, so
+  // vertices at the same position are shared.
+  meshset_t *join(const std::list<meshset_t *> &pieces) {
+    std::map<vector_t, size_t> vmap;
+    std::vector<vector_t> points;
+    std::vector<int> face_indices;
+    std::vector<size_t> loop;
+    size_t n_faces = 0;
+
+    for (std::list<meshset_t *>::const_iterator i = pieces.begin(); i != pieces.end(); ++i) {
+      for (meshset_t::face_iter f = (*i)->faceBegin(); f != (*i)->faceEnd(); ++f) {
+        if (!faceLoop(*f, vmap, points, loop)) continue;
+        face_indices.push_back((int)loop.size());
+        for (size_t j = 0; j < loop.size(); ++j) face_indices.push_back((int)loop[j]);
+        ++n_faces;
+      }
+    }
+
+    return new meshset_t(points, n_faces, face_indices);
+  }
+
+  void destroy(std::list<meshset_t *> &meshes) {
+    for (std::list<meshset_t *>::iterator i = meshes.begin(); i != meshes.end(); ++i) delete *i;
+    meshes.clear();
+  }
+
+  template<typename T>
+  void destroy(std::vector<T *> &v) {
+    for (size_t i = 0; i < v.size(); ++i) delete v[i];
+    v.clear();
+  }
+
+  carve::geom::aabb<3> paddedAABB(const meshset_t *m) {
+    carve::geom::aabb<3> aabb = m->getAABB();
+    aabb.extent += carve::geom::VECTOR(carve::EPSILON, carve::EPSILON, carve::EPSILON);
+    return aabb;
+  }
+
+}
+
+
+
+void carve::csg::Arrangement::addSurface(size_t operand,
+                                         const meshset_t *surface,
+                                         const std::vector<PreparedMeshSet *> &prepared,
+                                         std::map<carve::geom::vector<3>, size_t> &vmap) {
+  const carve::geom::aabb<3> aabb = paddedAABB(surface);
+
+  // the faces of the surface, in the order of their ids.
+  std::vector<const meshset_t::face_t *> sfaces;
+  for (meshset_t::const_face_iter i = surface->faceBegin(); i != surface->faceEnd(); ++i) {
+    CARVE_ASSERT((*i)->id == sfaces.size());
+    sfaces.push_back(*i);
+  }
+
+  const size_t n = sfaces.size();
+  std::vector<vector_t> face_point(n);
+  std::vector<char> classified(n);
+  for (size_t i = 0; i < n; ++i) classified[i] = facePoint(sfaces[i], face_point[i]);
+
+  const mask_t bit = mask_t(1) << operand;
+  std::vector<mask_t> back(n, bit), front(n, 0);
+  std::vector<char> coincident(n, 0);
+
+  std::vector<size_t> idx;
+  std::vector<vector_t> pts;
+  std::vector<carve::PointClass> result;
+
+  for (size_t j = 0; j < prepared.size(); ++j) {
+    if (j == operand) continue;
+    const PreparedMeshSet &other = *prepared[j];
+    if (!other.getAABB().intersects(aabb)) continue;
+
+    idx.clear();
+    pts.clear();
+    for (size_t i = 0; i < n; ++i) {
+      if (classified[i] && other.getAABB().containsPoint(face_point[i])) {
+        idx.push_back(i);
+        pts.push_back(face_point[i]);
+      }
+    }
+    carve::mesh::classifyPoints(other.getMeshSet(), other.getRTree(), pts, result);
+
+    const mask_t other_bit = mask_t(1) << j;
+    for (size_t k = 0; k < idx.size(); ++k) {
+      const size_t i = idx[k];
+      switch (result[k]) {
+      case carve::POINT_IN:
+        back[i] |= other_bit;
+        front[i] |= other_bit;
+        break;
+      case carve::POINT_OUT:
+        break;
+      case carve::POINT_ON: {
+        // the surfaces coincide. the other operand contains the
+        // region behind the face if they face the same way.
+        const carve::mesh::Face<3> *hit_face = NULL;
+        carve::mesh::classifyPoint(other.getMeshSet(), other.getRTree(), face_point[i], false, NULL, &hit_face);
+        if (hit_face == NULL) {
+          throw carve::exception("face of operand is ON another, but no face was hit!");
+        }
+        if (carve::geom::dot(sfaces[i]->plane.N, hit_face->plane.N) > 0.0) {
+          back[i] |= other_bit;
+        } else {
+          front[i] |= other_bit;
+        }
+        if (j < operand) coincident[i] = 1;
+        break;
+      }
+      default:
+        throw carve::exception("face of operand is not IN, OUT or ON another!");
+      }
+    }
+  }
+
+  // faces without an interior point take the classification of a
+  // neighbour.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < n; ++i) {
+      if (classified[i]) continue;
+      const meshset_t::edge_t *e = sfaces[i]->edge;
+      do {
+        if (e->rev != NULL && classified[e->rev->face->id]) {
+          const size_t k = e->rev->face->id;
+          back[i] = back[k];
+          front[i] = front[k];
+          coincident[i] = coincident[k];
+          classified[i] = 1;
+          changed = true;
+          break;
+        }
+        e = e->next;
+      } while (e != sfaces[i]->edge);
+    }
+  }
+
+  // gather connected faces with the same classification into groups.
+  std::vector<char> visited(n, 0);
+  std::vector<size_t> stack;
+  std::vector<size_t> loop;
+  for (size_t i = 0; i < n; ++i) {
+    if (visited[i]) continue;
+    if (!classified[i]) {
+      throw carve::exception("face of operand could not be classified!");
+    }
+
+    groups.push_back(Group(operand, back[i], front[i], coincident[i] != 0));
+    Group &group = groups.back();
+    group.face_begin = faces.size();
+
+    visited[i] = 1;
+    stack.push_back(i);
+    while (stack.size()) {
+      const size_t f = stack.back();
+      stack.pop_back();
+      if (faceLoop(sfaces[f], vmap, points, loop)) faces.push_back(loop);
+
+      const meshset_t::edge_t *e = sfaces[f]->edge;
+      do {
+        if (e->rev != NULL) {
+          const size_t k = e->rev->face->id;
+          if (!visited[k] && back[k] == back[i] && front[k] == front[i] && coincident[k] == coincident[i]) {
+            visited[k] = 1;
+            stack.push_back(k);
+          }
+        }
+        e = e->next;
+      } while (e != sfaces[f]->edge);
+    }
+
+    group.face_end = faces.size();
+  }
+}
+
+
+
+carve::csg::Arrangement::Arrangement(const std::vector<meshset_t *> &operands) :
+    n_operands(operands.size()), points(), faces(), groups() {
+  static carve::TimingName FUNC_NAME("Arrangement::Arrangement()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  if (n_operands > MAX_OPERANDS) {
+    throw carve::exception("too many operands for an arrangement!");
+  }
+  for (size_t i = 0; i < n_operands; ++i) {
+    if (!operands[i]->isClosed()) {
+      throw carve::exception("operand of an arrangement is not closed!");
+    }
+  }
+
+  std::vector<meshset_t *> surfaces;
+  std::vector<PreparedMeshSet *> prepared;
+
+  try {
+    std::vector<carve::geom::aabb<3> > aabbs;
+    for (size_t i = 0; i < n_operands; ++i) {
+      surfaces.push_back(operands[i]->clone());
+      aabbs.push_back(paddedAABB(operands[i]));
+    }
+
+    // slice each pair of surfaces once. Slicing a surface that has
+    // already been cut by other operands divides the cuts where they
+    // cross, so that the pieces of every surface end up bounded by
+    // all of the surfaces that meet it.
+    CSG csg;
+    for (size_t i = 0; i < n_operands; ++i) {
+      for (size_t j = i + 1; j < n_operands; ++j) {
+        if (!aabbs[i].intersects(aabbs[j])) continue;
+
+        std::list<meshset_t *> a_pieces, b_pieces;
+        V2Set shared_edges;
+        try {
+          csg.slice(surfaces[i], surfaces[j], a_pieces, b_pieces, &shared_edges);
+          if (shared_edges.size()) {
+            meshset_t *a = join(a_pieces);
+            delete surfaces[i];
+            surfaces[i] = a;
+            meshset_t *b = join(b_pieces);
+            delete surfaces[j];
+            surfaces[j] = b;
+          }
+        } catch (...) {
+          destroy(a_pieces);
+          destroy(b_pieces);
+          throw;
+        }
+        destroy(a_pieces);
+        destroy(b_pieces);
+      }
+    }
+
+    // classify the faces of each surface against the operands
+    // themselves, which have fewer faces.
+    for (size_t i = 0; i < n_operands; ++i) {
+      prepared.push_back(new PreparedMeshSet(operands[i]));
+    }
+
+    std::map<carve::geom::vector<3>, size_t> vmap;
+    for (size_t i = 0; i < n_operands; ++i) {
+      addSurface(i, surfaces[i], prepared, vmap);
+    }
+  } catch (...) {
+    destroy(surfaces);
+    destroy(prepared);
+    throw;
+  }
+
+  destroy(surfaces);
+  destroy(prepared);
+}
+
+
+
+carve::csg::Arrangement::~Arrangement() {
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::Arrangement::collect(const Selector &selector) const {
+  std::vector<int> vertex_index(points.size(), -1);
+  std::vector<vector_t> out_points;
+  std::vector<int> face_indices;
+  size_t n_faces = 0;
+
+  for (size_t g = 0; g < groups.size(); ++g) {
+    const Group &group = groups[g];
+    if (group.coincident) continue;
+
+    const bool back = selector.select(group.back);
+    const bool front = selector.select(group.front);
+    if (back == front) continue;
+
+    for (size_t f = group.face_begin; f != group.face_end; ++f) {
+      const std::vector<size_t> &loop = faces[f];
+      face_indices.push_back((int)loop.size());
+      for (size_t j = 0; j < loop.size(); ++j) {
+        // faces are kept as they are when the region behind them is
+        // chosen, and reversed otherwise.
+        const size_t v = back ? loop[j] : loop[loop.size() - 1 - j];
+        if (vertex_index[v] == -1) {
+          vertex_index[v] = (int)out_points.size();
+          out_points.push_back(points[v]);
+        }
+        face_indices.push_back(vertex_index[v]);
+      }
+      ++n_faces;
+    }
+  }
+
+  return new meshset_t(out_points, n_faces, face_indices);
+}
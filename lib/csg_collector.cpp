@@ -196,6 +196,13 @@ namespace carve {
           for (FaceLoop *f = grp->face_loops.head; f; f = f->next) {
             collect(f->orig_face, f->vertices, f->orig_face->plane.N, is_poly_a, fc, hooks);
           }
+
+          std::vector<carve::mesh::MeshSet<3>::vertex_t *> vertices;
+          for (size_t i = 0; i < grp->untouched_faces.size(); ++i) {
+            const carve::mesh::MeshSet<3>::face_t *f = grp->untouched_faces[i];
+            f->getVertices(vertices);
+            collect(f, vertices, f->plane.N, is_poly_a, fc, hooks);
+          }
         }
 
         virtual carve::mesh::MeshSet<3> *done(CSG::Hooks &hooks) {
@@ -230,6 +237,13 @@ namespace carve {
           for (FaceLoop *f = grp->face_loops.head; f; f = f->next) {
             FWD(f->orig_face, f->vertices, f->orig_face->plane.N, f->orig_face->mesh->meshset == src_a, FACE_OUT, hooks);
           }
+
+          std::vector<carve::mesh::MeshSet<3>::vertex_t *> vertices;
+          for (size_t i = 0; i < grp->untouched_faces.size(); ++i) {
+            const carve::mesh::MeshSet<3>::face_t *f = grp->untouched_faces[i];
+            f->getVertices(vertices);
+            FWD(f, vertices, f->plane.N, f->mesh->meshset == src_a, FACE_OUT, hooks);
+          }
         }
         virtual void collect(const carve::mesh::MeshSet<3>::face_t *orig_face,
                              const std::vector<carve::mesh::MeshSet<3>::vertex_t *> &vertices,
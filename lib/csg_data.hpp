@@ -49,4 +49,8 @@ struct carve::csg::detail::Data {
   // faces. Saves building the vertex to edge map for all faces of
   // both meshes.
   VEVecMap vert_to_edges;
+
+  // meshes of either operand with at least one face in a candidate
+  // face pair. Meshes not in this set cannot touch the other operand.
+  MSet candidate_meshes;
 };
@@ -18,39 +18,65 @@
 #pragma once
 
 #include <carve/carve.hpp>
+#include <carve/arena.hpp>
+#include <carve/flat_collection.hpp>
 
 #include <carve/polyhedron_base.hpp>
 
 namespace carve {
   namespace csg {
     namespace detail {
-      typedef std::map<carve::mesh::MeshSet<3>::vertex_t *,
-                       std::set<std::pair<carve::mesh::MeshSet<3>::face_t *, double> > > EdgeIntInfo;
+      // the small ordered containers below are created in large
+      // numbers during a single computation, and allocate from the
+      // current arena of the CSG object. They rarely hold more than a
+      // few elements, so are kept as sorted vectors.
+      typedef carve::small_set<std::pair<carve::mesh::MeshSet<3>::face_t *, double>,
+                               std::less<std::pair<carve::mesh::MeshSet<3>::face_t *, double> >,
+                               carve::arena_allocator<std::pair<carve::mesh::MeshSet<3>::face_t *, double> > > FDSetSmall;
+
+      typedef carve::small_map<carve::mesh::MeshSet<3>::vertex_t *,
+                               FDSetSmall,
+                               std::less<carve::mesh::MeshSet<3>::vertex_t *>,
+                               carve::arena_allocator<std::pair<carve::mesh::MeshSet<3>::vertex_t *, FDSetSmall> > > EdgeIntInfo;
 
       typedef std::unordered_set<carve::mesh::MeshSet<3>::vertex_t *> VSet;
       typedef std::unordered_set<carve::mesh::MeshSet<3>::face_t *> FSet;
-
-      typedef std::set<carve::mesh::MeshSet<3>::vertex_t *> VSetSmall;
-      typedef std::set<csg::V2> V2SetSmall;
-      typedef std::set<carve::mesh::MeshSet<3>::face_t *> FSetSmall;
-
+      typedef std::unordered_set<const carve::mesh::MeshSet<3>::mesh_t *> MSet;
+
+      typedef carve::small_set<carve::mesh::MeshSet<3>::vertex_t *,
+                               std::less<carve::mesh::MeshSet<3>::vertex_t *>,
+                               carve::arena_allocator<carve::mesh::MeshSet<3>::vertex_t *> > VSetSmall;
+      typedef carve::small_set<csg::V2,
+                               std::less<csg::V2>,
+                               carve::arena_allocator<csg::V2> > V2SetSmall;
+      typedef carve::small_set<carve::mesh::MeshSet<3>::face_t *,
+                               std::less<carve::mesh::MeshSet<3>::face_t *>,
+                               carve::arena_allocator<carve::mesh::MeshSet<3>::face_t *> > FSetSmall;
+
+      // per-face graphs, built and consumed locally by erasing
+      // entries one at a time.
       typedef std::unordered_map<carve::mesh::MeshSet<3>::vertex_t *, VSetSmall> VVSMap;
-      typedef std::unordered_map<carve::mesh::MeshSet<3>::edge_t *, EdgeIntInfo> EIntMap;
-      typedef std::unordered_map<carve::mesh::MeshSet<3>::face_t *, VSetSmall> FVSMap;
 
-      typedef std::unordered_map<carve::mesh::MeshSet<3>::vertex_t *, FSetSmall> VFSMap;
-      typedef std::unordered_map<carve::mesh::MeshSet<3>::face_t *, V2SetSmall> FV2SMap;
+      // the maps below hold the intersection data for a whole
+      // computation, keyed by mesh element, and are only grown.
+      typedef carve::flat_hash_map<carve::mesh::MeshSet<3>::edge_t *, EdgeIntInfo> EIntMap;
+      typedef carve::flat_hash_map<carve::mesh::MeshSet<3>::face_t *, VSetSmall> FVSMap;
 
-      typedef std::unordered_map<
+      typedef carve::flat_hash_map<carve::mesh::MeshSet<3>::vertex_t *, FSetSmall> VFSMap;
+      typedef carve::flat_hash_map<carve::mesh::MeshSet<3>::face_t *, V2SetSmall> FV2SMap;
+
+      typedef carve::flat_hash_map<
         carve::mesh::MeshSet<3>::edge_t *,
         std::vector<carve::mesh::MeshSet<3>::vertex_t *> > EVVMap;
 
-      typedef std::unordered_map<carve::mesh::MeshSet<3>::vertex_t *,
-                                 std::vector<carve::mesh::MeshSet<3>::edge_t *> > VEVecMap;
+      typedef carve::flat_hash_map<carve::mesh::MeshSet<3>::vertex_t *,
+                                   std::vector<carve::mesh::MeshSet<3>::edge_t *> > VEVecMap;
+
 
+      typedef std::list<FaceLoop *, carve::arena_allocator<FaceLoop *> > FLList;
 
-      class LoopEdges : public std::unordered_map<V2, std::list<FaceLoop *> > {
-        typedef std::unordered_map<V2, std::list<FaceLoop *> > super;
+      class LoopEdges : public std::unordered_map<V2, FLList> {
+        typedef std::unordered_map<V2, FLList> super;
 
       public:
         void addFaceLoop(FaceLoop *fl);
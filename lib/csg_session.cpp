@@ -0,0 +1,438 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg_session.hpp>
+#include <carve/timing.hpp>
+
+#include <map>
+#include <list>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+
+namespace {
+
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  typedef carve::geom::vector<3> vector_t;
+  typedef carve::geom::aabb<3> aabb_t;
+
+  typedef std::map<vector_t, meshset_t::vertex_t *> vertex_map_t;
+
+  // a piece of the stock or of the tool, after slicing, and whether it
+  // is part of the result.
+  struct Piece {
+    meshset_t *mesh;
+    bool keep;
+    bool invert;
+
+    Piece(meshset_t *_mesh, bool _keep, bool _invert) : mesh(_mesh), keep(_keep), invert(_invert) {
+    }
+  };
+
+  // a point inside f to classify it by: the centroid, or failing
+  // that, the centroid of a triangle of consecutive vertices.
+  bool facePoint(const meshset_t::face_t *f, vector_t &v) {
+    v = f->centroid();
+    if (f->containsPoint(v)) return true;
+    const meshset_t::edge_t *e = f->edge;
+    do {
+      v = (e->prev->vert->v + e->vert->v + e->next->vert->v) / 3.0;
+      if (f->containsPoint(v)) return true;
+      e = e->next;
+    } while (e != f->edge);
+    return false;
+  }
+
+  // classify a piece of the stock against the tool. pieces on the
+  // surface of the tool are kept if they face the other way.
+  bool keepStockPiece(const carve::csg::PreparedMeshSet &tool, const meshset_t *piece) {
+    if (piece->faceBegin() == piece->faceEnd()) return false;
+    for (meshset_t::const_face_iter i = piece->faceBegin(); i != piece->faceEnd(); ++i) {
+      vector_t v;
+      if (!facePoint(*i, v)) continue;
+      const carve::mesh::Face<3> *hit_face;
+      switch (carve::mesh::classifyPoint(tool.getMeshSet(), tool.getRTree(), v, false, NULL, &hit_face)) {
+      case carve::POINT_IN: return false;
+      case carve::POINT_OUT: return true;
+      case carve::POINT_ON:
+        if (hit_face != NULL) return carve::geom::dot((*i)->plane.N, hit_face->plane.N) < 0.0;
+        break;
+      default: break;
+      }
+    }
+    throw carve::exception("stock piece is not IN, OUT or ON the tool!");
+  }
+
+  // faces by their vertex loops, starting from the least vertex.
+  typedef std::map<std::vector<meshset_t::vertex_t *>, size_t> patch_map_t;
+
+  void rotateToMin(std::vector<meshset_t::vertex_t *> &loop) {
+    std::rotate(loop.begin(), std::min_element(loop.begin(), loop.end()), loop.end());
+  }
+
+  void destroy(std::list<meshset_t *> &meshes) {
+    for (std::list<meshset_t *>::iterator i = meshes.begin(); i != meshes.end(); ++i) delete *i;
+    meshes.clear();
+  }
+
+  meshset_t::vertex_t *mapVertex(const vector_t &v, vertex_map_t &vmap, std::deque<meshset_t::vertex_t> &vertices) {
+    vertex_map_t::iterator i = vmap.find(v);
+    if (i != vmap.end()) return (*i).second;
+    vertices.push_back(meshset_t::vertex_t(v));
+    vmap[v] = &vertices.back();
+    return &vertices.back();
+  }
+
+}
+
+
+
+carve::csg::SubtractionSession::SubtractionSession(const meshset_t *stock, size_t _leaf_size, size_t _internal_size) :
+    vertices(), faces(), rtree(NULL), leaf_size(_leaf_size), internal_size(_internal_size), csg() {
+  CARVE_ASSERT(leaf_size >= 1 && internal_size >= 2);
+
+  if (!stock->isClosed()) {
+    throw carve::exception("stock is not closed!");
+  }
+
+  for (size_t i = 0; i < stock->vertex_storage.size(); ++i) {
+    vertices.push_back(vertex_t(stock->vertex_storage[i].v));
+  }
+
+  std::vector<vertex_t *> vptr;
+  for (meshset_t::const_face_iter i = stock->faceBegin(); i != stock->faceEnd(); ++i) {
+    vptr.clear();
+    for (face_t::const_edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e) {
+      vptr.push_back(&vertices[stock->vertexIndex((*e).vert)]);
+    }
+    face_t *face = new face_t(vptr.begin(), vptr.end());
+    face->id = faces.size();
+    faces.push_back(face);
+  }
+
+  if (faces.size()) {
+    rtree = face_rtree_t::construct_STR(faces.begin(), faces.end(), leaf_size, internal_size);
+  } else {
+    rtree = new face_rtree_t;
+  }
+}
+
+
+
+carve::csg::SubtractionSession::~SubtractionSession() {
+  delete rtree;
+  for (size_t i = 0; i < faces.size(); ++i) {
+    delete faces[i];
+  }
+}
+
+
+
+void carve::csg::SubtractionSession::addFace(face_t *face) {
+  face->id = faces.size();
+  faces.push_back(face);
+  rtree->insert(face, leaf_size, internal_size);
+}
+
+
+
+void carve::csg::SubtractionSession::removeFace(face_t *face) {
+  // node bounds are unions of rounded boxes, and may fall just
+  // short of the face's own box.
+  aabb_t aabb = face->getAABB();
+  aabb.expand(carve::EPSILON);
+  rtree->remove(face, aabb);
+  faces[face->id] = faces.back();
+  faces[face->id]->id = face->id;
+  faces.pop_back();
+  delete face;
+}
+
+
+
+void carve::csg::SubtractionSession::findNearFaces(const carve::geom::aabb<3> &aabb,
+                                                   std::vector<face_t *> &near) const {
+  if (rtree->isEmpty()) return;
+
+  // grow the box until it reaches some of the stock, so the search
+  // costs no more than the distance from the tool to the surface.
+  carve::geom::aabb<3> box = aabb;
+  const double limit = rtree->bbox.extent.length() * 2.0 + aabb.extent.length();
+  box.extent += carve::geom::VECTOR(carve::EPSILON, carve::EPSILON, carve::EPSILON);
+  while (near.empty()) {
+    rtree->search(box, std::back_inserter(near));
+    if (box.extent.length() > limit) break;
+    box.extent *= 2.0;
+  }
+}
+
+
+
+carve::PointClass carve::csg::SubtractionSession::classifyPoint(const carve::geom::vector<3> &v,
+                                                                const std::vector<face_t *> &near) const {
+  std::vector<face_t *> hits;
+  aabb_t v_aabb(v);
+  v_aabb.expand(carve::EPSILON);
+  rtree->search(v_aabb, std::back_inserter(hits));
+  for (size_t i = 0; i < hits.size(); ++i) {
+    if (hits[i]->containsPoint(v)) return POINT_ON;
+  }
+
+  // try the nearest faces first, to keep the segment short.
+  std::vector<std::pair<double, face_t *> > targets;
+  targets.reserve(near.size());
+  for (size_t i = 0; i < near.size(); ++i) {
+    targets.push_back(std::make_pair((near[i]->centroid() - v).length2(), near[i]));
+  }
+  std::sort(targets.begin(), targets.end());
+
+  for (size_t t = 0; t < targets.size(); ++t) {
+    const face_t *target = targets[t].second;
+    vector_t p;
+    if (!facePoint(target, p)) continue;
+
+    // the segment from v to p must cross the target plainly.
+    const vector_t dir = (p - v).normalized();
+    if (fabs(carve::geom::dot(dir, target->plane.N)) < 1e-3) continue;
+
+    carve::geom::linesegment<3> line(v, p);
+    hits.clear();
+    rtree->search(line, std::back_inserter(hits));
+
+    size_t crossings = 0;
+    bool failed = false;
+    for (size_t i = 0; !failed && i < hits.size(); ++i) {
+      if (hits[i] == target) continue;
+      vector_t intersection;
+      switch (hits[i]->lineSegmentIntersection(line, intersection)) {
+      case INTERSECT_NONE:
+        break;
+      case INTERSECT_FACE:
+        if (fabs(carve::geom::dot(dir, hits[i]->plane.N)) < carve::EPSILON) failed = true;
+        ++crossings;
+        break;
+      default:
+        failed = true;
+        break;
+      }
+    }
+    if (failed) continue;
+
+    // just before p, the segment is inside the stock if it reaches
+    // the target from behind.
+    bool in = carve::geom::dot(dir, target->plane.N) > 0.0;
+    if (crossings & 1) in = !in;
+    return in ? POINT_IN : POINT_OUT;
+  }
+
+  return POINT_UNK;
+}
+
+
+
+bool carve::csg::SubtractionSession::subtract(meshset_t *tool) {
+  static carve::TimingName FUNC_NAME("SubtractionSession::subtract()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  if (!tool->isClosed()) {
+    throw carve::exception("tool is not closed!");
+  }
+
+  PreparedMeshSet prepared_tool(tool);
+  const aabb_t tool_aabb = prepared_tool.getAABB();
+
+  aabb_t query = tool_aabb;
+  query.extent += carve::geom::VECTOR(carve::EPSILON, carve::EPSILON, carve::EPSILON);
+
+  // the faces of the stock that the tool can touch. no other face
+  // is cut, and the edges between these faces and the others lie
+  // outside the tool, so the patch can be replaced independently.
+  std::vector<face_t *> patch;
+  if (!rtree->isEmpty()) rtree->search(query, std::back_inserter(patch));
+
+  std::list<meshset_t *> stock_pieces;
+  std::list<meshset_t *> tool_pieces;
+  std::vector<Piece> pieces;
+  std::auto_ptr<meshset_t> local;
+
+  try {
+    if (patch.size()) {
+      std::map<const vertex_t *, int> local_index;
+      std::vector<vector_t> points;
+      std::vector<int> indices;
+      for (size_t i = 0; i < patch.size(); ++i) {
+        indices.push_back((int)patch[i]->nVertices());
+        for (face_t::edge_iter_t e = patch[i]->begin(); e != patch[i]->end(); ++e) {
+          std::map<const vertex_t *, int>::iterator j = local_index.find((*e).vert);
+          if (j == local_index.end()) {
+            j = local_index.insert(std::make_pair((const vertex_t *)(*e).vert, (int)points.size())).first;
+            points.push_back((*e).vert->v);
+          }
+          indices.push_back((*j).second);
+        }
+      }
+      local.reset(new meshset_t(points, patch.size(), indices));
+
+      PreparedMeshSet prepared_local(local.get());
+      V2Set shared_edges;
+      csg.slice(prepared_local, prepared_tool, stock_pieces, tool_pieces, &shared_edges);
+
+      if (shared_edges.empty()) {
+        // the tool does not cut the stock, and is entirely inside or
+        // outside it. components of the stock that it encloses are
+        // removed; if there are none, it may make a cavity.
+        bool removed = false;
+        for (std::list<meshset_t *>::iterator i = stock_pieces.begin(); i != stock_pieces.end(); ++i) {
+          pieces.push_back(Piece(*i, keepStockPiece(prepared_tool, *i), false));
+          if (!pieces.back().keep) removed = true;
+        }
+        if (!removed) {
+          pieces.clear();
+          destroy(stock_pieces);
+        }
+        destroy(tool_pieces);
+      } else {
+        for (std::list<meshset_t *>::iterator i = stock_pieces.begin(); i != stock_pieces.end(); ++i) {
+          pieces.push_back(Piece(*i, keepStockPiece(prepared_tool, *i), false));
+        }
+
+        // pieces of the tool inside the stock are kept, inverted.
+        // pieces on the surface of the stock duplicate or cancel a
+        // piece of the stock, and are dropped.
+        for (std::list<meshset_t *>::iterator i = tool_pieces.begin(); i != tool_pieces.end(); ++i) {
+          PointClass pc = POINT_UNK;
+          for (meshset_t::face_iter j = (*i)->faceBegin(); pc == POINT_UNK && j != (*i)->faceEnd(); ++j) {
+            vector_t v;
+            if (facePoint(*j, v)) pc = classifyPoint(v, patch);
+          }
+          if (pc == POINT_UNK) {
+            throw carve::exception("tool piece is not IN, OUT or ON the stock!");
+          }
+          pieces.push_back(Piece(*i, pc == POINT_IN, true));
+        }
+      }
+    }
+
+    if (pieces.empty()) {
+      std::vector<face_t *> near(patch);
+      if (near.empty()) findNearFaces(tool_aabb, near);
+
+      PointClass pc = POINT_ON;
+      for (size_t i = 0; pc == POINT_ON && i < tool->vertex_storage.size(); ++i) {
+        pc = near.size() ? classifyPoint(tool->vertex_storage[i].v, near) : POINT_OUT;
+      }
+      if (pc != POINT_IN && pc != POINT_OUT) {
+        throw carve::exception("tool is not IN or OUT of the stock!");
+      }
+      if (pc == POINT_OUT) return false;
+
+      // the tool makes a cavity in the stock.
+      pieces.push_back(Piece(tool, true, true));
+      patch.clear();
+    }
+  } catch (...) {
+    destroy(stock_pieces);
+    destroy(tool_pieces);
+    throw;
+  }
+
+  // replace the patch. vertices are matched to those of the stock
+  // by position, which slicing preserves exactly, and new vertices
+  // are shared between the stock and tool pieces in the same way.
+  vertex_map_t vmap;
+  for (size_t i = 0; i < patch.size(); ++i) {
+    for (face_t::edge_iter_t e = patch[i]->begin(); e != patch[i]->end(); ++e) {
+      vmap[(*e).vert->v] = (*e).vert;
+    }
+  }
+
+  // faces of the patch that come through slicing whole stay where
+  // they are.
+  patch_map_t patch_faces;
+  std::vector<vertex_t *> vptr;
+  for (size_t i = 0; i < patch.size(); ++i) {
+    patch[i]->getVertices(vptr);
+    rotateToMin(vptr);
+    patch_faces[vptr] = i;
+  }
+
+  std::vector<char> reused(patch.size(), 0);
+  std::vector<face_t *> added;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    if (!pieces[i].keep) continue;
+    for (meshset_t::face_iter j = pieces[i].mesh->faceBegin(); j != pieces[i].mesh->faceEnd(); ++j) {
+      vptr.clear();
+      for (face_t::edge_iter_t e = (*j)->begin(); e != (*j)->end(); ++e) {
+        vertex_t *v = mapVertex((*e).vert->v, vmap, vertices);
+        if (vptr.empty() || vptr.back() != v) vptr.push_back(v);
+      }
+      while (vptr.size() > 1 && vptr.back() == vptr.front()) vptr.pop_back();
+      if (vptr.size() < 3) continue;
+      if (pieces[i].invert) std::reverse(vptr.begin(), vptr.end());
+
+      rotateToMin(vptr);
+      patch_map_t::iterator k = patch_faces.find(vptr);
+      if (k != patch_faces.end()) {
+        reused[(*k).second] = 1;
+      } else {
+        added.push_back(new face_t(vptr.begin(), vptr.end()));
+      }
+    }
+  }
+
+  bool changed = added.size() != 0;
+  for (size_t i = 0; i < patch.size(); ++i) {
+    if (reused[i]) continue;
+    removeFace(patch[i]);
+    changed = true;
+  }
+  for (size_t i = 0; i < added.size(); ++i) {
+    addFace(added[i]);
+  }
+
+  destroy(stock_pieces);
+  destroy(tool_pieces);
+
+  return changed;
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::SubtractionSession::result() const {
+  std::map<const vertex_t *, int> index;
+  std::vector<vector_t> points;
+  std::vector<int> indices;
+  indices.reserve(faces.size() * 4);
+
+  for (size_t i = 0; i < faces.size(); ++i) {
+    indices.push_back((int)faces[i]->nVertices());
+    for (face_t::edge_iter_t e = faces[i]->begin(); e != faces[i]->end(); ++e) {
+      std::map<const vertex_t *, int>::iterator j = index.find((*e).vert);
+      if (j == index.end()) {
+        j = index.insert(std::make_pair((const vertex_t *)(*e).vert, (int)points.size())).first;
+        points.push_back((*e).vert->v);
+      }
+      indices.push_back((*j).second);
+    }
+  }
+
+  return new meshset_t(points, faces.size(), indices);
+}
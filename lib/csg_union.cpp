@@ -0,0 +1,238 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg.hpp>
+#include <carve/djset.hpp>
+#include <carve/flat_rtree.hpp>
+#include <carve/timing.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+  typedef carve::mesh::MeshSet<3> meshset_t;
+
+  // an operand of a union, which is deleted once it has been used if
+  // it is an intermediate result.
+  struct Operand {
+    meshset_t *mesh;
+    bool owned;
+
+    Operand() : mesh(NULL), owned(false) { }
+    Operand(meshset_t *_mesh, bool _owned) : mesh(_mesh), owned(_owned) { }
+  };
+
+  typedef std::vector<Operand> cluster_t;
+
+
+
+  void destroy(std::vector<cluster_t> &clusters) {
+    for (size_t c = 0; c < clusters.size(); ++c) {
+      for (size_t i = 0; i < clusters[c].size(); ++i) {
+        if (clusters[c][i].owned) delete clusters[c][i].mesh;
+      }
+      clusters[c].clear();
+    }
+  }
+
+
+
+  // group operands whose bounding boxes overlap, directly or through
+  // other operands. The operands of each cluster, and the clusters
+  // themselves, are listed in the order of the leaves of an STR tree
+  // built over the bounding boxes, so that operands adjacent in a
+  // cluster are close together.
+  void makeClusters(const std::vector<meshset_t *> &operands,
+                    std::vector<cluster_t> &clusters) {
+    typedef carve::geom::FlatRTree<3, size_t> rtree_t;
+
+    std::vector<rtree_t::data_aabb_t> boxes(operands.size());
+    for (size_t i = 0; i < operands.size(); ++i) {
+      boxes[i].data = i;
+      boxes[i].bbox = operands[i]->getAABB();
+      boxes[i].bbox.extent += carve::geom::VECTOR(carve::EPSILON, carve::EPSILON, carve::EPSILON);
+    }
+
+    // construct_STR() sorts the boxes into the order of the leaves.
+    std::vector<rtree_t::data_aabb_t> order(boxes);
+    std::auto_ptr<rtree_t> rtree(rtree_t::construct_STR(order, 4, 4));
+
+    carve::djset::djset sets(operands.size());
+    std::vector<size_t> near;
+    for (size_t i = 0; i < operands.size(); ++i) {
+      near.clear();
+      rtree->search(boxes[i].bbox, std::back_inserter(near));
+      // search() reports every entry of the leaves that it reaches,
+      // not only those that overlap.
+      for (size_t j = 0; j < near.size(); ++j) {
+        if (near[j] != i && boxes[i].bbox.intersects(boxes[near[j]].bbox)) {
+          sets.merge_sets(i, near[j]);
+        }
+      }
+    }
+
+    std::map<size_t, size_t> cluster_of;
+    for (size_t k = 0; k < order.size(); ++k) {
+      const size_t i = order[k].data;
+      const size_t head = sets.find_set_head(i);
+      std::map<size_t, size_t>::iterator c = cluster_of.find(head);
+      if (c == cluster_of.end()) {
+        c = cluster_of.insert(std::make_pair(head, clusters.size())).first;
+        clusters.push_back(cluster_t());
+      }
+      clusters[(*c).second].push_back(Operand(operands[i], false));
+    }
+  }
+
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::CSG::computeUnion(
+    const std::vector<meshset_t *> &operands,
+    CLASSIFY_TYPE classify_type) {
+  static carve::TimingName FUNC_NAME("CSG::computeUnion()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  if (operands.size() == 0) {
+    std::vector<meshset_t::mesh_t *> no_meshes;
+    return new meshset_t(no_meshes);
+  }
+  if (operands.size() == 1) {
+    return operands[0]->clone();
+  }
+
+  std::vector<cluster_t> clusters;
+  makeClusters(operands, clusters);
+
+  // hooks are called from within the calculation, and may not expect
+  // to be called concurrently.
+  bool parallel = true;
+  for (unsigned i = 0; i < Hooks::HOOK_MAX; ++i) {
+    if (hooks.hasHook(i)) parallel = false;
+  }
+
+  // each level of the reduction unites adjacent pairs of the
+  // operands of every cluster, carrying an odd operand over to the
+  // next level.
+  std::vector<std::pair<size_t, size_t> > pairs;
+  std::vector<meshset_t *> results;
+  std::vector<char> failed;
+  std::vector<std::string> error;
+
+  while (true) {
+    pairs.clear();
+    for (size_t c = 0; c < clusters.size(); ++c) {
+      for (size_t i = 0; i + 1 < clusters[c].size(); i += 2) {
+        pairs.push_back(std::make_pair(c, i));
+      }
+    }
+    if (!pairs.size()) break;
+
+    const int n_pairs = (int)pairs.size();
+    results.assign(pairs.size(), NULL);
+    failed.assign(pairs.size(), 0);
+    error.assign(pairs.size(), std::string());
+
+#pragma omp parallel for schedule(dynamic, 1) if (parallel && n_pairs > 1)
+    for (int p = 0; p < n_pairs; ++p) {
+      const cluster_t &cluster = clusters[pairs[p].first];
+      meshset_t *a = cluster[pairs[p].second].mesh;
+      meshset_t *b = cluster[pairs[p].second + 1].mesh;
+      try {
+        if (parallel) {
+          CSG csg;
+          csg.intersection_kernel = intersection_kernel;
+          csg.point_classifier = point_classifier;
+          csg.pass_through_untouched_faces = pass_through_untouched_faces;
+          results[p] = csg.compute(a, b, UNION, NULL, classify_type);
+        } else {
+          results[p] = compute(a, b, UNION, NULL, classify_type);
+        }
+      } catch (carve::exception &e) {
+        failed[p] = 1;
+        error[p] = e.str();
+      } catch (...) {
+        failed[p] = 1;
+        error[p] = "unknown exception in union of operands";
+      }
+    }
+
+    for (size_t p = 0; p < pairs.size(); ++p) {
+      if (failed[p]) {
+        for (size_t q = 0; q < results.size(); ++q) delete results[q];
+        destroy(clusters);
+        throw carve::exception(error[p]);
+      }
+    }
+
+    std::vector<cluster_t> next(clusters.size());
+    for (size_t p = 0; p < pairs.size(); ++p) {
+      next[pairs[p].first].push_back(Operand(results[p], true));
+    }
+    for (size_t c = 0; c < clusters.size(); ++c) {
+      cluster_t &cluster = clusters[c];
+      for (size_t i = 0; i + 1 < cluster.size(); i += 2) {
+        if (cluster[i].owned) delete cluster[i].mesh;
+        if (cluster[i + 1].owned) delete cluster[i + 1].mesh;
+      }
+      if (cluster.size() % 2) next[c].push_back(cluster.back());
+    }
+    clusters.swap(next);
+  }
+
+  if (clusters.size() == 1 && clusters[0][0].owned) {
+    return clusters[0][0].mesh;
+  }
+
+  // gather the faces of every cluster into one meshset. The faces of
+  // a meshset may be allocated in its arena, so meshes are not moved
+  // between meshsets; instead the vertex loops of the faces are
+  // copied into an index buffer.
+  std::vector<carve::geom::vector<3> > points;
+  std::vector<int> face_indices;
+  size_t n_faces = 0;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const meshset_t *source = clusters[c][0].mesh;
+    const int offset = (int)points.size();
+    for (size_t v = 0; v < source->vertex_storage.size(); ++v) {
+      points.push_back(source->vertex_storage[v].v);
+    }
+    for (meshset_t::const_face_iter f = source->faceBegin(); f != source->faceEnd(); ++f) {
+      const meshset_t::face_t *face = *f;
+      face_indices.push_back((int)face->n_edges);
+      const meshset_t::edge_t *e = face->edge;
+      do {
+        face_indices.push_back(offset + (int)source->vertexIndex(e->vert));
+        e = e->next;
+      } while (e != face->edge);
+      ++n_faces;
+    }
+  }
+
+  meshset_t *result = new meshset_t(points, n_faces, face_indices);
+
+  destroy(clusters);
+
+  return result;
+}
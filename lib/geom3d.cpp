@@ -52,6 +52,34 @@ not_fwd:
 not_rev:
         return 0;
       }
+
+      double radicalInverse(unsigned n, unsigned base) {
+        const double inv_base = 1.0 / base;
+        double f = inv_base, r = 0.0;
+        while (n) {
+          r += f * (n % base);
+          n /= base;
+          f *= inv_base;
+        }
+        return r;
+      }
+    }
+
+    Vector RayDirections::next() {
+      ++index;
+
+      // the shifts keep the first directions away from the
+      // coordinate planes, which axis aligned inputs are full of.
+      double u = radicalInverse(index, 2) + 0.2719736;
+      double v = radicalInverse(index, 3) + 0.6180340;
+      if (u >= 1.0) u -= 1.0;
+      if (v >= 1.0) v -= 1.0;
+
+      double z = 1.0 - 2.0 * u;
+      double r = sqrt(std::max(0.0, 1.0 - z * z));
+      double a = v * M_TWOPI;
+
+      return carve::geom::VECTOR(r * cos(a), r * sin(a), z);
     }
 
     bool planeIntersection(const Plane &a, const Plane &b, Ray &r) {
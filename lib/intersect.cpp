@@ -20,6 +20,7 @@
 #endif
 
 #include <carve/csg.hpp>
+#include <carve/winding_number.hpp>
 #include <carve/pointset.hpp>
 #include <carve/polyline.hpp>
 
@@ -43,6 +44,10 @@
 
 #include <memory>
 
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
 
 
 carve::csg::VertexPool::VertexPool() {
@@ -71,6 +76,95 @@ bool carve::csg::VertexPool::inPool(vertex_t *v) const {
   return false;
 }
 
+void carve::csg::VertexPool::splice(VertexPool &other) {
+  // blocks are moved, not copied, so pointers into other remain valid.
+  pool.splice(pool.end(), other.pool);
+}
+
+
+
+/** 
+ * \brief Destination for intersections found by one worker of
+ * generateIntersections().
+ *
+ * New intersections are recorded in \a found and new vertices are
+ * allocated from \a pool. Lookups consult both \a found and the
+ * shared table, which is read-only while a pass is running. In the
+ * serial case \a found is the shared table itself.
+ */
+struct carve::csg::CSG::IntersectionScratch {
+  Intersections &shared;
+  Intersections &found;
+  VertexPool &pool;
+
+  // buffers reused by generateFaceIntersections().
+  std::vector<meshset_t::edge_t *> edges_a, edges_b;
+  std::vector<double> dist_ab, dist_ba;
+
+  // buffer reused by face containment tests.
+  std::vector<carve::geom2d::P2> projected;
+
+  IntersectionScratch(Intersections &_shared, Intersections &_found, VertexPool &_pool) :
+      shared(_shared), found(_found), pool(_pool), edges_a(), edges_b(), dist_ab(), dist_ba(), projected() {
+  }
+
+  template<typename a_t, typename b_t>
+  bool intersects(a_t a, b_t b) {
+    if (shared.intersects(a, b)) return true;
+    return &found != &shared && found.intersects(a, b);
+  }
+
+  void record(IObj a, IObj b, meshset_t::vertex_t *p) {
+    found.record(a, b, p);
+  }
+};
+
+
+
+/**
+ * Makes the arena of a CSG object the current arena of the calling
+ * thread while a computation runs. Members of the CSG object that
+ * may hold arena storage are cleared before the arena itself, so the
+ * scope must be constructed before any other temporary of the
+ * computation, and is destroyed after all of them.
+ */
+struct carve::csg::CSG::TemporaryScope {
+  CSG &csg;
+  carve::Arena::Scope scope;
+
+  TemporaryScope(CSG &_csg) : csg(_csg), scope(&_csg.arena) {
+  }
+
+  ~TemporaryScope() {
+    csg.intersections.clear();
+    csg.arena.clear();
+  }
+};
+
+
+
+/** 
+ * \brief Merge the intersections recorded by one worker into the shared table.
+ *
+ * Workers cannot see each other's records, so two workers may find
+ * the same intersection (e.g. via a face pair and its reverse). The
+ * record already present wins, which reproduces the serial outcome
+ * provided that workers are merged in processing order. Vertices of
+ * discarded records stay in the worker's pool, unreferenced.
+ * 
+ * @param[in,out] into The shared table.
+ * @param[in] from The worker table.
+ */
+static void mergeIntersections(carve::csg::Intersections &into,
+                               const carve::csg::Intersections &from) {
+  for (carve::csg::Intersections::const_iterator i = from.begin(), ie = from.end(); i != ie; ++i) {
+    carve::csg::Intersections::mapped_type &tgt = into[(*i).first];
+    for (carve::csg::Intersections::mapped_type::const_iterator j = (*i).second.begin(), je = (*i).second.end(); j != je; ++j) {
+      tgt.insert(*j);
+    }
+  }
+}
+
 
 
 #if defined(CARVE_DEBUG_WRITE_PLY_DATA)
@@ -672,32 +766,34 @@ void carve::csg::CSG::intersectingFacePairs(detail::Data &data) {
 
 
 
-void carve::csg::CSG::_generateVertexVertexIntersections(meshset_t::vertex_t *va,
+void carve::csg::CSG::_generateVertexVertexIntersections(IntersectionScratch &scratch,
+                                                         meshset_t::vertex_t *va,
                                                          meshset_t::edge_t *eb) {
-  if (intersections.intersects(va, eb->v1())) {
+  if (scratch.intersects(va, eb->v1())) {
     return;
   }
 
   double d_v1 = carve::geom::distance2(va->v, eb->v1()->v);
 
   if  (d_v1 < carve::EPSILON2) {
-    intersections.record(va, eb->v1(), va);
+    scratch.record(va, eb->v1(), va);
   }
 }
 
 
 
-void carve::csg::CSG::generateVertexVertexIntersections(meshset_t::face_t *a,
-                                                        const std::vector<meshset_t::face_t *> &b) {
+void carve::csg::CSG::generateVertexVertexIntersections(IntersectionScratch &scratch,
+                                                        const face_pair_run_t &run) {
+  meshset_t::face_t *a = run.first->first;
   meshset_t::edge_t *ea, *eb;
 
   ea = a->edge;
   do {
-    for (size_t i = 0; i < b.size(); ++i) {
-      meshset_t::face_t *t = b[i];
+    for (const face_pair_t *i = run.first; i != run.second; ++i) {
+      meshset_t::face_t *t = i->second;
       eb = t->edge;
       do {
-        _generateVertexVertexIntersections(ea->v1(), eb);
+        _generateVertexVertexIntersections(scratch, ea->v1(), eb);
         eb = eb->next;
       } while (eb != t->edge);
     }
@@ -707,9 +803,10 @@ void carve::csg::CSG::generateVertexVertexIntersections(meshset_t::face_t *a,
 
 
 
-void carve::csg::CSG::_generateVertexEdgeIntersections(meshset_t::vertex_t *va,
+void carve::csg::CSG::_generateVertexEdgeIntersections(IntersectionScratch &scratch,
+                                                       meshset_t::vertex_t *va,
                                                        meshset_t::edge_t *eb) {
-  if (intersections.intersects(va, eb)) {
+  if (scratch.intersects(va, eb)) {
     return;
   }
 
@@ -724,24 +821,25 @@ void carve::csg::CSG::_generateVertexEdgeIntersections(meshset_t::vertex_t *va,
 
   if (a < b * carve::EPSILON2) {
     // vertex-edge intersection
-    intersections.record(eb, va, va);
-    if (eb->rev) intersections.record(eb->rev, va, va);
+    scratch.record(eb, va, va);
+    if (eb->rev) scratch.record(eb->rev, va, va);
   }
 }
 
 
 
-void carve::csg::CSG::generateVertexEdgeIntersections(meshset_t::face_t *a,
-                                                      const std::vector<meshset_t::face_t *> &b) {
+void carve::csg::CSG::generateVertexEdgeIntersections(IntersectionScratch &scratch,
+                                                      const face_pair_run_t &run) {
+  meshset_t::face_t *a = run.first->first;
   meshset_t::edge_t *ea, *eb;
 
   ea = a->edge;
   do {
-    for (size_t i = 0; i < b.size(); ++i) {
-      meshset_t::face_t *t = b[i];
+    for (const face_pair_t *i = run.first; i != run.second; ++i) {
+      meshset_t::face_t *t = i->second;
       eb = t->edge;
       do {
-        _generateVertexEdgeIntersections(ea->v1(), eb);
+        _generateVertexEdgeIntersections(scratch, ea->v1(), eb);
         eb = eb->next;
       } while (eb != t->edge);
     }
@@ -751,9 +849,10 @@ void carve::csg::CSG::generateVertexEdgeIntersections(meshset_t::face_t *a,
 
 
 
-void carve::csg::CSG::_generateEdgeEdgeIntersections(meshset_t::edge_t *ea,
+void carve::csg::CSG::_generateEdgeEdgeIntersections(IntersectionScratch &scratch,
+                                                     meshset_t::edge_t *ea,
                                                      meshset_t::edge_t *eb) {
-  if (intersections.intersects(ea, eb)) {
+  if (scratch.intersects(ea, eb)) {
     return;
   }
 
@@ -774,11 +873,11 @@ void carve::csg::CSG::_generateEdgeEdgeIntersections(meshset_t::edge_t *ea,
   case carve::RR_INTERSECTION: {
     // edges intersect
     if (mu1 >= 0.0 && mu1 <= 1.0 && mu2 >= 0.0 && mu2 <= 1.0) {
-      meshset_t::vertex_t *p = vertex_pool.get((p1 + p2) / 2.0);
-      intersections.record(ea, eb, p);
-      if (ea->rev) intersections.record(ea->rev, eb, p);
-      if (eb->rev) intersections.record(ea, eb->rev, p);
-      if (ea->rev && eb->rev) intersections.record(ea->rev, eb->rev, p);
+      meshset_t::vertex_t *p = scratch.pool.get((p1 + p2) / 2.0);
+      scratch.record(ea, eb, p);
+      if (ea->rev) scratch.record(ea->rev, eb, p);
+      if (eb->rev) scratch.record(ea, eb->rev, p);
+      if (ea->rev && eb->rev) scratch.record(ea->rev, eb->rev, p);
     }
     break;
   }
@@ -799,17 +898,18 @@ void carve::csg::CSG::_generateEdgeEdgeIntersections(meshset_t::edge_t *ea,
 
 
 
-void carve::csg::CSG::generateEdgeEdgeIntersections(meshset_t::face_t *a,
-                                                    const std::vector<meshset_t::face_t *> &b) {
+void carve::csg::CSG::generateEdgeEdgeIntersections(IntersectionScratch &scratch,
+                                                    const face_pair_run_t &run) {
+  meshset_t::face_t *a = run.first->first;
   meshset_t::edge_t *ea, *eb;
 
   ea = a->edge;
   do {
-    for (size_t i = 0; i < b.size(); ++i) {
-      meshset_t::face_t *t = b[i];
+    for (const face_pair_t *i = run.first; i != run.second; ++i) {
+      meshset_t::face_t *t = i->second;
       eb = t->edge;
       do {
-        _generateEdgeEdgeIntersections(ea, eb);
+        _generateEdgeEdgeIntersections(scratch, ea, eb);
         eb = eb->next;
       } while (eb != t->edge);
     }
@@ -819,31 +919,120 @@ void carve::csg::CSG::generateEdgeEdgeIntersections(meshset_t::face_t *a,
 
 
 
-void carve::csg::CSG::_generateVertexFaceIntersections(meshset_t::face_t *fa,
+/** 
+ * \brief The projected vertices of a face, taken from the face
+ * geometry cache of its MeshSet if it has been built.
+ */
+static void projectedFaceVertices(const carve::mesh::MeshSet<3>::face_t *f,
+                                  std::vector<carve::geom2d::P2> &verts) {
+  const carve::mesh::FaceGeometry<3> *geom = NULL;
+  if (f->mesh != NULL && f->mesh->meshset != NULL) geom = f->mesh->meshset->cachedFaceGeometry();
+
+  if (geom != NULL) {
+    geom->getProjectedVertices(f, verts);
+  } else {
+    f->getProjectedVertices(verts);
+  }
+}
+
+
+
+/** 
+ * \brief The projected vertices of a triangular face, taken from the
+ * face geometry cache of its MeshSet if it has been built.
+ */
+static void projectedTriangle(const carve::mesh::MeshSet<3>::face_t *f,
+                              carve::geom2d::P2 *tri) {
+  const carve::mesh::FaceGeometry<3> *geom = NULL;
+  if (f->mesh != NULL && f->mesh->meshset != NULL) geom = f->mesh->meshset->cachedFaceGeometry();
+
+  if (geom != NULL) {
+    geom->getProjectedTriangle(f, tri);
+  } else {
+    f->getProjectedTriangle(tri);
+  }
+}
+
+
+
+/** 
+ * \brief As Face::containsPoint(), using cached projected vertices.
+ */
+static bool faceContainsPoint(const carve::mesh::MeshSet<3>::face_t *f,
+                              const carve::mesh::MeshSet<3>::vertex_t::vector_t &p,
+                              std::vector<carve::geom2d::P2> &verts) {
+  if (!carve::math::ZERO(carve::geom::distance(f->plane, p))) return false;
+  if (f->n_edges == 3) {
+    carve::geom2d::P2 tri[3];
+    projectedTriangle(f, tri);
+    return carve::geom2d::pointInTriangle(tri, f->project(p)).iclass != carve::POINT_OUT;
+  }
+  projectedFaceVertices(f, verts);
+  return carve::geom2d::pointInPoly(verts, f->project(p)).iclass != carve::POINT_OUT;
+}
+
+
+
+/** 
+ * \brief As Face::simpleLineSegmentIntersection(), using cached projected vertices.
+ */
+static bool faceSimpleLineSegmentIntersection(const carve::mesh::MeshSet<3>::face_t *f,
+                                              const carve::geom3d::LineSegment &line,
+                                              carve::mesh::MeshSet<3>::vertex_t::vector_t &intersection,
+                                              std::vector<carve::geom2d::P2> &verts) {
+  if (!line.OK()) return false;
+
+  carve::mesh::MeshSet<3>::vertex_t::vector_t p;
+  carve::IntersectionClass intersects = carve::geom3d::lineSegmentPlaneIntersection(f->plane, line, p);
+  if (intersects == carve::INTERSECT_NONE || intersects == carve::INTERSECT_BAD) {
+    return false;
+  }
+
+  bool inside;
+  if (f->n_edges == 3) {
+    carve::geom2d::P2 tri[3];
+    projectedTriangle(f, tri);
+    inside = carve::geom2d::pointInTriangleSimple(tri, f->project(p));
+  } else {
+    projectedFaceVertices(f, verts);
+    inside = carve::geom2d::pointInPolySimple(verts, f->project(p));
+  }
+  if (inside) {
+    intersection = p;
+    return true;
+  }
+  return false;
+}
+
+
+
+void carve::csg::CSG::_generateVertexFaceIntersections(IntersectionScratch &scratch,
+                                                       meshset_t::face_t *fa,
                                                        meshset_t::edge_t *eb) {
-  if (intersections.intersects(eb->v1(), fa)) {
+  if (scratch.intersects(eb->v1(), fa)) {
     return;
   }
 
   double d1 = carve::geom::distance(fa->plane, eb->v1()->v);
 
   if (fabs(d1) < carve::EPSILON &&
-      fa->containsPoint(eb->v1()->v)) {
-    intersections.record(eb->v1(), fa, eb->v1());
+      faceContainsPoint(fa, eb->v1()->v, scratch.projected)) {
+    scratch.record(eb->v1(), fa, eb->v1());
   }
 }
 
 
 
-void carve::csg::CSG::generateVertexFaceIntersections(meshset_t::face_t *a,
-                                                      const std::vector<meshset_t::face_t *> &b) {
+void carve::csg::CSG::generateVertexFaceIntersections(IntersectionScratch &scratch,
+                                                      const face_pair_run_t &run) {
+  meshset_t::face_t *a = run.first->first;
   meshset_t::edge_t *eb;
 
-  for (size_t i = 0; i < b.size(); ++i) {
-    meshset_t::face_t *t = b[i];
+  for (const face_pair_t *i = run.first; i != run.second; ++i) {
+    meshset_t::face_t *t = i->second;
     eb = t->edge;
     do {
-      _generateVertexFaceIntersections(a, eb);
+      _generateVertexFaceIntersections(scratch, a, eb);
       eb = eb->next;
     } while (eb != t->edge);
   }
@@ -851,31 +1040,33 @@ void carve::csg::CSG::generateVertexFaceIntersections(meshset_t::face_t *a,
 
 
 
-void carve::csg::CSG::_generateEdgeFaceIntersections(meshset_t::face_t *fa,
+void carve::csg::CSG::_generateEdgeFaceIntersections(IntersectionScratch &scratch,
+                                                     meshset_t::face_t *fa,
                                                      meshset_t::edge_t *eb) {
-  if (intersections.intersects(eb, fa)) {
+  if (scratch.intersects(eb, fa)) {
     return;
   }
 
   meshset_t::vertex_t::vector_t _p;
-  if (fa->simpleLineSegmentIntersection(carve::geom3d::LineSegment(eb->v1()->v, eb->v2()->v), _p)) {
-    meshset_t::vertex_t *p = vertex_pool.get(_p);
-    intersections.record(eb, fa, p);
-    if (eb->rev) intersections.record(eb->rev, fa, p);
+  if (faceSimpleLineSegmentIntersection(fa, carve::geom3d::LineSegment(eb->v1()->v, eb->v2()->v), _p, scratch.projected)) {
+    meshset_t::vertex_t *p = scratch.pool.get(_p);
+    scratch.record(eb, fa, p);
+    if (eb->rev) scratch.record(eb->rev, fa, p);
   }
 }
 
 
 
-void carve::csg::CSG::generateEdgeFaceIntersections(meshset_t::face_t *a,
-                                                    const std::vector<meshset_t::face_t *> &b) {
+void carve::csg::CSG::generateEdgeFaceIntersections(IntersectionScratch &scratch,
+                                                    const face_pair_run_t &run) {
+  meshset_t::face_t *a = run.first->first;
   meshset_t::edge_t *eb;
 
-  for (size_t i = 0; i < b.size(); ++i) {
-    meshset_t::face_t *t = b[i];
+  for (const face_pair_t *i = run.first; i != run.second; ++i) {
+    meshset_t::face_t *t = i->second;
     eb = t->edge;
     do {
-      _generateEdgeFaceIntersections(a, eb);
+      _generateEdgeFaceIntersections(scratch, a, eb);
       eb = eb->next;
     } while (eb != t->edge);
   }
@@ -883,46 +1074,172 @@ void carve::csg::CSG::generateEdgeFaceIntersections(meshset_t::face_t *a,
 
 
 
+/** 
+ * \brief Collect the edges of a face, and its largest vertex distance from its own plane.
+ */
+static double faceEdgesAndPlaneDeviation(carve::mesh::MeshSet<3>::face_t *f,
+                                         std::vector<carve::mesh::MeshSet<3>::edge_t *> &edges) {
+  double dev = 0.0;
+  edges.clear();
+  carve::mesh::MeshSet<3>::edge_t *e = f->edge;
+  do {
+    edges.push_back(e);
+    dev = std::max(dev, fabs(carve::geom::distance(f->plane, e->vert->v)));
+    e = e->next;
+  } while (e != f->edge);
+  return dev;
+}
+
+
+
+// true if both values lie on the same side of [-limit, +limit].
+static inline bool sameSideBeyond(double d1, double d2, double limit) {
+  return (d1 > limit && d2 > limit) || (d1 < -limit && d2 < -limit);
+}
+
+
+
+void carve::csg::CSG::generateFaceIntersections(IntersectionScratch &scratch,
+                                                const face_pair_run_t &run) {
+  meshset_t::face_t *fa = run.first->first;
+  std::vector<meshset_t::edge_t *> &edges_a = scratch.edges_a;
+  std::vector<meshset_t::edge_t *> &edges_b = scratch.edges_b;
+  std::vector<double> &dist_ab = scratch.dist_ab; // vertices of b from the plane of a.
+  std::vector<double> &dist_ba = scratch.dist_ba; // vertices of a from the plane of b.
+
+  const double dev_a = faceEdgesAndPlaneDeviation(fa, edges_a);
+  const size_t n_a = edges_a.size();
+
+  for (const face_pair_t *p = run.first; p != run.second; ++p) {
+    meshset_t::face_t *fb = p->second;
+    const double dev_b = faceEdgesAndPlaneDeviation(fb, edges_b);
+    const size_t n_b = edges_b.size();
+
+    dist_ab.resize(n_b);
+    for (size_t j = 0; j < n_b; ++j) {
+      dist_ab[j] = carve::geom::distance(fa->plane, edges_b[j]->vert->v);
+    }
+    dist_ba.resize(n_a);
+    for (size_t i = 0; i < n_a; ++i) {
+      dist_ba[i] = carve::geom::distance(fb->plane, edges_a[i]->vert->v);
+    }
+
+    // every point of face a (b) lies within dev_a (dev_b) of its
+    // plane, so anything further than this from that plane is more
+    // than EPSILON from the face.
+    const double far_a = carve::EPSILON + dev_a;
+    const double far_b = carve::EPSILON + dev_b;
+
+    // vertex-vertex. the test is symmetric, so one direction suffices.
+    for (size_t i = 0; i < n_a; ++i) {
+      if (fabs(dist_ba[i]) > far_b) continue;
+      for (size_t j = 0; j < n_b; ++j) {
+        _generateVertexVertexIntersections(scratch, edges_a[i]->vert, edges_b[j]);
+      }
+    }
+
+    // vertex-edge, in both directions.
+    for (size_t i = 0; i < n_a; ++i) {
+      for (size_t j = 0; j < n_b; ++j) {
+        _generateVertexEdgeIntersections(scratch, edges_a[i]->vert, edges_b[j]);
+      }
+    }
+    for (size_t j = 0; j < n_b; ++j) {
+      for (size_t i = 0; i < n_a; ++i) {
+        _generateVertexEdgeIntersections(scratch, edges_b[j]->vert, edges_a[i]);
+      }
+    }
+
+    // edge-edge. an edge entirely to one side of the other face's
+    // plane cannot come within EPSILON of any of its edges.
+    for (size_t i = 0; i < n_a; ++i) {
+      if (sameSideBeyond(dist_ba[i], dist_ba[(i + 1) % n_a], far_b)) continue;
+      for (size_t j = 0; j < n_b; ++j) {
+        if (sameSideBeyond(dist_ab[j], dist_ab[(j + 1) % n_b], far_a)) continue;
+        _generateEdgeEdgeIntersections(scratch, edges_a[i], edges_b[j]);
+      }
+    }
+
+    // vertex-face, in both directions.
+    for (size_t j = 0; j < n_b; ++j) {
+      meshset_t::vertex_t *v = edges_b[j]->vert;
+      if (fabs(dist_ab[j]) < carve::EPSILON && !scratch.intersects(v, fa) && faceContainsPoint(fa, v->v, scratch.projected)) {
+        scratch.record(v, fa, v);
+      }
+    }
+    for (size_t i = 0; i < n_a; ++i) {
+      meshset_t::vertex_t *v = edges_a[i]->vert;
+      if (fabs(dist_ba[i]) < carve::EPSILON && !scratch.intersects(v, fb) && faceContainsPoint(fb, v->v, scratch.projected)) {
+        scratch.record(v, fb, v);
+      }
+    }
+
+    // edge-face, in both directions. an edge with both ends on the
+    // same side of the plane, and more than EPSILON from it, cannot
+    // cross it.
+    for (size_t j = 0; j < n_b; ++j) {
+      if (sameSideBeyond(dist_ab[j], dist_ab[(j + 1) % n_b], carve::EPSILON)) continue;
+      _generateEdgeFaceIntersections(scratch, fa, edges_b[j]);
+    }
+    for (size_t i = 0; i < n_a; ++i) {
+      if (sameSideBeyond(dist_ba[i], dist_ba[(i + 1) % n_a], carve::EPSILON)) continue;
+      _generateEdgeFaceIntersections(scratch, fb, edges_a[i]);
+    }
+  }
+}
+
+
+
 void carve::csg::CSG::generateIntersectionCandidates(meshset_t *a,
-                                                     const face_rtree_t *a_node,
+                                                     const face_rtree_t *a_rtree,
+                                                     face_rtree_t::index_t a_node,
                                                      meshset_t *b,
-                                                     const face_rtree_t *b_node,
+                                                     const face_rtree_t *b_rtree,
+                                                     face_rtree_t::index_t b_node,
                                                      face_pairs_t &face_pairs,
                                                      bool descend_a) {
-  if (!a_node->bbox.intersects(b_node->bbox)) {
+  const carve::geom::aabb<3> a_bbox = a_rtree->bbox(a_node);
+  const carve::geom::aabb<3> b_bbox = b_rtree->bbox(b_node);
+
+  if (!a_bbox.intersects(b_bbox)) {
     return;
   }
 
-  if (a_node->child && (descend_a || !b_node->child)) {
-    for (face_rtree_t *node = a_node->child; node; node = node->sibling) {
-      generateIntersectionCandidates(a, node, b, b_node, face_pairs, false);
+  if (!a_rtree->isLeaf(a_node) && (descend_a || b_rtree->isLeaf(b_node))) {
+    face_rtree_t::intersecting_children children(*a_rtree, a_node, b_bbox);
+    for (face_rtree_t::index_t node; children.next(node); ) {
+      generateIntersectionCandidates(a, a_rtree, node, b, b_rtree, b_node, face_pairs, false);
     }
-  } else if (b_node->child) {
-    for (face_rtree_t *node = b_node->child; node; node = node->sibling) {
-      generateIntersectionCandidates(a, a_node, b, node, face_pairs, true);
+  } else if (!b_rtree->isLeaf(b_node)) {
+    face_rtree_t::intersecting_children children(*b_rtree, b_node, a_bbox, true);
+    for (face_rtree_t::index_t node; children.next(node); ) {
+      generateIntersectionCandidates(a, a_rtree, a_node, b, b_rtree, node, face_pairs, true);
     }
   } else {
-    for (size_t i = 0; i < a_node->data.size(); ++i) {
-      meshset_t::face_t *fa = a_node->data[i];
-      carve::geom::aabb<3> aabb_a = fa->getAABB();
-      if (aabb_a.maxAxisSeparation(b_node->bbox) > carve::EPSILON) continue;
-
-      for (size_t j = 0; j < b_node->data.size(); ++j) {
-        meshset_t::face_t *fb = b_node->data[j];
-        carve::geom::aabb<3> aabb_b = fb->getAABB();
-        if (aabb_b.maxAxisSeparation(aabb_a) > carve::EPSILON) continue;
-
-        std::pair<double, double> a_ra = fa->rangeInDirection(fa->plane.N, fa->edge->vert->v);
-        std::pair<double, double> b_ra = fb->rangeInDirection(fa->plane.N, fa->edge->vert->v);
+    // built by findIntersectionCandidates().
+    const carve::mesh::FaceGeometry<3> &geom_a = *a->cachedFaceGeometry();
+    const carve::mesh::FaceGeometry<3> &geom_b = *b->cachedFaceGeometry();
+
+    for (face_rtree_t::data_iter_t i = a_rtree->begin(a_node); i != a_rtree->end(a_node); ++i) {
+      meshset_t::face_t *fa = *i;
+      const size_t ia = fa->id;
+      if (geom_a.maxAxisSeparation(ia, b_bbox) > carve::EPSILON) continue;
+
+      for (face_rtree_t::data_iter_t j = b_rtree->begin(b_node); j != b_rtree->end(b_node); ++j) {
+        meshset_t::face_t *fb = *j;
+        const size_t ib = fb->id;
+        if (geom_b.maxAxisSeparation(ib, geom_a, ia) > carve::EPSILON) continue;
+
+        std::pair<double, double> a_ra = geom_a.normalRange(ia);
+        std::pair<double, double> b_ra = geom_b.rangeInDirection(fb, fa->plane.N, fa->edge->vert->v);
         if (carve::rangeSeparation(a_ra, b_ra) > carve::EPSILON) continue;
 
-        std::pair<double, double> a_rb = fa->rangeInDirection(fb->plane.N, fb->edge->vert->v);
-        std::pair<double, double> b_rb = fb->rangeInDirection(fb->plane.N, fb->edge->vert->v);
+        std::pair<double, double> a_rb = geom_a.rangeInDirection(fa, fb->plane.N, fb->edge->vert->v);
+        std::pair<double, double> b_rb = geom_b.normalRange(ib);
         if (carve::rangeSeparation(a_rb, b_rb) > carve::EPSILON) continue;
 
         if (!facesAreCoplanar(fa, fb)) {
-          face_pairs[fa].push_back(fb); 
-          face_pairs[fb].push_back(fa);
+          face_pairs.push_back(std::make_pair(fa, fb));
         }
      }
     }
@@ -931,42 +1248,300 @@ void carve::csg::CSG::generateIntersectionCandidates(meshset_t *a,
 
 
 
+namespace {
+  typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
+  typedef std::pair<carve::mesh::Face<3> *, carve::mesh::Face<3> *> face_pair_t;
+
+  struct candidate_task_t {
+    face_rtree_t::index_t a_node;
+    face_rtree_t::index_t b_node;
+    bool descend_a;
+    candidate_task_t(face_rtree_t::index_t _a_node, face_rtree_t::index_t _b_node, bool _descend_a) :
+        a_node(_a_node), b_node(_b_node), descend_a(_descend_a) {
+    }
+  };
 
-void carve::csg::CSG::generateIntersections(meshset_t *a,
-                                            const face_rtree_t *a_rtree,
-                                            meshset_t *b,
-                                            const face_rtree_t *b_rtree,
-                                            detail::Data &data) {
-  face_pairs_t face_pairs;
-  generateIntersectionCandidates(a, a_rtree, b, b_rtree, face_pairs);
+  // Split the top of a dual tree traversal into independent subtree
+  // pairs, in the order in which a serial traversal visits them.
+  void splitCandidateTraversal(const face_rtree_t *a_rtree,
+                               face_rtree_t::index_t a_node,
+                               const face_rtree_t *b_rtree,
+                               face_rtree_t::index_t b_node,
+                               bool descend_a,
+                               unsigned depth,
+                               std::vector<candidate_task_t> &tasks) {
+    const carve::geom::aabb<3> a_bbox = a_rtree->bbox(a_node);
+    const carve::geom::aabb<3> b_bbox = b_rtree->bbox(b_node);
+
+    if (!a_bbox.intersects(b_bbox)) {
+      return;
+    }
 
-  for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
-    meshset_t::face_t *f = (*i).first;
-    meshset_t::edge_t *e = f->edge;
-    do {
-      data.vert_to_edges[e->v1()].push_back(e);
-      e = e->next;
-    } while (e != f->edge);
+    const bool a_leaf = a_rtree->isLeaf(a_node);
+    const bool b_leaf = b_rtree->isLeaf(b_node);
+
+    if (!depth || (a_leaf && b_leaf)) {
+      tasks.push_back(candidate_task_t(a_node, b_node, descend_a));
+    } else if (!a_leaf && (descend_a || b_leaf)) {
+      face_rtree_t::intersecting_children children(*a_rtree, a_node, b_bbox);
+      for (face_rtree_t::index_t node; children.next(node); ) {
+        splitCandidateTraversal(a_rtree, node, b_rtree, b_node, false, depth - 1, tasks);
+      }
+    } else {
+      face_rtree_t::intersecting_children children(*b_rtree, b_node, a_bbox, true);
+      for (face_rtree_t::index_t node; children.next(node); ) {
+        splitCandidateTraversal(a_rtree, a_node, b_rtree, node, true, depth - 1, tasks);
+      }
+    }
+  }
+
+  struct face_pair_order_t {
+    carve::mesh::Face<3> *key;
+    carve::mesh::Face<3> *other;
+    size_t first_seen;
+    size_t seen;
+
+    bool operator<(const face_pair_order_t &o) const {
+      std::less<carve::mesh::Face<3> *> lt;
+      if (key != o.key) return lt(key, o.key);
+      if (other != o.other) return lt(other, o.other);
+      return seen < o.seen;
+    }
+  };
+
+  struct face_pair_seen_order {
+    bool operator()(const face_pair_order_t &a, const face_pair_order_t &b) const {
+      if (a.first_seen != b.first_seen) return a.first_seen < b.first_seen;
+      return a.seen < b.seen;
+    }
+  };
+}
+
+
+
+/** 
+ * \brief Group face pairs into runs sharing the same first face.
+ *
+ * Duplicate pairs are dropped. Runs are ordered by the first
+ * appearance of their face in \a pairs, and pairs within a run by
+ * their own appearance, so the result depends only on the order of
+ * \a pairs and not on face addresses.
+ * 
+ * @param[in] pairs Face pairs.
+ * @param[in] swap If true, group by the second face of each pair, and swap the pairs.
+ * @param[out] out The grouped pairs.
+ */
+static void groupFacePairs(const std::vector<face_pair_t> &pairs,
+                           bool swap,
+                           std::vector<face_pair_t> &out) {
+  std::vector<face_pair_order_t> order(pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    order[i].key = swap ? pairs[i].second : pairs[i].first;
+    order[i].other = swap ? pairs[i].first : pairs[i].second;
+    order[i].seen = i;
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<face_pair_order_t> unique;
+  unique.reserve(order.size());
+  for (size_t i = 0; i < order.size(); ) {
+    size_t group = unique.size();
+    size_t first_seen = order[i].seen;
+    size_t j = i;
+    for (; j < order.size() && order[j].key == order[i].key; ++j) {
+      // duplicates are adjacent, earliest first.
+      if (j > i && order[j].other == order[j - 1].other) continue;
+      first_seen = std::min(first_seen, order[j].seen);
+      unique.push_back(order[j]);
+    }
+    for (size_t k = group; k < unique.size(); ++k) {
+      unique[k].first_seen = first_seen;
+    }
+    i = j;
   }
+  order.swap(unique);
+  std::sort(order.begin(), order.end(), face_pair_seen_order());
+
+  out.clear();
+  out.reserve(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    out.push_back(std::make_pair(order[i].key, order[i].other));
+  }
+}
+
+
+
+/** 
+ * \brief Split grouped face pairs into runs sharing the same first face.
+ */
+static void makeFacePairRuns(const std::vector<face_pair_t> &pairs,
+                             std::vector<std::pair<const face_pair_t *, const face_pair_t *> > &runs) {
+  if (pairs.empty()) return;
+  const face_pair_t *p = &pairs.front();
+  const face_pair_t *pe = p + pairs.size();
+  while (p != pe) {
+    const face_pair_t *q = p + 1;
+    while (q != pe && q->first == p->first) ++q;
+    runs.push_back(std::make_pair(p, q));
+    p = q;
+  }
+}
 
-  for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
-    generateVertexVertexIntersections((*i).first, (*i).second);
+
+
+void carve::csg::CSG::findIntersectionCandidates(meshset_t *a,
+                                                 const face_rtree_t *a_rtree,
+                                                 meshset_t *b,
+                                                 const face_rtree_t *b_rtree,
+                                                 face_pairs_t &face_pairs) {
+  static carve::TimingName FUNC_NAME("CSG::findIntersectionCandidates()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  face_pairs.clear();
+
+  // build the face geometry read by generateIntersectionCandidates()
+  // before the traversal, which may be run by several threads.
+  a->faceGeometry();
+  b->faceGeometry();
+
+#if defined(_OPENMP)
+  if (omp_get_max_threads() > 1) {
+    // split the top levels of the traversal into many subtree pairs,
+    // and hand them out dynamically so that busy threads are not left
+    // with a backlog. each subtree pair has its own output buffer, and
+    // the buffers are concatenated in traversal order.
+    const unsigned split_depth = 6;
+    std::vector<candidate_task_t> tasks;
+    splitCandidateTraversal(a_rtree, a_rtree->root(), b_rtree, b_rtree->root(), true, split_depth, tasks);
+
+    std::vector<face_pairs_t> task_pairs(tasks.size());
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < (int)tasks.size(); ++i) {
+      generateIntersectionCandidates(a, a_rtree, tasks[i].a_node, b, b_rtree, tasks[i].b_node, task_pairs[i], tasks[i].descend_a);
+    }
+
+    size_t n_pairs = 0;
+    for (size_t i = 0; i < task_pairs.size(); ++i) n_pairs += task_pairs[i].size();
+    face_pairs.reserve(n_pairs);
+    for (size_t i = 0; i < task_pairs.size(); ++i) {
+      face_pairs.insert(face_pairs.end(), task_pairs[i].begin(), task_pairs[i].end());
+      face_pairs_t().swap(task_pairs[i]);
+    }
+  } else
+#endif
+  {
+    generateIntersectionCandidates(a, a_rtree, a_rtree->root(), b, b_rtree, b_rtree->root(), face_pairs);
   }
+}
+
+
+
+void carve::csg::CSG::runIntersectionPass(face_pair_pass_t pass,
+                                          const std::vector<face_pair_run_t> &runs) {
+#if defined(_OPENMP)
+  const int n_threads = omp_get_max_threads();
+  // below this, the cost of merging outweighs any gain.
+  const size_t min_runs_per_chunk = 64;
+
+  if (n_threads > 1 && runs.size() >= 2 * min_runs_per_chunk) {
+    // use a few chunks per thread to even out the load. the number of
+    // chunks depends on the number of threads, but each chunk is a
+    // contiguous range of runs and chunks are merged in order, so the
+    // merged result is that of a serial pass whatever the thread
+    // count or scheduling.
+    const size_t n_chunks = std::min((size_t)n_threads * 4, runs.size() / min_runs_per_chunk);
+    std::vector<Intersections> chunk_found(n_chunks);
+    std::vector<VertexPool> chunk_pool(n_chunks);
+    std::vector<std::string> chunk_error(n_chunks);
+    std::vector<char> chunk_failed(n_chunks, 0);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < (int)n_chunks; ++c) {
+      const size_t lo = runs.size() * c / n_chunks;
+      const size_t hi = runs.size() * (c + 1) / n_chunks;
+      IntersectionScratch scratch(intersections, chunk_found[c], chunk_pool[c]);
+      try {
+        for (size_t i = lo; i < hi; ++i) {
+          (this->*pass)(scratch, runs[i]);
+        }
+      } catch (carve::exception &e) {
+        chunk_failed[c] = 1;
+        chunk_error[c] = e.str();
+      } catch (...) {
+        chunk_failed[c] = 1;
+        chunk_error[c] = "unexpected exception in intersection pass";
+      }
+    }
+
+    for (size_t c = 0; c < n_chunks; ++c) {
+      if (chunk_failed[c]) throw carve::exception(chunk_error[c]);
+    }
 
-  for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
-    generateVertexEdgeIntersections((*i).first, (*i).second);
+    for (size_t c = 0; c < n_chunks; ++c) {
+      mergeIntersections(intersections, chunk_found[c]);
+      vertex_pool.splice(chunk_pool[c]);
+    }
+    return;
   }
+#endif
 
-  for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
-    generateEdgeEdgeIntersections((*i).first, (*i).second);
+  IntersectionScratch scratch(intersections, intersections, vertex_pool);
+  for (size_t i = 0; i < runs.size(); ++i) {
+    (this->*pass)(scratch, runs[i]);
   }
+}
+
 
-  for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
-    generateVertexFaceIntersections((*i).first, (*i).second);
+
+void carve::csg::CSG::generateIntersections(meshset_t *a,
+                                            const face_rtree_t *a_rtree,
+                                            meshset_t *b,
+                                            const face_rtree_t *b_rtree,
+                                            detail::Data &data) {
+  face_pairs_t face_pairs;
+  findIntersectionCandidates(a, a_rtree, b, b_rtree, face_pairs);
+
+  // the pairs grouped by face of a, and by face of b (reversed), so
+  // that the pairs for each face form a contiguous run.
+  face_pairs_t ab_pairs, ba_pairs;
+  groupFacePairs(face_pairs, false, ab_pairs);
+  groupFacePairs(face_pairs, true, ba_pairs);
+  face_pairs_t().swap(face_pairs);
+
+  std::vector<face_pair_run_t> ab_runs, ba_runs;
+  makeFacePairRuns(ab_pairs, ab_runs);
+  makeFacePairRuns(ba_pairs, ba_runs);
+
+  for (size_t l = 0; l < 2; ++l) {
+    const std::vector<face_pair_run_t> &runs = l ? ba_runs : ab_runs;
+    for (size_t i = 0; i < runs.size(); ++i) {
+      meshset_t::face_t *f = runs[i].first->first;
+      data.candidate_meshes.insert(f->mesh);
+      meshset_t::edge_t *e = f->edge;
+      do {
+        data.vert_to_edges[e->v1()].push_back(e);
+        e = e->next;
+      } while (e != f->edge);
+    }
   }
 
-  for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
-    generateEdgeFaceIntersections((*i).first, (*i).second);
+  if (intersection_kernel == INTERSECTION_FUSED) {
+    // each pair is handled once, from the side of a.
+    runIntersectionPass(&CSG::generateFaceIntersections, ab_runs);
+  } else {
+    std::vector<face_pair_run_t> runs;
+    runs.reserve(ab_runs.size() + ba_runs.size());
+    runs.insert(runs.end(), ab_runs.begin(), ab_runs.end());
+    runs.insert(runs.end(), ba_runs.begin(), ba_runs.end());
+
+    // each pass depends on the results of the previous ones, so the
+    // passes themselves run in sequence.
+    runIntersectionPass(&CSG::generateVertexVertexIntersections, runs);
+    runIntersectionPass(&CSG::generateVertexEdgeIntersections, runs);
+    runIntersectionPass(&CSG::generateEdgeEdgeIntersections, runs);
+    runIntersectionPass(&CSG::generateVertexFaceIntersections, runs);
+    runIntersectionPass(&CSG::generateEdgeFaceIntersections, runs);
   }
 
 
@@ -1010,7 +1585,10 @@ void carve::csg::CSG::generateIntersections(meshset_t *a,
 
 
 
-carve::csg::CSG::CSG() {
+carve::csg::CSG::CSG() :
+    intersection_kernel(INTERSECTION_FUSED),
+    point_classifier(POINT_CLASSIFIER_RAY),
+    pass_through_untouched_faces(false) {
 }
 
 
@@ -1074,7 +1652,11 @@ void carve::csg::CSG::makeFaceEdges(carve::csg::EdgeClassification &eclass,
          j != je;
          ++j) {
       meshset_t::face_t *face_b = (*j);
-      const detail::FVSMap::mapped_type &face_b_intersections = (data.fmap[face_b]);
+      // face_b is always present; find() rather than operator[] so
+      // that the table is never grown under the outer iteration.
+      detail::FVSMap::const_iterator face_b_i = data.fmap.find(face_b);
+      CARVE_ASSERT(face_b_i != data.fmap.end());
+      const detail::FVSMap::mapped_type &face_b_intersections = ((*face_b_i).second);
 
       std::vector<meshset_t::vertex_t *> vertices;
       vertices.reserve(std::min(face_a_intersections.size(), face_b_intersections.size()));
@@ -1259,7 +1841,10 @@ static void checkFaceLoopIntegrity(carve::csg::FaceLoopList &fll) {
  * @param b_face_loops 
  * @param a_edge_count 
  * @param b_edge_count 
- * @param hooks 
+ * @param a_disjoint 
+ * @param b_disjoint 
+ * @param a_untouched 
+ * @param b_untouched 
  */
 void carve::csg::CSG::calc(meshset_t *a,
                            const face_rtree_t *a_rtree,
@@ -1270,7 +1855,11 @@ void carve::csg::CSG::calc(meshset_t *a,
                            carve::csg::FaceLoopList &a_face_loops,
                            carve::csg::FaceLoopList &b_face_loops,
                            size_t &a_edge_count,
-                           size_t &b_edge_count) {
+                           size_t &b_edge_count,
+                           std::vector<meshset_t::mesh_t *> *a_disjoint,
+                           std::vector<meshset_t::mesh_t *> *b_disjoint,
+                           std::vector<meshset_t::face_t *> *a_untouched,
+                           std::vector<meshset_t::face_t *> *b_untouched) {
   detail::Data data;
 
 #if defined(CARVE_DEBUG)
@@ -1316,8 +1905,23 @@ void carve::csg::CSG::calc(meshset_t *a,
 #if defined(CARVE_DEBUG)
   std::cerr << "generateFaceLoops" << std::endl;
 #endif
-  a_edge_count = generateFaceLoops(a, data, a_face_loops);
-  b_edge_count = generateFaceLoops(b, data, b_face_loops);
+  a_edge_count = generateFaceLoops(a, data, a_face_loops, a_disjoint != NULL, a_untouched);
+  b_edge_count = generateFaceLoops(b, data, b_face_loops, b_disjoint != NULL, b_untouched);
+
+  if (a_disjoint != NULL) {
+    for (size_t i = 0; i < a->meshes.size(); ++i) {
+      if (data.candidate_meshes.find(a->meshes[i]) == data.candidate_meshes.end()) {
+        a_disjoint->push_back(a->meshes[i]);
+      }
+    }
+  }
+  if (b_disjoint != NULL) {
+    for (size_t i = 0; i < b->meshes.size(); ++i) {
+      if (data.candidate_meshes.find(b->meshes[i]) == data.candidate_meshes.end()) {
+        b_disjoint->push_back(b->meshes[i]);
+      }
+    }
+  }
 
 #if defined(CARVE_DEBUG)
   std::cerr << "generated " << a_edge_count << " edges for poly a" << std::endl;
@@ -1405,6 +2009,28 @@ void returnSharedEdges(carve::csg::V2Set &shared_edges,
 
 
 
+/** 
+ * \brief Construct a face R-tree for a MeshSet from its cached face
+ * bounding boxes, building the cache if necessary.
+ */
+static carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *constructFaceRTree(carve::mesh::MeshSet<3> *meshset) {
+  typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> rtree_t;
+
+  const carve::mesh::FaceGeometry<3> &geom = meshset->faceGeometry();
+
+  std::vector<rtree_t::data_aabb_t> data;
+  data.reserve(meshset->faceCount());
+  for (carve::mesh::MeshSet<3>::face_iter i = meshset->faceBegin(); i != meshset->faceEnd(); ++i) {
+    data.push_back(rtree_t::data_aabb_t());
+    data.back().data = *i;
+    data.back().bbox = geom.getAABB((*i)->id);
+  }
+
+  return rtree_t::construct_STR(data, 4, 4);
+}
+
+
+
 /** 
  * 
  * 
@@ -1422,9 +2048,36 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
                                                   carve::csg::CSG::Collector &collector,
                                                   carve::csg::V2Set *shared_edges_ptr,
                                                   CLASSIFY_TYPE classify_type) {
+  std::auto_ptr<face_rtree_t> a_rtree(constructFaceRTree(a));
+  std::auto_ptr<face_rtree_t> b_rtree(constructFaceRTree(b));
+
+  return _compute(a, a_rtree.get(), b, b_rtree.get(), collector, shared_edges_ptr, classify_type);
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::CSG::compute(const PreparedMeshSet &a,
+                                                  const PreparedMeshSet &b,
+                                                  carve::csg::CSG::Collector &collector,
+                                                  carve::csg::V2Set *shared_edges_ptr,
+                                                  CLASSIFY_TYPE classify_type) {
+  return _compute(a.getMeshSet(), a.getRTree(), b.getMeshSet(), b.getRTree(), collector, shared_edges_ptr, classify_type);
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::CSG::_compute(meshset_t *a,
+                                                   const face_rtree_t *a_rtree,
+                                                   meshset_t *b,
+                                                   const face_rtree_t *b_rtree,
+                                                   carve::csg::CSG::Collector &collector,
+                                                   carve::csg::V2Set *shared_edges_ptr,
+                                                   CLASSIFY_TYPE classify_type) {
   static carve::TimingName FUNC_NAME("CSG::compute");
   carve::TimingBlock block(FUNC_NAME);
 
+  TemporaryScope temporaries(*this);
+
   VertexClassification vclass;
   EdgeClassification eclass;
 
@@ -1437,13 +2090,24 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
   size_t a_edge_count;
   size_t b_edge_count;
 
-  std::auto_ptr<face_rtree_t> a_rtree(face_rtree_t::construct_STR(a->faceBegin(), a->faceEnd(), 4, 4));
-  std::auto_ptr<face_rtree_t> b_rtree(face_rtree_t::construct_STR(b->faceBegin(), b->faceEnd(), 4, 4));
+  // meshes that do not touch the other operand bypass face loop
+  // generation, grouping and group classification.
+  std::vector<meshset_t::mesh_t *> a_disjoint;
+  std::vector<meshset_t::mesh_t *> b_disjoint;
+
+  // faces that no intersection touched, if they are to be passed
+  // through without face loop generation.
+  bool pass_through = pass_through_untouched_faces && classify_type == CLASSIFY_NORMAL;
+  std::vector<meshset_t::face_t *> a_untouched;
+  std::vector<meshset_t::face_t *> b_untouched;
 
   {
     static carve::TimingName FUNC_NAME("CSG::compute - calc()");
     carve::TimingBlock block(FUNC_NAME);
-    calc(a, a_rtree.get(), b, b_rtree.get(), vclass, eclass,a_face_loops, b_face_loops, a_edge_count, b_edge_count);
+    calc(a, a_rtree, b, b_rtree, vclass, eclass,a_face_loops, b_face_loops, a_edge_count, b_edge_count,
+         &a_disjoint, &b_disjoint,
+         pass_through ? &a_untouched : NULL,
+         pass_through ? &b_untouched : NULL);
   }
 
   detail::LoopEdges a_edge_map;
@@ -1477,6 +2141,10 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
     carve::TimingBlock block(FUNC_NAME);
     groupFaceLoops(a, a_face_loops, a_edge_map, shared_edges, a_loops_grouped);
     groupFaceLoops(b, b_face_loops, b_edge_map, shared_edges, b_loops_grouped);
+    if (pass_through) {
+      attachUntouchedFaces(a, a_untouched, a_edge_map, a_loops_grouped);
+      attachUntouchedFaces(b, b_untouched, b_edge_map, b_loops_grouped);
+    }
 #if defined(CARVE_DEBUG)
     std::cerr << "*** a_loops_grouped.size(): " << a_loops_grouped.size() << std::endl;
     std::cerr << "*** b_loops_grouped.size(): " << b_loops_grouped.size() << std::endl;
@@ -1511,11 +2179,11 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
     classifyFaceGroupsEdge(shared_edges,
                            vclass,
                            a,
-                           a_rtree.get(),
+                           a_rtree,
                            a_loops_grouped,
                            a_edge_map,
                            b,
-                           b_rtree.get(),
+                           b_rtree,
                            b_loops_grouped,
                            b_edge_map,
                            collector);
@@ -1524,17 +2192,24 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
     classifyFaceGroups(shared_edges,
                        vclass,
                        a,
-                       a_rtree.get(),
+                       a_rtree,
                        a_loops_grouped,
                        a_edge_map,
                        b,
-                       b_rtree.get(),
+                       b_rtree,
                        b_loops_grouped,
                        b_edge_map,
                        collector);
     break;
   }
 
+  {
+    static carve::TimingName FUNC_NAME("CSG::compute - collectDisjointMeshes()");
+    carve::TimingBlock block(FUNC_NAME);
+    collectDisjointMeshes(a_disjoint, a, b, b_rtree, collector);
+    collectDisjointMeshes(b_disjoint, b, a, a_rtree, collector);
+  }
+
   meshset_t *result = collector.done(hooks);
   if (result != NULL && shared_edges_ptr != NULL) {
     std::list<meshset_t *> result_list;
@@ -1546,6 +2221,53 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
 
 
 
+void carve::csg::CSG::collectDisjointMeshes(const std::vector<meshset_t::mesh_t *> &meshes,
+                                            const meshset_t *poly,
+                                            const meshset_t *other_poly,
+                                            const face_rtree_t *other_rtree,
+                                            carve::csg::CSG::Collector &collector) {
+  if (!meshes.size()) return;
+
+  std::auto_ptr<carve::mesh::WindingNumber> winding_number;
+  if (point_classifier == POINT_CLASSIFIER_WINDING_NUMBER) {
+    winding_number.reset(new carve::mesh::WindingNumber(other_poly, other_rtree));
+  }
+
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    meshset_t::mesh_t *mesh = meshes[i];
+
+    // no face of mesh shares a bounding box with a face of
+    // other_poly, so mesh is entirely in or out. a vertex can still
+    // lie within EPSILON of the other surface, so try until one is
+    // classified unambiguously.
+    PointClass pc = POINT_ON;
+    for (size_t j = 0; pc == POINT_ON && j < mesh->faces.size(); ++j) {
+      const meshset_t::vertex_t *v = mesh->faces[j]->edge->vert;
+      if (winding_number.get()) {
+        pc = winding_number->classify(v->v);
+      } else {
+        pc = carve::mesh::classifyPoint(other_poly, other_rtree, v->v);
+      }
+    }
+    if (pc != POINT_IN && pc != POINT_OUT) {
+      throw carve::exception("disjoint mesh is not IN or OUT!");
+    }
+
+    FaceLoopGroup grp(poly);
+    std::vector<meshset_t::vertex_t *> vertices;
+    for (size_t j = 0; j < mesh->faces.size(); ++j) {
+      mesh->faces[j]->getVertices(vertices);
+      FaceLoop *fl = FaceLoop::create(mesh->faces[j], vertices);
+      fl->group = &grp;
+      grp.face_loops.append(fl);
+    }
+    grp.classification.push_back(ClassificationInfo(NULL, pc == POINT_IN ? FACE_IN : FACE_OUT));
+    collector.collect(&grp, hooks);
+  }
+}
+
+
+
 /** 
  * 
  * 
@@ -1575,6 +2297,45 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
 
 
 
+carve::mesh::MeshSet<3> *carve::csg::CSG::compute(const PreparedMeshSet &a,
+                                                  const PreparedMeshSet &b,
+                                                  carve::csg::CSG::OP op,
+                                                  carve::csg::V2Set *shared_edges,
+                                                  CLASSIFY_TYPE classify_type) {
+  Collector *coll = makeCollector(op, a.getMeshSet(), b.getMeshSet());
+  if (!coll) return NULL;
+
+  meshset_t *result = compute(a, b, *coll, shared_edges, classify_type);
+     
+  delete coll;
+
+  return result;
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
+                                                  const PreparedMeshSet &b,
+                                                  carve::csg::CSG::OP op,
+                                                  carve::csg::V2Set *shared_edges,
+                                                  CLASSIFY_TYPE classify_type) {
+  PreparedMeshSet prepared_a(a);
+  return compute(prepared_a, b, op, shared_edges, classify_type);
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::CSG::compute(const PreparedMeshSet &a,
+                                                  meshset_t *b,
+                                                  carve::csg::CSG::OP op,
+                                                  carve::csg::V2Set *shared_edges,
+                                                  CLASSIFY_TYPE classify_type) {
+  PreparedMeshSet prepared_b(b);
+  return compute(a, prepared_b, op, shared_edges, classify_type);
+}
+
+
+
 /** 
  * 
  * 
@@ -1592,6 +2353,36 @@ bool carve::csg::CSG::sliceAndClassify(meshset_t *closed,
                                        std::list<std::pair<FaceClass, meshset_t *> > &result,
                                        carve::csg::V2Set *shared_edges_ptr) {
   if (!closed->isClosed()) return false;
+
+  std::auto_ptr<face_rtree_t> closed_rtree(constructFaceRTree(closed));
+  std::auto_ptr<face_rtree_t> open_rtree(constructFaceRTree(open));
+
+  _sliceAndClassify(closed, closed_rtree.get(), open, open_rtree.get(), result, shared_edges_ptr);
+  return true;
+}
+
+
+
+bool carve::csg::CSG::sliceAndClassify(const PreparedMeshSet &closed,
+                                       const PreparedMeshSet &open,
+                                       std::list<std::pair<FaceClass, meshset_t *> > &result,
+                                       carve::csg::V2Set *shared_edges_ptr) {
+  if (!closed.isClosed()) return false;
+
+  _sliceAndClassify(closed.getMeshSet(), closed.getRTree(), open.getMeshSet(), open.getRTree(), result, shared_edges_ptr);
+  return true;
+}
+
+
+
+void carve::csg::CSG::_sliceAndClassify(meshset_t *closed,
+                                        const face_rtree_t *closed_rtree,
+                                        meshset_t *open,
+                                        const face_rtree_t *open_rtree,
+                                        std::list<std::pair<FaceClass, meshset_t *> > &result,
+                                        carve::csg::V2Set *shared_edges_ptr) {
+  TemporaryScope temporaries(*this);
+
   carve::csg::VertexClassification vclass;
   carve::csg::EdgeClassification eclass;
 
@@ -1604,10 +2395,7 @@ bool carve::csg::CSG::sliceAndClassify(meshset_t *closed,
   size_t a_edge_count;
   size_t b_edge_count;
 
-  std::auto_ptr<face_rtree_t> closed_rtree(face_rtree_t::construct_STR(closed->faceBegin(), closed->faceEnd(), 4, 4));
-  std::auto_ptr<face_rtree_t> open_rtree(face_rtree_t::construct_STR(open->faceBegin(), open->faceEnd(), 4, 4));
-
-  calc(closed, closed_rtree.get(), open, open_rtree.get(), vclass, eclass,a_face_loops, b_face_loops, a_edge_count, b_edge_count);
+  calc(closed, closed_rtree, open, open_rtree, vclass, eclass,a_face_loops, b_face_loops, a_edge_count, b_edge_count);
 
   detail::LoopEdges a_edge_map;
   detail::LoopEdges b_edge_map;
@@ -1625,11 +2413,11 @@ bool carve::csg::CSG::sliceAndClassify(meshset_t *closed,
   halfClassifyFaceGroups(shared_edges,
                          vclass,
                          closed,
-                         closed_rtree.get(),
+                         closed_rtree,
                          a_loops_grouped,
                          a_edge_map,
                          open,
-                         open_rtree.get(),
+                         open_rtree,
                          b_loops_grouped,
                          b_edge_map,
                          result);
@@ -1641,7 +2429,6 @@ bool carve::csg::CSG::sliceAndClassify(meshset_t *closed,
     }
     returnSharedEdges(shared_edges, result_list, shared_edges_ptr);
   }
-  return true;
 }
 
 
@@ -1661,6 +2448,33 @@ void carve::csg::CSG::slice(meshset_t *a,
                             std::list<meshset_t *> &a_sliced,
                             std::list<meshset_t *> &b_sliced,
                             carve::csg::V2Set *shared_edges_ptr) {
+  std::auto_ptr<face_rtree_t> a_rtree(constructFaceRTree(a));
+  std::auto_ptr<face_rtree_t> b_rtree(constructFaceRTree(b));
+
+  _slice(a, a_rtree.get(), b, b_rtree.get(), a_sliced, b_sliced, shared_edges_ptr);
+}
+
+
+
+void carve::csg::CSG::slice(const PreparedMeshSet &a,
+                            const PreparedMeshSet &b,
+                            std::list<meshset_t *> &a_sliced,
+                            std::list<meshset_t *> &b_sliced,
+                            carve::csg::V2Set *shared_edges_ptr) {
+  _slice(a.getMeshSet(), a.getRTree(), b.getMeshSet(), b.getRTree(), a_sliced, b_sliced, shared_edges_ptr);
+}
+
+
+
+void carve::csg::CSG::_slice(meshset_t *a,
+                             const face_rtree_t *a_rtree,
+                             meshset_t *b,
+                             const face_rtree_t *b_rtree,
+                             std::list<meshset_t *> &a_sliced,
+                             std::list<meshset_t *> &b_sliced,
+                             carve::csg::V2Set *shared_edges_ptr) {
+  TemporaryScope temporaries(*this);
+
   carve::csg::VertexClassification vclass;
   carve::csg::EdgeClassification eclass;
 
@@ -1673,10 +2487,7 @@ void carve::csg::CSG::slice(meshset_t *a,
   size_t a_edge_count;
   size_t b_edge_count;
 
-  std::auto_ptr<face_rtree_t> a_rtree(face_rtree_t::construct_STR(a->faceBegin(), a->faceEnd(), 4, 4));
-  std::auto_ptr<face_rtree_t> b_rtree(face_rtree_t::construct_STR(b->faceBegin(), b->faceEnd(), 4, 4));
-
-  calc(a, a_rtree.get(), b, b_rtree.get(), vclass, eclass,a_face_loops, b_face_loops, a_edge_count, b_edge_count);
+  calc(a, a_rtree, b, b_rtree, vclass, eclass,a_face_loops, b_face_loops, a_edge_count, b_edge_count);
 
   detail::LoopEdges a_edge_map;
   detail::LoopEdges b_edge_map;
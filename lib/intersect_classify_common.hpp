@@ -19,6 +19,15 @@
 
 #include "intersect_common.hpp"
 
+#include <carve/winding_number.hpp>
+
+#include <string>
+#include <vector>
+
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
 template<typename T>
 static int is_same(const std::vector<T> &a,
                    const std::vector<T> &b) {
@@ -44,3 +53,67 @@ not_fwd:
 not_rev:
   return 0;
 }
+
+
+
+namespace carve {
+  namespace csg {
+
+    // Classifies v against poly, by winding number if an evaluator
+    // for poly is given, and by ray parity otherwise.
+    static inline PointClass classifyOperandPoint(const carve::mesh::MeshSet<3> *poly,
+                                                  const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_rtree,
+                                                  const carve::mesh::WindingNumber *poly_winding,
+                                                  const carve::geom::vector<3> &v,
+                                                  const carve::mesh::Face<3> **hit_face = NULL) {
+      if (poly_winding) {
+        return poly_winding->classify(v, hit_face);
+      }
+      return carve::mesh::classifyPoint(poly, poly_rtree, v, false, NULL, hit_face);
+    }
+
+
+    // Evaluates group_class[i] = classify(i, *groups[i]) for each
+    // group. Groups are classified concurrently when OpenMP is
+    // available, so classify must not modify any state that is shared
+    // between groups; the caller applies the results in order
+    // afterwards. If classification of any group throws, the error
+    // for the first such group is rethrown.
+    template<typename GROUP_CLASSIFIER>
+    static void classifyGroups(const std::vector<FLGroupList::iterator> &groups,
+                               const GROUP_CLASSIFIER &classify,
+                               std::vector<FaceClass> &group_class) {
+      group_class.resize(groups.size());
+
+#if defined(_OPENMP) && !defined(CARVE_DEBUG)
+      if (omp_get_max_threads() > 1 && groups.size() >= 16) {
+        std::vector<std::string> group_error(groups.size());
+        std::vector<char> group_failed(groups.size(), 0);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < (int)groups.size(); ++i) {
+          try {
+            group_class[i] = classify(i, *groups[i]);
+          } catch (carve::exception &e) {
+            group_failed[i] = 1;
+            group_error[i] = e.str();
+          } catch (...) {
+            group_failed[i] = 1;
+            group_error[i] = "unexpected exception in face group classification";
+          }
+        }
+
+        for (size_t i = 0; i < groups.size(); ++i) {
+          if (group_failed[i]) throw carve::exception(group_error[i]);
+        }
+        return;
+      }
+#endif
+
+      for (size_t i = 0; i < groups.size(); ++i) {
+        group_class[i] = classify(i, *groups[i]);
+      }
+    }
+
+  }
+}
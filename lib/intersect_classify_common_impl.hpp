@@ -115,60 +115,108 @@ namespace carve {
       }
     }
 
+    static void collectClassifiedGroups(FLGroupList &group,
+                                        const std::vector<FLGroupList::iterator> &groups,
+                                        const std::vector<FaceClass> &group_class,
+                                        CSG::Collector &collector,
+                                        CSG::Hooks &hooks) {
+      // hand classified groups to the collector in their original order.
+      for (size_t i = 0; i < groups.size(); ++i) {
+        if (group_class[i] == FACE_UNCLASSIFIED) continue;
+        FaceLoopGroup &grp = (*groups[i]);
+        grp.classification.push_back(ClassificationInfo(NULL, group_class[i]));
+        collector.collect(&grp, hooks);
+        group.erase(groups[i]);
+      }
+    }
+
+    static void listGroups(FLGroupList &group,
+                           std::vector<FLGroupList::iterator> &groups) {
+      groups.clear();
+      groups.reserve(group.size());
+      for (FLGroupList::iterator i = group.begin(); i != group.end(); ++i) {
+        groups.push_back(i);
+      }
+    }
+
     template <typename CLASSIFIER>
-    static void performClassifyEasyFaceGroups(FLGroupList &group,
-                                              carve::mesh::MeshSet<3> *poly_a,
-                                              const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
-                                              VertexClassification &vclass,
-                                              const CLASSIFIER &classifier,
-                                              CSG::Collector &collector,
-                                              CSG::Hooks &hooks) {
-  
-      for (FLGroupList::iterator i = group.begin(); i != group.end();) {
+    class ClassifyEasyFaceGroup {
+      ClassifyEasyFaceGroup &operator=(const ClassifyEasyFaceGroup &);
+
+    public:
+      const carve::mesh::MeshSet<3> *poly_a;
+      const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree;
+      const carve::mesh::WindingNumber *poly_a_winding;
+      const VertexClassification &vclass;
+      const CLASSIFIER &classifier;
+
+      ClassifyEasyFaceGroup(const carve::mesh::MeshSet<3> *_poly_a,
+                            const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *_poly_a_rtree,
+                            const carve::mesh::WindingNumber *_poly_a_winding,
+                            const VertexClassification &_vclass,
+                            const CLASSIFIER &_classifier) :
+          poly_a(_poly_a), poly_a_rtree(_poly_a_rtree), poly_a_winding(_poly_a_winding), vclass(_vclass), classifier(_classifier) {
+      }
+
+      FaceClass operator()(size_t /* index */, FaceLoopGroup &grp) const {
 #if defined(CARVE_DEBUG)
-        std::cerr << "............group " << &(*i) << std::endl;
+        std::cerr << "............group " << &grp << std::endl;
 #endif
-        FaceLoopGroup &grp = (*i);
         FaceLoopList &curr = (grp.face_loops);
-        FaceClass fc;
 
         for (FaceLoop *f = curr.head; f; f = f->next) {
           for (size_t j = 0; j < f->vertices.size(); ++j) {
             if (!classifier.pointOn(vclass, f, j)) {
-              PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, f->vertices[j]->v);
+              PointClass pc = classifyOperandPoint(poly_a, poly_a_rtree, poly_a_winding, f->vertices[j]->v);
               if (pc == POINT_IN || pc == POINT_OUT) {
                 classifier.explain(f, j, pc);
               }
-              if (pc == POINT_IN) { fc = FACE_IN; goto accept; }
-              if (pc == POINT_OUT) { fc = FACE_OUT; goto accept; }
+              if (pc == POINT_IN) return FACE_IN;
+              if (pc == POINT_OUT) return FACE_OUT;
             }
           }
         }
-        ++i;
-        continue;
-      accept: {
-          grp.classification.push_back(ClassificationInfo(NULL, fc));
-          collector.collect(&grp, hooks);
-          i = group.erase(i);
-        }
+        return FACE_UNCLASSIFIED;
       }
-    }
-
+    };
 
-    template <typename CLASSIFIER> 
-    static void performClassifyHardFaceGroups(FLGroupList &group,
+    template <typename CLASSIFIER>
+    static void performClassifyEasyFaceGroups(FLGroupList &group,
                                               carve::mesh::MeshSet<3> *poly_a,
-                                              const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
-                                              const CLASSIFIER & /* classifier */,
+                                              const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                                              const carve::mesh::WindingNumber *poly_a_winding,
+                                              VertexClassification &vclass,
+                                              const CLASSIFIER &classifier,
                                               CSG::Collector &collector,
                                               CSG::Hooks &hooks) {
-      for (FLGroupList::iterator
-             i = group.begin(); i != group.end();) {
+      std::vector<FLGroupList::iterator> groups;
+      std::vector<FaceClass> group_class;
+
+      listGroups(group, groups);
+      classifyGroups(groups, ClassifyEasyFaceGroup<CLASSIFIER>(poly_a, poly_a_rtree, poly_a_winding, vclass, classifier), group_class);
+      collectClassifiedGroups(group, groups, group_class, collector, hooks);
+    }
+
+
+    class ClassifyHardFaceGroup {
+      ClassifyHardFaceGroup &operator=(const ClassifyHardFaceGroup &);
+
+    public:
+      const carve::mesh::MeshSet<3> *poly_a;
+      const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree;
+      const carve::mesh::WindingNumber *poly_a_winding;
+
+      ClassifyHardFaceGroup(const carve::mesh::MeshSet<3> *_poly_a,
+                            const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *_poly_a_rtree,
+                            const carve::mesh::WindingNumber *_poly_a_winding) :
+          poly_a(_poly_a), poly_a_rtree(_poly_a_rtree), poly_a_winding(_poly_a_winding) {
+      }
+
+      FaceClass operator()(size_t /* index */, FaceLoopGroup &grp) const {
         int n_in = 0, n_out = 0, n_on = 0;
-        FaceLoopGroup &grp = (*i);
         FaceLoopList &curr = (grp.face_loops);
-        V2Set &perim = ((*i).perimeter);
-        FaceClass fc =FACE_UNCLASSIFIED;
+        const V2Set &perim = (grp.perimeter);
+        FaceClass fc = FACE_UNCLASSIFIED;
 
         for (FaceLoop *f = curr.head; f; f = f->next) {
           carve::mesh::MeshSet<3>::vertex_t *v1, *v2;
@@ -178,7 +226,7 @@ namespace carve {
             if (v1 < v2 && perim.find(std::make_pair(v1, v2)) == perim.end()) {
               carve::geom3d::Vector c = (v1->v + v2->v) / 2.0;
 
-              PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, c);
+              PointClass pc = classifyOperandPoint(poly_a, poly_a_rtree, poly_a_winding, c);
 
               switch (pc) {
               case POINT_IN: n_in++; break;
@@ -195,38 +243,55 @@ namespace carve {
         std::cerr << ">>> n_in: " << n_in << " n_on: " << n_on << " n_out: " << n_out << std::endl;
 #endif
 
-        if (!n_in && !n_out) {
-          ++i;
-          continue;
-        }
-
         if (n_in) fc = FACE_IN;
         if (n_out) fc = FACE_OUT;
-
-        grp.classification.push_back(ClassificationInfo(NULL, fc));
-        collector.collect(&grp, hooks);
-        i = group.erase(i);
+        return fc;
       }
+    };
+
+    template <typename CLASSIFIER> 
+    static void performClassifyHardFaceGroups(FLGroupList &group,
+                                              carve::mesh::MeshSet<3> *poly_a,
+                                              const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                                              const carve::mesh::WindingNumber *poly_a_winding,
+                                              const CLASSIFIER & /* classifier */,
+                                              CSG::Collector &collector,
+                                              CSG::Hooks &hooks) {
+      std::vector<FLGroupList::iterator> groups;
+      std::vector<FaceClass> group_class;
+
+      listGroups(group, groups);
+      classifyGroups(groups, ClassifyHardFaceGroup(poly_a, poly_a_rtree, poly_a_winding), group_class);
+      collectClassifiedGroups(group, groups, group_class, collector, hooks);
     }
 
     template <typename CLASSIFIER>
-    void performFaceLoopWork(carve::mesh::MeshSet<3> *poly_a,
-                             const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
-                             FLGroupList &b_loops_grouped,
-                             const CLASSIFIER &classifier,
-                             CSG::Collector &collector,
-                             CSG::Hooks &hooks) {
-      for (FLGroupList::iterator i = b_loops_grouped.begin(), e = b_loops_grouped.end(); i != e;) {
+    class ClassifyFaceLoop {
+      ClassifyFaceLoop &operator=(const ClassifyFaceLoop &);
+
+    public:
+      const carve::mesh::MeshSet<3> *poly_a;
+      const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree;
+      const carve::mesh::WindingNumber *poly_a_winding;
+      const CLASSIFIER &classifier;
+
+      ClassifyFaceLoop(const carve::mesh::MeshSet<3> *_poly_a,
+                       const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *_poly_a_rtree,
+                       const carve::mesh::WindingNumber *_poly_a_winding,
+                       const CLASSIFIER &_classifier) :
+          poly_a(_poly_a), poly_a_rtree(_poly_a_rtree), poly_a_winding(_poly_a_winding), classifier(_classifier) {
+      }
+
+      FaceClass operator()(size_t /* index */, FaceLoopGroup &grp) const {
         FaceClass fc;
 
-        if (classifier.faceLoopSanityChecker(*i)) {
+        if (classifier.faceLoopSanityChecker(grp)) {
           std::cerr << "UNEXPECTED face loop with size != 1." << std::endl;
-          ++i;
-          continue;
+          return FACE_UNCLASSIFIED;
         }
-        CARVE_ASSERT((*i).face_loops.size() == 1);
+        CARVE_ASSERT(grp.face_loops.size() == 1);
 
-        FaceLoop *fla = (*i).face_loops.head;
+        FaceLoop *fla = grp.face_loops.head;
 
         const carve::mesh::MeshSet<3>::face_t *f = (fla->orig_face);
         std::vector<carve::mesh::MeshSet<3>::vertex_t *> &loop = (fla->vertices);
@@ -242,7 +307,7 @@ namespace carve {
         carve::geom3d::Vector v = f->unproject(pv, f->plane);
 
         const carve::mesh::MeshSet<3>::face_t *hit_face;
-        PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, v, false, NULL, &hit_face);
+        PointClass pc = classifyOperandPoint(poly_a, poly_a_rtree, poly_a_winding, v, &hit_face);
         switch (pc) {
         case POINT_IN: fc = FACE_IN; break;
         case POINT_OUT: fc = FACE_OUT; break;
@@ -260,12 +325,24 @@ namespace carve {
 #if defined(CARVE_DEBUG)
         std::cerr << "CLASS: " << (fc == FACE_IN ? "FACE_IN" : "FACE_OUT" ) << std::endl;
 #endif
-
-        (*i).classification.push_back(ClassificationInfo(NULL, fc));
-        collector.collect(&*i, hooks);
-        i = b_loops_grouped.erase(i);
+        return fc;
       }
+    };
+
+    template <typename CLASSIFIER>
+    void performFaceLoopWork(carve::mesh::MeshSet<3> *poly_a,
+                             const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                             const carve::mesh::WindingNumber *poly_a_winding,
+                             FLGroupList &b_loops_grouped,
+                             const CLASSIFIER &classifier,
+                             CSG::Collector &collector,
+                             CSG::Hooks &hooks) {
+      std::vector<FLGroupList::iterator> groups;
+      std::vector<FaceClass> group_class;
 
+      listGroups(b_loops_grouped, groups);
+      classifyGroups(groups, ClassifyFaceLoop<CLASSIFIER>(poly_a, poly_a_rtree, poly_a_winding, classifier), group_class);
+      collectClassifiedGroups(b_loops_grouped, groups, group_class, collector, hooks);
     }
 
     template <typename CLASSIFIER>
@@ -273,9 +350,9 @@ namespace carve {
                                    FLGroupList &b_loops_grouped,
                                    VertexClassification &vclass,
                                    carve::mesh::MeshSet<3> *poly_a,
-                                   const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                                   const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                                    carve::mesh::MeshSet<3> *poly_b,
-                                   const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree,
+                                   const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree,
                                    const CLASSIFIER &classifier,
                                    CSG::Collector &collector,
                                    CSG::Hooks &hooks) {
@@ -326,10 +326,10 @@ namespace carve {
 
 
       static bool processForwardEdgeSurfaces(GrpEdgeSurfMap &edge_surfaces,
-                                             const std::list<FaceLoop *> &fwd,
+                                             const detail::FLList &fwd,
                                              const carve::geom3d::Vector &edge_vector,
                                              const carve::geom3d::Vector &base_vector) {
-        for (std::list<FaceLoop *>::const_iterator i = fwd.begin(), e = fwd.end(); i != e; ++i) {
+        for (detail::FLList::const_iterator i = fwd.begin(), e = fwd.end(); i != e; ++i) {
           EdgeSurface &es = (edge_surfaces[(*i)->orig_face->mesh]);
           if (es.fwd != NULL) return false;
           es.fwd = (*i);
@@ -339,10 +339,10 @@ namespace carve {
       }
 
       static bool processReverseEdgeSurfaces(GrpEdgeSurfMap &edge_surfaces,
-                                             const std::list<FaceLoop *> &rev,
+                                             const detail::FLList &rev,
                                              const carve::geom3d::Vector &edge_vector,
                                              const carve::geom3d::Vector &base_vector) {
-        for (std::list<FaceLoop *>::const_iterator i = rev.begin(), e = rev.end(); i != e; ++i) {
+        for (detail::FLList::const_iterator i = rev.begin(), e = rev.end(); i != e; ++i) {
           EdgeSurface &es = (edge_surfaces[(*i)->orig_face->mesh]);
           if (es.rev != NULL) return false;
           es.rev = (*i);
@@ -494,6 +494,87 @@ namespace carve {
         }
       }
 
+
+
+      typedef std::vector<std::pair<const carve::mesh::MeshSet<3>::vertex_t *, PointClass> > VertexClassList;
+
+      // Classifies a group that has not been classified by its shared
+      // edges as IN or OUT, using the first of its vertices that is not
+      // ON the other operand. Only reads vclass; newly computed vertex
+      // classifications are returned in computed[index].
+      class ClassifyUnsharedGroup {
+        ClassifyUnsharedGroup &operator=(const ClassifyUnsharedGroup &);
+
+      public:
+        const VertexClassification &vclass;
+        int other;
+        const carve::mesh::MeshSet<3> *poly;
+        const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_rtree;
+        std::vector<VertexClassList> &computed;
+
+        ClassifyUnsharedGroup(const VertexClassification &_vclass,
+                              int _other,
+                              const carve::mesh::MeshSet<3> *_poly,
+                              const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *_poly_rtree,
+                              std::vector<VertexClassList> &_computed) :
+            vclass(_vclass), other(_other), poly(_poly), poly_rtree(_poly_rtree), computed(_computed) {
+        }
+
+        FaceClass operator()(size_t index, FaceLoopGroup &grp) const {
+          for (FaceLoop *fl = grp.face_loops.head; fl != NULL; fl = fl->next) {
+            for (size_t fli = 0; fli < fl->vertices.size(); ++fli) {
+              const carve::mesh::MeshSet<3>::vertex_t *v = fl->vertices[fli];
+              PointClass pc = POINT_UNK;
+              VertexClassification::const_iterator c = vclass.find(v);
+              if (c != vclass.end()) pc = (*c).second.cls[other];
+              if (pc == POINT_UNK) {
+                pc = carve::mesh::classifyPoint(poly, poly_rtree, v->v);
+                computed[index].push_back(std::make_pair(v, pc));
+              }
+              switch (pc) {
+                case POINT_IN: return FACE_IN;
+                case POINT_OUT: return FACE_OUT;
+                default: break;
+              }
+            }
+          }
+          return FACE_UNCLASSIFIED;
+        }
+      };
+
+
+
+      void classifyUnsharedGroups(FLGroupList &grp,
+                                  VertexClassification &vclass,
+                                  int other,
+                                  const carve::mesh::MeshSet<3> *poly,
+                                  const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_rtree,
+                                  const char *error) {
+        std::vector<FLGroupList::iterator> groups;
+        for (FLGroupList::iterator i = grp.begin(); i != grp.end(); ++i) {
+          if ((*i).classification.size() == 0) {
+#if defined(CARVE_DEBUG)
+            std::cerr << " non intersecting group (poly " << "ba"[other] << "): " << &(*i) << std::endl;
+#endif
+            groups.push_back(i);
+          }
+        }
+
+        std::vector<VertexClassList> computed(groups.size());
+        std::vector<FaceClass> group_class;
+        classifyGroups(groups, ClassifyUnsharedGroup(vclass, other, poly, poly_rtree, computed), group_class);
+
+        for (size_t i = 0; i < groups.size(); ++i) {
+          for (size_t j = 0; j < computed[i].size(); ++j) {
+            vclass[computed[i][j].first].cls[other] = computed[i][j].second;
+          }
+          if (group_class[i] == FACE_UNCLASSIFIED) {
+            throw carve::exception(error);
+          }
+          (*groups[i]).classification.push_back(ClassificationInfo(NULL, group_class[i]));
+        }
+      }
+
     }
 
 
@@ -720,67 +801,8 @@ namespace carve {
         }
       }
 
-      for (FLGroupList::iterator i = a_loops_grouped.begin(); i != a_loops_grouped.end(); ++i) {
-        if ((*i).classification.size() == 0) {
-#if defined(CARVE_DEBUG)
-          std::cerr << " non intersecting group (poly a): " << &(*i) << std::endl;
-#endif
-          bool classified = false;
-          for (FaceLoop *fl = (*i).face_loops.head; !classified && fl != NULL; fl = fl->next) {
-            for (size_t fli = 0; !classified && fli < fl->vertices.size(); ++fli) {
-              if (vclass[fl->vertices[fli]].cls[1] == POINT_UNK) { 
-                vclass[fl->vertices[fli]].cls[1] = carve::mesh::classifyPoint(poly_b, poly_b_rtree, fl->vertices[fli]->v);
-              }
-              switch (vclass[fl->vertices[fli]].cls[1]) {
-                case POINT_IN:
-                  (*i).classification.push_back(ClassificationInfo(NULL, FACE_IN));
-                  classified = true;
-                  break;
-                case POINT_OUT:
-                  (*i).classification.push_back(ClassificationInfo(NULL, FACE_OUT));
-                  classified = true;
-                  break;
-                default:
-                  break;
-              }
-            }
-          }
-          if (!classified) {
-            throw carve::exception("non intersecting group is not IN or OUT! (poly_a)");
-          }
-        }
-      }
-
-      for (FLGroupList::iterator i = b_loops_grouped.begin(); i != b_loops_grouped.end(); ++i) {
-        if ((*i).classification.size() == 0) {
-#if defined(CARVE_DEBUG)
-          std::cerr << " non intersecting group (poly b): " << &(*i) << std::endl;
-#endif
-          bool classified = false;
-          for (FaceLoop *fl = (*i).face_loops.head; !classified && fl != NULL; fl = fl->next) {
-            for (size_t fli = 0; !classified && fli < fl->vertices.size(); ++fli) {
-              if (vclass[fl->vertices[fli]].cls[0] == POINT_UNK) { 
-                vclass[fl->vertices[fli]].cls[0] = carve::mesh::classifyPoint(poly_a, poly_a_rtree, fl->vertices[fli]->v);
-              }
-              switch (vclass[fl->vertices[fli]].cls[0]) {
-                case POINT_IN:
-                  (*i).classification.push_back(ClassificationInfo(NULL, FACE_IN));
-                  classified = true;
-                  break;
-                case POINT_OUT:
-                  (*i).classification.push_back(ClassificationInfo(NULL, FACE_OUT));
-                  classified = true;
-                  break;
-                default:
-                  break;
-              }
-            }
-          }
-          if (!classified) {
-            throw carve::exception("non intersecting group is not IN or OUT! (poly_b)");
-          }
-        }
-      }
+      classifyUnsharedGroups(a_loops_grouped, vclass, 1, poly_b, poly_b_rtree, "non intersecting group is not IN or OUT! (poly_a)");
+      classifyUnsharedGroups(b_loops_grouped, vclass, 0, poly_a, poly_a_rtree, "non intersecting group is not IN or OUT! (poly_b)");
 
 #if defined(DISPLAY_GRP_GRAPH)
 #define POLY(grp) (std::string((grp)->face_loops.head->orig_face->polyhedron == poly_a ? "[A:" : "[B:") + CODE(grp) + "]")
@@ -27,6 +27,7 @@
 #include <iostream>
 
 #include <algorithm>
+#include <memory>
 
 #include "intersect_common.hpp"
 #include "intersect_classify_common.hpp"
@@ -49,8 +50,9 @@ namespace carve {
 
         FaceMaker0(CSG::Collector &c, CSG::Hooks &h) : collector(c), hooks(h) {
         }
-        bool pointOn(VertexClassification &vclass, FaceLoop *f, size_t index) const {
-          return vclass[f->vertices[index]].cls[1] == POINT_ON;
+        bool pointOn(const VertexClassification &vclass, FaceLoop *f, size_t index) const {
+          VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+          return i != vclass.end() && (*i).second.cls[1] == POINT_ON;
         }
         void explain(FaceLoop *f, size_t index, PointClass pc) const {
 #if defined(CARVE_DEBUG)
@@ -65,8 +67,9 @@ namespace carve {
 
         FaceMaker1(CSG::Collector &c, CSG::Hooks &h) : collector(c), hooks(h) {
         }
-        bool pointOn(VertexClassification &vclass, FaceLoop *f, size_t index) const {
-          return vclass[f->vertices[index]].cls[0] == POINT_ON;
+        bool pointOn(const VertexClassification &vclass, FaceLoop *f, size_t index) const {
+          VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+          return i != vclass.end() && (*i).second.cls[0] == POINT_ON;
         }
         void explain(FaceLoop *f, size_t index, PointClass pc) const {
 #if defined(CARVE_DEBUG)
@@ -86,8 +89,9 @@ namespace carve {
         FaceMaker(CSG::Collector &c, CSG::Hooks &h) : collector(c), hooks(h) {
         }
 
-        bool pointOn(VertexClassification &vclass, FaceLoop *f, size_t index) const {
-          return vclass[f->vertices[index]].cls[1 - poly_num] == POINT_ON;
+        bool pointOn(const VertexClassification &vclass, FaceLoop *f, size_t index) const {
+          VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+          return i != vclass.end() && (*i).second.cls[1 - poly_num] == POINT_ON;
         }
 
         void explain(FaceLoop *f, size_t index, PointClass pc) const {
@@ -105,8 +109,15 @@ namespace carve {
       public:
         CSG::Collector &collector;
         CSG::Hooks &hooks;
+        // winding number evaluators for poly_a and poly_b, or NULL to
+        // classify points by ray parity.
+        const carve::mesh::WindingNumber *a_winding;
+        const carve::mesh::WindingNumber *b_winding;
 
-        ClassifyFaceGroups(CSG::Collector &c, CSG::Hooks &h) : collector(c), hooks(h) {
+        ClassifyFaceGroups(CSG::Collector &c, CSG::Hooks &h,
+                           const carve::mesh::WindingNumber *a_w,
+                           const carve::mesh::WindingNumber *b_w) :
+            collector(c), hooks(h), a_winding(a_w), b_winding(b_w) {
         }
     
         void classifySimple(FLGroupList &a_loops_grouped,
@@ -129,11 +140,11 @@ namespace carve {
                           FLGroupList &b_loops_grouped,
                           VertexClassification &vclass,
                           carve::mesh::MeshSet<3> *poly_a,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                           carve::mesh::MeshSet<3> *poly_b,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
-          performClassifyEasyFaceGroups(a_loops_grouped, poly_b, poly_b_rtree, vclass, FaceMaker0(collector, hooks), collector, hooks);
-          performClassifyEasyFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, vclass, FaceMaker1(collector, hooks), collector, hooks);
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
+          performClassifyEasyFaceGroups(a_loops_grouped, poly_b, poly_b_rtree, b_winding, vclass, FaceMaker0(collector, hooks), collector, hooks);
+          performClassifyEasyFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, a_winding, vclass, FaceMaker1(collector, hooks), collector, hooks);
 #if defined(CARVE_DEBUG)
           std::cerr << "after removal of easy groups: " << a_loops_grouped.size() << " a groups" << std::endl;
           std::cerr << "after removal of easy groups: " << b_loops_grouped.size() << " b groups" << std::endl;
@@ -144,11 +155,11 @@ namespace carve {
                           FLGroupList &b_loops_grouped,
                           VertexClassification & /* vclass */,
                           carve::mesh::MeshSet<3> *poly_a,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                           carve::mesh::MeshSet<3> *poly_b,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
-          performClassifyHardFaceGroups(a_loops_grouped, poly_b, poly_b_rtree, FaceMaker0(collector, hooks), collector, hooks);
-          performClassifyHardFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, FaceMaker1(collector, hooks), collector, hooks);
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
+          performClassifyHardFaceGroups(a_loops_grouped, poly_b, poly_b_rtree, b_winding, FaceMaker0(collector, hooks), collector, hooks);
+          performClassifyHardFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, a_winding, FaceMaker1(collector, hooks), collector, hooks);
 #if defined(CARVE_DEBUG)
           std::cerr << "after removal of hard groups: " << a_loops_grouped.size() << " a groups" << std::endl;
           std::cerr << "after removal of hard groups: " << b_loops_grouped.size() << " b groups" << std::endl;
@@ -159,11 +170,11 @@ namespace carve {
                           FLGroupList &b_loops_grouped,
                           VertexClassification & /* vclass */,
                           carve::mesh::MeshSet<3> *poly_a,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                           carve::mesh::MeshSet<3> *poly_b,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
-          performFaceLoopWork(poly_b, poly_b_rtree, a_loops_grouped, *this, collector, hooks);
-          performFaceLoopWork(poly_a, poly_a_rtree, b_loops_grouped, *this, collector, hooks);
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
+          performFaceLoopWork(poly_b, poly_b_rtree, b_winding, a_loops_grouped, *this, collector, hooks);
+          performFaceLoopWork(poly_a, poly_a_rtree, a_winding, b_loops_grouped, *this, collector, hooks);
         }
     
         void postRemovalCheck(FLGroupList &a_loops_grouped,
@@ -190,15 +201,21 @@ namespace carve {
     void CSG::classifyFaceGroups(const V2Set & /* shared_edges */,
                                  VertexClassification &vclass,
                                  carve::mesh::MeshSet<3> *poly_a,                           
-                                 const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                                 const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                                  FLGroupList &a_loops_grouped,
                                  const detail::LoopEdges & /* a_edge_map */,
                                  carve::mesh::MeshSet<3> *poly_b,
-                                 const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree,
+                                 const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree,
                                  FLGroupList &b_loops_grouped,
                                  const detail::LoopEdges & /* b_edge_map */,
                                  CSG::Collector &collector) {
-      ClassifyFaceGroups classifier(collector, hooks);
+      std::auto_ptr<carve::mesh::WindingNumber> a_winding, b_winding;
+      if (point_classifier == POINT_CLASSIFIER_WINDING_NUMBER) {
+        a_winding.reset(new carve::mesh::WindingNumber(poly_a, poly_a_rtree));
+        b_winding.reset(new carve::mesh::WindingNumber(poly_b, poly_b_rtree));
+      }
+
+      ClassifyFaceGroups classifier(collector, hooks, a_winding.get(), b_winding.get());
 #if defined(CARVE_DEBUG)
       std::cerr << "initial groups: " << a_loops_grouped.size() << " a groups" << std::endl;
       std::cerr << "initial groups: " << b_loops_grouped.size() << " b groups" << std::endl;
@@ -31,6 +31,10 @@
 
 #include <algorithm>
 
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
 #include "csg_detail.hpp"
 #include "csg_data.hpp"
 
@@ -1445,6 +1449,25 @@ namespace {
     std::cerr << "};\n";
   }
 
+  // true if the base loop of face is its original vertex loop, and
+  // the face is not split; that is, if face is unchanged by the
+  // intersection.
+  bool faceIsUntouched(carve::mesh::MeshSet<3>::face_t *face,
+                       const carve::csg::detail::Data &data) {
+    if (data.face_split_edges.find(face) != data.face_split_edges.end()) return false;
+
+    carve::mesh::MeshSet<3>::edge_t *e = face->edge;
+    do {
+      if (data.vmap.find(e->vert) != data.vmap.end()) return false;
+      if (data.divided_edges.find(e) != data.divided_edges.end()) return false;
+      e = e->next;
+    } while (e != face->edge);
+
+    return true;
+  }
+
+
+
   void generateOneFaceLoop(carve::mesh::MeshSet<3>::face_t *face,
                            const carve::csg::detail::Data &data,
                            const carve::csg::VertexIntersections &vertex_intersections,
@@ -1649,20 +1672,78 @@ namespace {
  * @param[in] poly The polyhedron to process
  * @param[in] data Internal intersection data
  * @param[out] face_loops_out The resulting face loops
+ * @param[in] candidate_meshes_only If true, only process the faces of
+ *   meshes in data.candidate_meshes.
+ * @param[out] untouched_faces If not NULL, faces that no intersection
+ *   touched are appended, and no face loops are generated for them.
  * 
  * @return The number of edges generated.
  */
 size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
                                           const detail::Data &data,
-                                          FaceLoopList &face_loops_out) {
+                                          FaceLoopList &face_loops_out,
+                                          bool candidate_meshes_only,
+                                          std::vector<carve::mesh::MeshSet<3>::face_t *> *untouched_faces) {
   static carve::TimingName FUNC_NAME("CSG::generateFaceLoops()");
   carve::TimingBlock block(FUNC_NAME);
   size_t generated_edges = 0;
-  std::vector<carve::mesh::MeshSet<3>::vertex_t *> base_loop;
-  std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> > face_loops;
-  
-  for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin(); i != poly->faceEnd(); ++i) {
-    carve::mesh::MeshSet<3>::face_t *face = (*i);
+
+  std::vector<carve::mesh::MeshSet<3>::face_t *> faces;
+  if (candidate_meshes_only) {
+    for (size_t i = 0; i < poly->meshes.size(); ++i) {
+      if (data.candidate_meshes.find(poly->meshes[i]) == data.candidate_meshes.end()) continue;
+      faces.insert(faces.end(), poly->meshes[i]->faces.begin(), poly->meshes[i]->faces.end());
+    }
+  } else {
+    faces.assign(poly->faceBegin(), poly->faceEnd());
+  }
+
+  if (untouched_faces != NULL) {
+    size_t n_touched = 0;
+    for (size_t i = 0; i < faces.size(); ++i) {
+      if (faceIsUntouched(faces[i], data)) {
+        untouched_faces->push_back(faces[i]);
+      } else {
+        faces[n_touched++] = faces[i];
+      }
+    }
+    faces.resize(n_touched);
+  }
+
+  // the loops of each face only depend upon data and
+  // vertex_intersections, so they are generated independently, and
+  // then appended to face_loops_out in face order.
+  std::vector<std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> > > face_loops(faces.size());
+
+#if defined(_OPENMP) && !defined(CARVE_DEBUG)
+  // edge division hooks are invoked while assembling base loops, and
+  // are not expected to be reentrant.
+  if (omp_get_max_threads() > 1 &&
+      faces.size() >= 64 &&
+      !hooks.hasHook(Hooks::EDGE_DIVISION_HOOK)) {
+    std::vector<std::string> face_error(faces.size());
+    std::vector<char> face_failed(faces.size(), 0);
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int n = 0; n < (int)faces.size(); ++n) {
+      try {
+        generateOneFaceLoop(faces[n], data, vertex_intersections, hooks, face_loops[n]);
+      } catch (carve::exception &e) {
+        face_failed[n] = 1;
+        face_error[n] = e.str();
+      } catch (...) {
+        face_failed[n] = 1;
+        face_error[n] = "unexpected exception in face loop generation";
+      }
+    }
+
+    for (size_t n = 0; n < faces.size(); ++n) {
+      if (face_failed[n]) throw carve::exception(face_error[n]);
+    }
+  } else
+#endif
+  for (size_t n = 0; n < faces.size(); ++n) {
+    carve::mesh::MeshSet<3>::face_t *face = faces[n];
 
 #if defined(CARVE_DEBUG)
     double in_area = 0.0, out_area = 0.0;
@@ -1684,7 +1765,7 @@ size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
     }
 #endif
 
-    generateOneFaceLoop(face, data, vertex_intersections, hooks, face_loops);
+    generateOneFaceLoop(face, data, vertex_intersections, hooks, face_loops[n]);
 
 #if defined(CARVE_DEBUG)
     {
@@ -1697,7 +1778,7 @@ size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
         face_edges.insert(std::make_pair(base_loop[j+1], base_loop[j]));
       }
       face_edges.insert(std::make_pair(base_loop[0], base_loop.back()));
-      for (std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> >::const_iterator fli = face_loops.begin(); fli != face_loops.end(); ++ fli) {
+      for (std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> >::const_iterator fli = face_loops[n].begin(); fli != face_loops[n].end(); ++ fli) {
 
         {
           std::vector<carve::geom2d::P2> projected;
@@ -1707,7 +1788,7 @@ size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
           }
 
           double area = carve::geom2d::signedArea(projected);
-          std::cerr << "### loop_area[" << std::distance((std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> >::const_iterator)face_loops.begin(), fli) << "]=" << area << std::endl;
+          std::cerr << "### loop_area[" << std::distance((std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> >::const_iterator)face_loops[n].begin(), fli) << "]=" << area << std::endl;
           out_area += area;
         }
 
@@ -1730,12 +1811,15 @@ size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
     }
 #endif
 
-    // now record all the resulting face loops.
+  }
+
+  // now record all the resulting face loops.
+  for (size_t n = 0; n < faces.size(); ++n) {
 #if defined(CARVE_DEBUG)
     std::cerr << "### ======" << std::endl;
 #endif
     for (std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> >::const_iterator
-           f = face_loops.begin(), fe = face_loops.end();
+           f = face_loops[n].begin(), fe = face_loops[n].end();
          f != fe;
          ++f) {
 #if defined(CARVE_DEBUG)
@@ -1746,7 +1830,7 @@ size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
       std::cerr << std::endl;
 #endif
 
-      face_loops_out.append(new FaceLoop(face, *f));
+      face_loops_out.append(FaceLoop::create(faces[n], *f));
       generated_edges += (*f).size();
     }
 #if defined(CARVE_DEBUG)
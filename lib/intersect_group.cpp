@@ -21,6 +21,7 @@
 
 #include <carve/csg.hpp>
 #include <carve/timing.hpp>
+#include <carve/djset.hpp>
 
 #include "csg_detail.hpp"
 #include "intersect_common.hpp"
@@ -186,7 +187,7 @@ void carve::csg::CSG::groupFaceLoops(carve::mesh::MeshSet<3> *src,
 
           j = loop_edges.find(std::make_pair(v1, v2));
           if (j != loop_edges.end()) {
-            for (std::list<carve::csg::FaceLoop *>::const_iterator
+            for (carve::csg::detail::FLList::const_iterator
                    k = (*j).second.begin(), ke = (*j).second.end();
                  k != ke; ++k) {
               if ((*k)->group != NULL ||
@@ -199,7 +200,7 @@ void carve::csg::CSG::groupFaceLoops(carve::mesh::MeshSet<3> *src,
 
           j = loop_edges.find(std::make_pair(v2, v1));
           if (j != loop_edges.end()) {
-            for (std::list<carve::csg::FaceLoop *>::const_iterator
+            for (carve::csg::detail::FLList::const_iterator
                    k = (*j).second.begin(), ke = (*j).second.end();
                  k != ke; ++k) {
               if ((*k)->group != NULL ||
@@ -230,3 +231,92 @@ void carve::csg::CSG::groupFaceLoops(carve::mesh::MeshSet<3> *src,
 #endif
   }
 }
+
+
+
+/** 
+ * \brief Attach patches of untouched faces to the groups they border.
+ *
+ * Untouched faces are divided into patches that are connected by
+ * mesh edges. No intersection crosses a patch, so a patch lies in the
+ * same group as the face loop on the other side of any edge of its
+ * boundary. Patches that do not border a face loop (which can happen
+ * at the open edges of a mesh) form groups of their own, made of
+ * face loops.
+ * 
+ * @param[in] poly The polyhedron that the untouched faces belong to.
+ * @param[in] untouched_faces The faces left out of face loop generation.
+ * @param[in] edge_map The loop edge mapping for the face loops of \a poly.
+ * @param[in,out] out_loops The face loop groups of \a poly.
+ */
+void carve::csg::CSG::attachUntouchedFaces(carve::mesh::MeshSet<3> *poly,
+                                           const std::vector<carve::mesh::MeshSet<3>::face_t *> &untouched_faces,
+                                           const carve::csg::detail::LoopEdges &edge_map,
+                                           carve::csg::FLGroupList &out_loops) {
+  static carve::TimingName FUNC_NAME("CSG::attachUntouchedFaces()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  typedef carve::mesh::MeshSet<3>::face_t face_t;
+  typedef carve::mesh::MeshSet<3>::edge_t edge_t;
+
+  std::unordered_map<const face_t *, size_t> face_index;
+  for (size_t i = 0; i < untouched_faces.size(); ++i) {
+    face_index[untouched_faces[i]] = i;
+  }
+
+  carve::djset::djset patches(untouched_faces.size());
+  for (size_t i = 0; i < untouched_faces.size(); ++i) {
+    edge_t *e = untouched_faces[i]->edge;
+    do {
+      if (e->rev != NULL) {
+        std::unordered_map<const face_t *, size_t>::const_iterator j = face_index.find(e->rev->face);
+        if (j != face_index.end()) patches.merge_sets(i, (*j).second);
+      }
+      e = e->next;
+    } while (e != untouched_faces[i]->edge);
+  }
+
+  // find, for each patch, the group of a face loop across one of its
+  // boundary edges. An untouched face has no divided edges, so the
+  // neighbouring loop contains the reverse of the edge.
+  std::vector<FaceLoopGroup *> patch_group(untouched_faces.size(), (FaceLoopGroup *)NULL);
+  for (size_t i = 0; i < untouched_faces.size(); ++i) {
+    size_t p = patches.find_set_head(i);
+    if (patch_group[p] != NULL) continue;
+    edge_t *e = untouched_faces[i]->edge;
+    do {
+      if (e->rev != NULL && face_index.find(e->rev->face) == face_index.end()) {
+        detail::LoopEdges::const_iterator j = edge_map.find(std::make_pair(e->v2(), e->v1()));
+        if (j != edge_map.end()) {
+          for (detail::FLList::const_iterator
+                 k = (*j).second.begin(), ke = (*j).second.end(); k != ke; ++k) {
+            if ((*k)->orig_face == e->rev->face && (*k)->group != NULL) {
+              patch_group[p] = (*k)->group;
+              break;
+            }
+          }
+        }
+      }
+      e = e->next;
+    } while (patch_group[p] == NULL && e != untouched_faces[i]->edge);
+  }
+
+  std::vector<FaceLoopGroup *> own_group(untouched_faces.size(), (FaceLoopGroup *)NULL);
+  for (size_t i = 0; i < untouched_faces.size(); ++i) {
+    size_t p = patches.find_set_head(i);
+    if (patch_group[p] != NULL) {
+      patch_group[p]->untouched_faces.push_back(untouched_faces[i]);
+      continue;
+    }
+
+    if (own_group[p] == NULL) {
+      out_loops.push_back(FaceLoopGroup(poly));
+      own_group[p] = &out_loops.back();
+    }
+    std::vector<carve::mesh::MeshSet<3>::vertex_t *> vertices;
+    untouched_faces[i]->getVertices(vertices);
+    FaceLoop *fl = FaceLoop::create(untouched_faces[i], vertices);
+    fl->group = own_group[p];
+    own_group[p]->face_loops.append(fl);
+  }
+}
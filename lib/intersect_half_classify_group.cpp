@@ -75,8 +75,9 @@ namespace carve {
       class FaceMaker {
       public:
  
-        bool pointOn(VertexClassification &vclass, FaceLoop *f, size_t index) const {
-          return vclass[f->vertices[index]].cls[0] == POINT_ON;
+        bool pointOn(const VertexClassification &vclass, FaceLoop *f, size_t index) const {
+          VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+          return i != vclass.end() && (*i).second.cls[0] == POINT_ON;
         }
 
         void explain(FaceLoop *f, size_t index, PointClass pc) const {
@@ -112,11 +113,11 @@ namespace carve {
                           FLGroupList &b_loops_grouped,
                           VertexClassification & vclass,
                           carve::mesh::MeshSet<3> *poly_a,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                           carve::mesh::MeshSet<3> *poly_b,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
           GroupPoly group_poly(poly_b, b_out);
-          performClassifyEasyFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, vclass, FaceMaker(), group_poly, hooks);
+          performClassifyEasyFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, NULL, vclass, FaceMaker(), group_poly, hooks);
 #if defined(CARVE_DEBUG)
           std::cerr << "after removal of easy groups: " << b_loops_grouped.size() << " b groups" << std::endl;
 #endif
@@ -126,11 +127,11 @@ namespace carve {
                           FLGroupList &b_loops_grouped,
                           VertexClassification & /* vclass */,
                           carve::mesh::MeshSet<3> *poly_a,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                           carve::mesh::MeshSet<3> *poly_b,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
           GroupPoly group_poly(poly_b, b_out);
-          performClassifyHardFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, FaceMaker(), group_poly, hooks);
+          performClassifyHardFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, NULL, FaceMaker(), group_poly, hooks);
 #if defined(CARVE_DEBUG)
           std::cerr << "after removal of hard groups: " << b_loops_grouped.size() << " b groups" << std::endl;
 #endif
@@ -141,11 +142,11 @@ namespace carve {
                           FLGroupList &b_loops_grouped,
                           VertexClassification & /* vclass */,
                           carve::mesh::MeshSet<3> *poly_a,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                           carve::mesh::MeshSet<3> *poly_b,
-                          const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
+                          const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree) const {
           GroupPoly group_poly(poly_b, b_out);
-          performFaceLoopWork(poly_a, poly_a_rtree, b_loops_grouped, *this, group_poly, hooks);
+          performFaceLoopWork(poly_a, poly_a_rtree, NULL, b_loops_grouped, *this, group_poly, hooks);
         }
 
         void postRemovalCheck(FLGroupList & /* a_loops_grouped */,
@@ -172,11 +173,11 @@ namespace carve {
     void CSG::halfClassifyFaceGroups(const V2Set & /* shared_edges */,
                                      VertexClassification &vclass,
                                      carve::mesh::MeshSet<3> *poly_a,                           
-                                     const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_a_rtree,
+                                     const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_a_rtree,
                                      FLGroupList &a_loops_grouped,
                                      const detail::LoopEdges & /* a_edge_map */,
                                      carve::mesh::MeshSet<3> *poly_b,
-                                     const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *poly_b_rtree,
+                                     const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *poly_b_rtree,
                                      FLGroupList &b_loops_grouped,
                                      const detail::LoopEdges & /* b_edge_map */,
                                      std::list<std::pair<FaceClass, carve::mesh::MeshSet<3> *> > &b_out) {
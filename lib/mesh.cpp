@@ -21,10 +21,16 @@
 
 #include <carve/mesh.hpp>
 #include <carve/mesh_impl.hpp>
-#include <carve/rtree.hpp>
+#include <carve/flat_rtree.hpp>
 
 #include <carve/poly.hpp>
 
+#include <stdint.h>
+
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
 namespace {
   inline double CALC_X(const carve::geom::plane<3> &p, double y, double z) { return -(p.d + p.N.y * y + p.N.z * z) / p.N.x; }
   inline double CALC_Y(const carve::geom::plane<3> &p, double x, double z) { return -(p.d + p.N.x * x + p.N.z * z) / p.N.y; }
@@ -127,6 +133,11 @@ namespace carve {
     bool Face<ndim>::containsPoint(const vector_t &p) const {
       if (!carve::math::ZERO(carve::geom::distance(plane, p))) return false;
       // return pointInPolySimple(vertices, projector(), (this->*project)(p));
+      if (n_edges == 3) {
+        carve::geom::vector<2> tri[3];
+        getProjectedTriangle(tri);
+        return carve::geom2d::pointInTriangle(tri, project(p)).iclass != carve::POINT_OUT;
+      }
       std::vector<carve::geom::vector<2> > verts;
       getProjectedVertices(verts);
       return carve::geom2d::pointInPoly(verts, project(p)).iclass != carve::POINT_OUT;
@@ -136,6 +147,11 @@ namespace carve {
 
     template<unsigned ndim>
     bool Face<ndim>::containsPointInProjection(const vector_t &p) const {
+      if (n_edges == 3) {
+        carve::geom::vector<2> tri[3];
+        getProjectedTriangle(tri);
+        return carve::geom2d::pointInTriangle(tri, project(p)).iclass != carve::POINT_OUT;
+      }
       std::vector<carve::geom::vector<2> > verts;
       getProjectedVertices(verts);
       return carve::geom2d::pointInPoly(verts, project(p)).iclass != carve::POINT_OUT;
@@ -156,9 +172,17 @@ namespace carve {
         return false;
       }
 
-      std::vector<carve::geom::vector<2> > verts;
-      getProjectedVertices(verts);
-      if (carve::geom2d::pointInPolySimple(verts, project(p))) {
+      bool inside;
+      if (n_edges == 3) {
+        carve::geom::vector<2> tri[3];
+        getProjectedTriangle(tri);
+        inside = carve::geom2d::pointInTriangleSimple(tri, project(p));
+      } else {
+        std::vector<carve::geom::vector<2> > verts;
+        getProjectedVertices(verts);
+        inside = carve::geom2d::pointInPolySimple(verts, project(p));
+      }
+      if (inside) {
         intersection = p;
         return true;
       }
@@ -179,9 +203,16 @@ namespace carve {
         return intersects;
       }
 
-      std::vector<carve::geom::vector<2> > verts;
-      getProjectedVertices(verts);
-      carve::geom2d::PolyInclusionInfo pi = carve::geom2d::pointInPoly(verts, project(p));
+      carve::geom2d::PolyInclusionInfo pi(POINT_OUT);
+      if (n_edges == 3) {
+        carve::geom::vector<2> tri[3];
+        getProjectedTriangle(tri);
+        pi = carve::geom2d::pointInTriangle(tri, project(p));
+      } else {
+        std::vector<carve::geom::vector<2> > verts;
+        getProjectedVertices(verts);
+        pi = carve::geom2d::pointInPoly(verts, project(p));
+      }
       switch (pi.iclass) {
       case POINT_VERTEX:
         intersection = p;
@@ -1025,193 +1056,376 @@ template class carve::mesh::MeshSet<3>;
 
 
 
-carve::PointClass carve::mesh::classifyPoint(
-    const carve::mesh::MeshSet<3> *meshset,
-    const carve::geom::RTreeNode<3, carve::mesh::Face<3> *> *face_rtree,
-    const carve::geom::vector<3> &v,
-    bool even_odd,
-    const carve::mesh::Mesh<3> *mesh,
-    const carve::mesh::Face<3> **hit_face) {
+namespace {
 
-  if (hit_face) *hit_face = NULL;
+  typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
 
-#if defined(DEBUG_CONTAINS_VERTEX)
-  std::cerr << "{containsVertex " << v << "}" << std::endl;
-#endif
 
-  if (!face_rtree->bbox.containsPoint(v)) {
-#if defined(DEBUG_CONTAINS_VERTEX)
-    std::cerr << "{final:OUT(aabb short circuit)}" << std::endl;
-#endif
+
+  // the classification of points outside the bounding box of meshset.
+  carve::PointClass classifyDistantPoint(const carve::mesh::MeshSet<3> *meshset) {
     // XXX: if the top level manifolds are negative, this should be POINT_IN.
     // for the moment, this only works for a single manifold.
     if (meshset->meshes.size() == 1 && meshset->meshes[0]->isNegative()) {
-      return POINT_IN;
+      return carve::POINT_IN;
     }
-    return POINT_OUT;
+    return carve::POINT_OUT;
   }
 
-  std::vector<carve::mesh::Face<3> *> near_faces;
-  face_rtree->search(v, std::back_inserter(near_faces));
 
-  for (size_t i = 0; i < near_faces.size(); i++) {
-    if (mesh != NULL && mesh != near_faces[i]->mesh) continue;
 
-    // XXX: Do allow the tested vertex to be ON an open
-    // manifold. This was here originally because of the
-    // possibility of an open manifold contained within a closed
-    // manifold.
+  /**
+   * \brief Point classification state, reused between queries.
+   */
+  struct PointClassifier {
+    // the faces in the R-tree leaves whose bounding boxes contain
+    // the point being classified.
+    std::vector<carve::mesh::Face<3> *> near_faces;
+    std::vector<carve::mesh::Face<3> *> ray_faces;
+    std::vector<std::pair<const carve::mesh::Face<3> *, carve::geom::vector<3> > > manifold_intersections;
+    std::map<const carve::mesh::Mesh<3> *, int> crossings;
 
-    // if (!near_faces[i]->mesh->isClosed()) continue;
+    // classify v, which lies within the bounds of face_rtree, given near_faces.
+    carve::PointClass classify(const carve::mesh::MeshSet<3> * /* meshset */,
+                               const face_rtree_t *face_rtree,
+                               const carve::geom::vector<3> &v,
+                               bool even_odd,
+                               const carve::mesh::Mesh<3> *mesh,
+                               const carve::mesh::Face<3> **hit_face) {
+      using namespace carve;
 
-    if (near_faces[i]->containsPoint(v)) {
+      for (size_t i = 0; i < near_faces.size(); i++) {
+        if (mesh != NULL && mesh != near_faces[i]->mesh) continue;
+
+        // XXX: Do allow the tested vertex to be ON an open
+        // manifold. This was here originally because of the
+        // possibility of an open manifold contained within a closed
+        // manifold.
+
+        // if (!near_faces[i]->mesh->isClosed()) continue;
+
+        if (near_faces[i]->containsPoint(v)) {
 #if defined(DEBUG_CONTAINS_VERTEX)
-      std::cerr << "{final:ON(hits face " << near_faces[i] << ")}" << std::endl;
+          std::cerr << "{final:ON(hits face " << near_faces[i] << ")}" << std::endl;
 #endif
-      if (hit_face) *hit_face = near_faces[i];
-      return POINT_ON;
-    }
-  }
-
-  double ray_len = face_rtree->bbox.extent.length() * 2;
+          if (hit_face) *hit_face = near_faces[i];
+          return POINT_ON;
+        }
+      }
 
+      double ray_len = face_rtree->getAABB().extent.length() * 2;
 
-  std::vector<std::pair<const carve::mesh::Face<3> *, carve::geom::vector<3> > > manifold_intersections;
+      carve::geom3d::RayDirections ray_dirs;
 
-  for (;;) {
-    double a1 = random() / double(RAND_MAX) * M_TWOPI;
-    double a2 = random() / double(RAND_MAX) * M_TWOPI;
+      for (;;) {
+        carve::geom3d::Vector ray_dir = ray_dirs.next();
 
-    carve::geom3d::Vector ray_dir = carve::geom::VECTOR(sin(a1) * sin(a2), cos(a1) * sin(a2), cos(a2));
+#if defined(DEBUG_CONTAINS_VERTEX)
+        std::cerr << "{testing ray: " << ray_dir << "}" << std::endl;
+#endif
 
+        if (!even_odd) {
+          // a ray that is nearly parallel to a face close to v is likely
+          // to fail below; reject it before searching along the ray.
+          bool parallel = false;
+          for (size_t i = 0; !parallel && i < near_faces.size(); ++i) {
+            if (mesh != NULL && mesh != near_faces[i]->mesh) continue;
+            if (!near_faces[i]->mesh->isClosed()) continue;
+            parallel = fabs(dot(ray_dir, near_faces[i]->plane.N)) < EPSILON;
+          }
+          if (parallel) {
 #if defined(DEBUG_CONTAINS_VERTEX)
-    std::cerr << "{testing ray: " << ray_dir << "}" << std::endl;
+            std::cerr << "{rejecting(parallel to local face)}" << std::endl;
 #endif
+            continue;
+          }
+        }
 
-    carve::geom::vector<3> v2 = v + ray_dir * ray_len;
+        carve::geom::vector<3> v2 = v + ray_dir * ray_len;
 
-    bool failed = false;
-    carve::geom::linesegment<3> line(v, v2);
-    carve::geom::vector<3> intersection;
+        bool failed = false;
+        carve::geom::linesegment<3> line(v, v2);
+        carve::geom::vector<3> intersection;
 
-    near_faces.clear();
-    manifold_intersections.clear();
-    face_rtree->search(line, std::back_inserter(near_faces));
+        ray_faces.clear();
+        manifold_intersections.clear();
+        face_rtree->search(line, std::back_inserter(ray_faces));
 
-    for (unsigned i = 0; !failed && i < near_faces.size(); i++) {
-      if (mesh != NULL && mesh != near_faces[i]->mesh) continue;
+        for (unsigned i = 0; !failed && i < ray_faces.size(); i++) {
+          if (mesh != NULL && mesh != ray_faces[i]->mesh) continue;
 
-      if (!near_faces[i]->mesh->isClosed()) continue;
+          if (!ray_faces[i]->mesh->isClosed()) continue;
 
-      switch (near_faces[i]->lineSegmentIntersection(line, intersection)) {
-      case INTERSECT_FACE: {
+          switch (ray_faces[i]->lineSegmentIntersection(line, intersection)) {
+          case INTERSECT_FACE: {
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-        std::cerr << "{intersects face: " << near_faces[i]
-                  << " dp: " << dot(ray_dir, near_faces[i]->plane.N) << "}" << std::endl;
+            std::cerr << "{intersects face: " << ray_faces[i]
+                      << " dp: " << dot(ray_dir, ray_faces[i]->plane.N) << "}" << std::endl;
 #endif
 
-        if (!even_odd && fabs(dot(ray_dir, near_faces[i]->plane.N)) < EPSILON) {
+            if (!even_odd && fabs(dot(ray_dir, ray_faces[i]->plane.N)) < EPSILON) {
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-          std::cerr << "{failing(small dot product)}" << std::endl;
+              std::cerr << "{failing(small dot product)}" << std::endl;
 #endif
 
-          failed = true;
-          break;
-        }
-        manifold_intersections.push_back(std::make_pair(near_faces[i], intersection));
-        break;
-      }
-      case INTERSECT_NONE: {
-        break;
-      }
-      default: {
+              failed = true;
+              break;
+            }
+            manifold_intersections.push_back(std::make_pair(ray_faces[i], intersection));
+            break;
+          }
+          case INTERSECT_NONE: {
+            break;
+          }
+          default: {
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-        std::cerr << "{failing(degenerate intersection)}" << std::endl;
+            std::cerr << "{failing(degenerate intersection)}" << std::endl;
 #endif
-        failed = true;
-        break;
-      }
-      }
-    }
+            failed = true;
+            break;
+          }
+          }
+        }
 
-    if (!failed) {
-      if (even_odd) {
-        return (manifold_intersections.size() & 1) ? POINT_IN : POINT_OUT;
-      }
+        if (!failed) {
+          if (even_odd) {
+            return (manifold_intersections.size() & 1) ? POINT_IN : POINT_OUT;
+          }
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-      std::cerr << "{intersections ok [count:"
-                << manifold_intersections.size()
-                << "], sorting}"
-                << std::endl;
+          std::cerr << "{intersections ok [count:"
+                    << manifold_intersections.size()
+                    << "], sorting}"
+                    << std::endl;
 #endif
 
-      carve::geom3d::sortInDirectionOfRay(ray_dir,
-                                          manifold_intersections.begin(),
-                                          manifold_intersections.end(),
-                                          carve::geom3d::vec_adapt_pair_second());
+          carve::geom3d::sortInDirectionOfRay(ray_dir,
+                                              manifold_intersections.begin(),
+                                              manifold_intersections.end(),
+                                              carve::geom3d::vec_adapt_pair_second());
 
-      std::map<const carve::mesh::Mesh<3> *, int> crossings;
+          crossings.clear();
 
-      for (size_t i = 0; i < manifold_intersections.size(); ++i) {
-        const carve::mesh::Face<3> *f = manifold_intersections[i].first;
-        if (dot(ray_dir, f->plane.N) < 0.0) {
-          crossings[f->mesh]++;
-        } else {
-          crossings[f->mesh]--;
-        }
-      }
+          for (size_t i = 0; i < manifold_intersections.size(); ++i) {
+            const carve::mesh::Face<3> *f = manifold_intersections[i].first;
+            if (dot(ray_dir, f->plane.N) < 0.0) {
+              crossings[f->mesh]++;
+            } else {
+              crossings[f->mesh]--;
+            }
+          }
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-      for (std::map<const carve::mesh::Mesh<3> *, int>::const_iterator i = crossings.begin(); i != crossings.end(); ++i) {
-        std::cerr << "{mesh " << (*i).first << " crossing count: " << (*i).second << "}" << std::endl;
-      }
+          for (std::map<const carve::mesh::Mesh<3> *, int>::const_iterator i = crossings.begin(); i != crossings.end(); ++i) {
+            std::cerr << "{mesh " << (*i).first << " crossing count: " << (*i).second << "}" << std::endl;
+          }
 #endif
 
-      for (size_t i = 0; i < manifold_intersections.size(); ++i) {
-        const carve::mesh::Face<3> *f = manifold_intersections[i].first;
+          for (size_t i = 0; i < manifold_intersections.size(); ++i) {
+            const carve::mesh::Face<3> *f = manifold_intersections[i].first;
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-        std::cerr << "{intersection at "
-                  << manifold_intersections[i].second
-                  << " mesh: "
-                  << f->mesh
-                  << " count: "
-                  << crossings[f->mesh]
-                  << "}"
-                  << std::endl;
+            std::cerr << "{intersection at "
+                      << manifold_intersections[i].second
+                      << " mesh: "
+                      << f->mesh
+                      << " count: "
+                      << crossings[f->mesh]
+                      << "}"
+                      << std::endl;
 #endif
 
-        if (crossings[f->mesh] < 0) {
-          // inside this manifold.
+            if (crossings[f->mesh] < 0) {
+              // inside this manifold.
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-          std::cerr << "{final:IN}" << std::endl;
+              std::cerr << "{final:IN}" << std::endl;
 #endif
 
-          return POINT_IN;
-        } else if (crossings[f->mesh] > 0) {
-          // outside this manifold, but it's an infinite manifold. (for instance, an inverted cube)
+              return POINT_IN;
+            } else if (crossings[f->mesh] > 0) {
+              // outside this manifold, but it's an infinite manifold. (for instance, an inverted cube)
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-          std::cerr << "{final:OUT}" << std::endl;
+              std::cerr << "{final:OUT}" << std::endl;
+#endif
+
+              return POINT_OUT;
+            }
+          }
+
+#if defined(DEBUG_CONTAINS_VERTEX)
+          std::cerr << "{final:OUT(default)}" << std::endl;
 #endif
 
           return POINT_OUT;
         }
       }
+    }
+  };
+
+
+
+  // spread the low 10 bits of x out to every third bit.
+  inline uint32_t mortonSpread(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x <<  8)) & 0x0300f00f;
+    x = (x | (x <<  4)) & 0x030c30c3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+  }
+
+
+
+  // the Morton code of v, quantized to 10 bits per axis within box.
+  uint32_t mortonCode(const carve::geom::aabb<3> &box, const carve::geom::vector<3> &v) {
+    uint32_t c[3];
+    for (unsigned i = 0; i < 3; ++i) {
+      double t = 0.0;
+      if (box.extent.v[i] > 0.0) {
+        t = (v.v[i] - box.pos.v[i] + box.extent.v[i]) / (2.0 * box.extent.v[i]);
+        t = std::min(std::max(t, 0.0), 1.0);
+      }
+      c[i] = (uint32_t)(t * 1023.0);
+    }
+    return mortonSpread(c[0]) | (mortonSpread(c[1]) << 1) | (mortonSpread(c[2]) << 2);
+  }
+
+
+
+  // collect, in search order, the leaves below node that intersect
+  // box. node itself must intersect box.
+  void collectLeaves(const face_rtree_t *face_rtree,
+                     face_rtree_t::index_t node,
+                     const carve::geom::aabb<3> &box,
+                     std::vector<face_rtree_t::index_t> &leaves) {
+    if (face_rtree->isLeaf(node)) {
+      leaves.push_back(node);
+    } else {
+      face_rtree_t::intersecting_children children(*face_rtree, node, box);
+      for (face_rtree_t::index_t c; children.next(c); ) {
+        collectLeaves(face_rtree, c, box, leaves);
+      }
+    }
+  }
+
+}
+
+
+
+carve::PointClass carve::mesh::classifyPoint(
+    const carve::mesh::MeshSet<3> *meshset,
+    const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *face_rtree,
+    const carve::geom::vector<3> &v,
+    bool even_odd,
+    const carve::mesh::Mesh<3> *mesh,
+    const carve::mesh::Face<3> **hit_face) {
+
+  if (hit_face) *hit_face = NULL;
 
 #if defined(DEBUG_CONTAINS_VERTEX)
-      std::cerr << "{final:OUT(default)}" << std::endl;
+  std::cerr << "{containsVertex " << v << "}" << std::endl;
 #endif
 
-      return POINT_OUT;
-    }
+  if (!face_rtree->getAABB().containsPoint(v)) {
+#if defined(DEBUG_CONTAINS_VERTEX)
+    std::cerr << "{final:OUT(aabb short circuit)}" << std::endl;
+#endif
+    return classifyDistantPoint(meshset);
   }
+
+  PointClassifier classifier;
+  face_rtree->search(v, std::back_inserter(classifier.near_faces));
+  return classifier.classify(meshset, face_rtree, v, even_odd, mesh, hit_face);
 }
 
 
 
+void carve::mesh::classifyPoints(
+    const carve::mesh::MeshSet<3> *meshset,
+    const carve::geom::FlatRTree<3, carve::mesh::Face<3> *> *face_rtree,
+    const carve::geom::vector<3> *points,
+    size_t n_points,
+    carve::PointClass *result,
+    bool even_odd,
+    const carve::mesh::Mesh<3> *mesh) {
+  // points are classified in groups of this many, consecutive in Morton order.
+  const size_t group_size = 64;
+
+  const carve::geom::aabb<3> face_rtree_bbox = face_rtree->getAABB();
+
+  std::vector<std::pair<uint32_t, size_t> > order;
+  order.reserve(n_points);
+  for (size_t i = 0; i < n_points; ++i) {
+    if (face_rtree_bbox.containsPoint(points[i])) {
+      order.push_back(std::make_pair(mortonCode(face_rtree_bbox, points[i]), i));
+    } else {
+      result[i] = classifyDistantPoint(meshset);
+    }
+  }
+  std::sort(order.begin(), order.end());
+
+  const size_t n_groups = (order.size() + group_size - 1) / group_size;
+  std::vector<std::string> group_error(n_groups);
+  std::vector<char> group_failed(n_groups, 0);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+  {
+    PointClassifier classifier;
+    std::vector<face_rtree_t::index_t> leaves;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for (int g = 0; g < (int)n_groups; ++g) {
+      const size_t lo = g * group_size;
+      const size_t hi = std::min(lo + group_size, order.size());
+
+      try {
+        // find the R-tree leaves around the whole group once; each
+        // point then only needs to test the leaves' bounding boxes.
+        carve::geom::aabb<3> group_box;
+        group_box.fit(points[order[lo].second]);
+        for (size_t i = lo + 1; i < hi; ++i) {
+          group_box.unionAABB(carve::geom::aabb<3>(points[order[i].second]));
+        }
+        group_box.extent += carve::geom::VECTOR(carve::EPSILON, carve::EPSILON, carve::EPSILON);
+
+        leaves.clear();
+        if (face_rtree->getAABB().intersects(group_box)) {
+          collectLeaves(face_rtree, face_rtree->root(), group_box, leaves);
+        }
+
+        for (size_t i = lo; i < hi; ++i) {
+          const carve::geom::vector<3> &v = points[order[i].second];
+          const carve::geom::aabb<3> v_box(v);
+
+          classifier.near_faces.clear();
+          for (size_t j = 0; j < leaves.size(); ++j) {
+            if (face_rtree->bbox(leaves[j]).intersects(v_box)) {
+              classifier.near_faces.insert(classifier.near_faces.end(), face_rtree->begin(leaves[j]), face_rtree->end(leaves[j]));
+            }
+          }
+
+          result[order[i].second] = classifier.classify(meshset, face_rtree, v, even_odd, mesh, NULL);
+        }
+      } catch (carve::exception &e) {
+        group_failed[g] = 1;
+        group_error[g] = e.str();
+      } catch (...) {
+        group_failed[g] = 1;
+        group_error[g] = "unexpected exception in point classification";
+      }
+    }
+  }
+
+  for (size_t g = 0; g < n_groups; ++g) {
+    if (group_failed[g]) throw carve::exception(group_error[g]);
+  }
+}
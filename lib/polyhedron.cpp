@@ -807,16 +807,37 @@ namespace carve {
 
       std::vector<std::pair<const face_t *, carve::geom3d::Vector> > manifold_intersections;
 
-      for (;;) {
-        double a1 = random() / double(RAND_MAX) * M_TWOPI;
-        double a2 = random() / double(RAND_MAX) * M_TWOPI;
+      // the faces near v.
+      std::vector<const face_t *> local_faces;
+      octree.findFacesNear(carve::geom::aabb<3>(v, carve::geom::VECTOR(0.0, 0.0, 0.0)), local_faces);
+
+      carve::geom3d::RayDirections ray_dirs;
 
-        carve::geom3d::Vector ray_dir = carve::geom::VECTOR(sin(a1) * sin(a2), cos(a1) * sin(a2), cos(a2));
+      for (;;) {
+        carve::geom3d::Vector ray_dir = ray_dirs.next();
 
 #if defined(DEBUG_CONTAINS_VERTEX)
         std::cerr << "{testing ray: " << ray_dir << "}" << std::endl;
 #endif
 
+        if (!even_odd) {
+          // a ray that is nearly parallel to a face close to v is
+          // likely to fail below; reject it before searching along the
+          // ray.
+          bool parallel = false;
+          for (size_t i = 0; !parallel && i < local_faces.size(); ++i) {
+            if (manifold_id != -1 && manifold_id != local_faces[i]->manifold_id) continue;
+            if (!manifold_is_closed[local_faces[i]->manifold_id]) continue;
+            parallel = fabs(dot(ray_dir, local_faces[i]->plane_eqn.N)) < EPSILON;
+          }
+          if (parallel) {
+#if defined(DEBUG_CONTAINS_VERTEX)
+            std::cerr << "{rejecting(parallel to local face)}" << std::endl;
+#endif
+            continue;
+          }
+        }
+
         carve::geom3d::Vector v2 = v + ray_dir * ray_len;
 
         bool failed = false;
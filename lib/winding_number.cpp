@@ -0,0 +1,210 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/winding_number.hpp>
+#include <carve/math_constants.hpp>
+
+#include <cmath>
+#include <iterator>
+
+namespace carve {
+  namespace mesh {
+
+    namespace {
+      // The solid angle subtended at the origin by the triangle
+      // (a, b, c) (Van Oosterom and Strackee). Positive when the
+      // origin lies behind the triangle with respect to its
+      // counterclockwise normal.
+      double solidAngle(const carve::geom::vector<3> &a,
+                        const carve::geom::vector<3> &b,
+                        const carve::geom::vector<3> &c) {
+        double la = a.length(), lb = b.length(), lc = c.length();
+        double num = carve::geom::dot(a, carve::geom::cross(b, c));
+        double den =
+          la * lb * lc +
+          carve::geom::dot(a, b) * lc +
+          carve::geom::dot(b, c) * la +
+          carve::geom::dot(c, a) * lb;
+        return 2.0 * atan2(num, den);
+      }
+
+      // The exact solid angle subtended at v by a face, treating
+      // non-triangular faces as a fan about their first vertex.
+      double faceSolidAngle(const Face<3> *face, const carve::geom::vector<3> &v) {
+        const Edge<3> *e = face->edge;
+        carve::geom::vector<3> a = e->vert->v - v;
+        double omega = 0.0;
+        for (e = e->next; e->next != face->edge; e = e->next) {
+          omega += solidAngle(a, e->vert->v - v, e->next->vert->v - v);
+        }
+        return omega;
+      }
+
+      // The summed area vector and area weighted centre of a face.
+      void faceMoments(const Face<3> *face,
+                       carve::geom::vector<3> &normal,
+                       carve::geom::vector<3> &centre,
+                       double &area) {
+        const Edge<3> *e = face->edge;
+        const carve::geom::vector<3> &a = e->vert->v;
+        normal.setZero();
+        centre.setZero();
+        area = 0.0;
+        for (e = e->next; e->next != face->edge; e = e->next) {
+          const carve::geom::vector<3> &b = e->vert->v;
+          const carve::geom::vector<3> &c = e->next->vert->v;
+          carve::geom::vector<3> n = carve::geom::cross(b - a, c - a) / 2.0;
+          double l = n.length();
+          normal += n;
+          centre += (a + b + c) * (l / 3.0);
+          area += l;
+        }
+        if (area > 0.0) {
+          centre /= area;
+        } else {
+          centre = a;
+        }
+      }
+    }
+
+
+
+    void WindingNumber::build(face_rtree_t::index_t node) {
+      carve::geom::vector<3> normal, centre;
+      double area = 0.0;
+
+      normal.setZero();
+      centre.setZero();
+
+      if (!rtree->isLeaf(node)) {
+        for (face_rtree_t::index_t c = rtree->childBegin(node); c != rtree->childEnd(node); ++c) {
+          build(c);
+          // area weighting of child centres uses the magnitude of
+          // the summed normal, which is exact for flat subtrees and
+          // a reasonable approximation elsewhere.
+          double l = nodes[c].normal.length();
+          normal += nodes[c].normal;
+          centre += nodes[c].centre * l;
+          area += l;
+        }
+      } else {
+        for (face_rtree_t::data_iter_t i = rtree->begin(node); i != rtree->end(node); ++i) {
+          const Face<3> *face = *i;
+          if (!included(face)) continue;
+          carve::geom::vector<3> n, c;
+          double l;
+          faceMoments(face, n, c, l);
+          normal += n;
+          centre += c * l;
+          area += l;
+        }
+      }
+
+      const carve::geom::aabb<3> bbox = rtree->bbox(node);
+
+      if (area > 0.0) {
+        centre /= area;
+      } else {
+        centre = bbox.pos;
+      }
+
+      node_data_t &data = nodes[node];
+      data.normal = normal;
+      data.centre = centre;
+      data.radius = (centre - bbox.pos).length() + bbox.extent.length();
+    }
+
+
+
+    double WindingNumber::evaluate(face_rtree_t::index_t node,
+                                   const carve::geom::vector<3> &v) const {
+      const node_data_t &data = nodes[node];
+      carve::geom::vector<3> d = data.centre - v;
+      double dist = d.length();
+
+      if (dist > accuracy * data.radius) {
+        return carve::geom::dot(d, data.normal) / (dist * dist * dist);
+      }
+
+      double omega = 0.0;
+      if (!rtree->isLeaf(node)) {
+        for (face_rtree_t::index_t c = rtree->childBegin(node); c != rtree->childEnd(node); ++c) {
+          omega += evaluate(c, v);
+        }
+      } else {
+        for (face_rtree_t::data_iter_t i = rtree->begin(node); i != rtree->end(node); ++i) {
+          if (!included(*i)) continue;
+          omega += faceSolidAngle(*i, v);
+        }
+      }
+      return omega;
+    }
+
+
+
+    WindingNumber::WindingNumber(const MeshSet<3> *_meshset,
+                                 const face_rtree_t *_rtree,
+                                 const Mesh<3> *_mesh,
+                                 double _accuracy) :
+        meshset(_meshset), rtree(_rtree), mesh(_mesh), accuracy(_accuracy), offset(0.0), nodes() {
+      // match classifyPoint(): the complement of a single negative
+      // mesh contains all distant points.
+      if (mesh != NULL) {
+        if (mesh->isNegative()) offset = 1.0;
+      } else if (meshset->meshes.size() == 1 && meshset->meshes[0]->isNegative()) {
+        offset = 1.0;
+      }
+
+      nodes.resize(rtree->size());
+      build(rtree->root());
+    }
+
+
+
+    double WindingNumber::operator()(const carve::geom::vector<3> &v) const {
+      return offset + evaluate(rtree->root(), v) / (2.0 * M_TWOPI);
+    }
+
+
+
+    carve::PointClass WindingNumber::classify(const carve::geom::vector<3> &v,
+                                              const Face<3> **hit_face) const {
+      if (hit_face) *hit_face = NULL;
+
+      if (rtree->getAABB().containsPoint(v)) {
+        std::vector<Face<3> *> near_faces;
+        rtree->search(v, std::back_inserter(near_faces));
+        for (size_t i = 0; i < near_faces.size(); ++i) {
+          if (!included(near_faces[i])) continue;
+          if (near_faces[i]->containsPoint(v)) {
+            if (hit_face) *hit_face = near_faces[i];
+            return carve::POINT_ON;
+          }
+        }
+      }
+
+      return (*this)(v) > 0.5 ? carve::POINT_IN : carve::POINT_OUT;
+    }
+
+
+
+  }
+}
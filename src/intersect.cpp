@@ -61,6 +61,9 @@ struct Options : public opt::Parser {
 #endif
   bool improve;
   carve::csg::CSG::CLASSIFY_TYPE classifier;
+  carve::csg::CSG::INTERSECTION_KERNEL kernel;
+  carve::csg::CSG::POINT_CLASSIFIER point_classifier;
+  bool pass_through;
 
   std::string stream;
   
@@ -89,6 +92,9 @@ struct Options : public opt::Parser {
 #endif
     if (o == "--improve"      || o == "-i") { improve = true; return; }
     if (o == "--edge"         || o == "-e") { classifier = carve::csg::CSG::CLASSIFY_EDGE; return; }
+    if (o == "--passes"       || o == "-p") { kernel = carve::csg::CSG::INTERSECTION_PASSES; return; }
+    if (o == "--winding"      || o == "-w") { point_classifier = carve::csg::CSG::POINT_CLASSIFIER_WINDING_NUMBER; return; }
+    if (o == "--pass-through" || o == "-u") { pass_through = true; return; }
     if (o == "--epsilon"      || o == "-E") { carve::setEpsilon(strtod(v.c_str(), NULL)); return; }
     if (o == "--help"         || o == "-h") { help(std::cout); exit(0); }
     if (o == "--file"         || o == "-f") {
@@ -162,6 +168,9 @@ struct Options : public opt::Parser {
 #endif
     improve = false;
     classifier = carve::csg::CSG::CLASSIFY_NORMAL;
+    kernel = carve::csg::CSG::INTERSECTION_FUSED;
+    point_classifier = carve::csg::CSG::POINT_CLASSIFIER_RAY;
+    pass_through = false;
 
     option("canonicalize", 'c', false, "Canonicalize before output (for comparing output).");
     option("binary",       'b', false, "Produce binary output.");
@@ -176,6 +185,9 @@ struct Options : public opt::Parser {
 #endif
     option("improve",      'i', false, "Improve triangulation by minimising internal edge lengths.");
     option("edge",         'e', false, "Use edge classifier.");
+    option("passes",       'p', false, "Use separate intersection passes instead of the fused kernel.");
+    option("winding",      'w', false, "Classify points by winding number instead of ray parity.");
+    option("pass-through", 'u', false, "Pass faces untouched by intersections through without splitting.");
     option("epsilon",      'E', true,  "Set epsilon used for calculations.");
     option("file",         'f', true,  "Read CSG expression from file.");
     option("help",         'h', false, "This help message.");
@@ -538,6 +550,9 @@ int main(int argc, char **argv) {
 
     try {
       carve::csg::CSG csg;
+      csg.intersection_kernel = options.kernel;
+      csg.point_classifier = options.point_classifier;
+      csg.pass_through_untouched_faces = options.pass_through;
 
       if (options.triangulate) {
 #if !defined(DISABLE_GLU_TRIANGULATOR)
@@ -24,7 +24,7 @@
 #include <carve/triangle_intersection.hpp>
 #include <carve/poly.hpp>
 #include <carve/mesh.hpp>
-#include <carve/rtree.hpp>
+#include <carve/flat_rtree.hpp>
 #include <carve/geom3d.hpp>
 
 #include <carve/exact.hpp>
@@ -556,7 +556,7 @@ int main(int argc, char **argv) {
     exit(1);
   }
 
-  typedef carve::geom::RTreeNode<3, carve::mesh::Face<3> *> face_rtree_t;
+  typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
   face_rtree_t *tree = face_rtree_t::construct_STR(poly->faceBegin(), poly->faceEnd(), 4, 4);
 
   for (carve::mesh::MeshSet<3>::face_iter f = poly->faceBegin(); f != poly->faceEnd(); ++f) {
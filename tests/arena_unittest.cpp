@@ -0,0 +1,88 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/arena.hpp>
+
+#include <set>
+#include <map>
+
+typedef std::set<int, std::less<int>, carve::arena_allocator<int> > int_set_t;
+
+TEST(ArenaTest, Allocate) {
+  carve::Arena arena(256);
+
+  ASSERT_TRUE(arena.empty());
+
+  char *a = static_cast<char *>(arena.allocate(10, 1));
+  double *b = arena.allocate<double>(4);
+  ASSERT_EQ((size_t)b % sizeof(double), 0U);
+  ASSERT_GE((char *)b, a + 10);
+  ASSERT_EQ(arena.allocated(), 10U + 4 * sizeof(double));
+
+  // allocations larger than the block size get a block of their own.
+  void *c = arena.allocate(1000);
+  ASSERT_TRUE(c != NULL);
+  ASSERT_GE(arena.capacity(), 1000U);
+
+  arena.reserve(5000);
+  size_t cap = arena.capacity();
+  for (int i = 0; i < 50; ++i) arena.allocate(96);
+  ASSERT_EQ(arena.capacity(), cap);
+
+  arena.clear();
+  ASSERT_TRUE(arena.empty());
+  ASSERT_EQ(arena.capacity(), 0U);
+}
+
+TEST(ArenaTest, Allocator) {
+  carve::Arena arena;
+
+  // without a current arena, containers allocate from the heap.
+  ASSERT_TRUE(carve::Arena::current() == NULL);
+  int_set_t heap_set;
+  heap_set.insert(1);
+  ASSERT_TRUE(heap_set.get_allocator().arena == NULL);
+  ASSERT_TRUE(arena.empty());
+
+  {
+    carve::Arena::Scope scope(&arena);
+    ASSERT_EQ(carve::Arena::current(), &arena);
+
+    int_set_t s;
+    for (int i = 0; i < 100; ++i) s.insert(i);
+    ASSERT_EQ(s.get_allocator().arena, &arena);
+    ASSERT_FALSE(arena.empty());
+
+    // nested containers pick up the current arena on construction.
+    std::map<int, int_set_t> m;
+    m[1].insert(2);
+    ASSERT_EQ(m[1].get_allocator().arena, &arena);
+
+    // copies keep the arena of their source.
+    int_set_t copy(heap_set);
+    ASSERT_TRUE(copy.get_allocator().arena == NULL);
+  }
+
+  ASSERT_TRUE(carve::Arena::current() == NULL);
+  arena.clear();
+}
@@ -0,0 +1,345 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/csg_arrangement.hpp>
+#include <carve/csg_session.hpp>
+#include <carve/input.hpp>
+
+#include <iterator>
+#include <memory>
+#include <set>
+
+static carve::mesh::MeshSet<3> *makeCube(const carve::math::Matrix &transform) {
+  carve::input::PolyhedronData data;
+
+  data.addVertex(transform * carve::geom::VECTOR(+1.0, +1.0, +1.0));
+  data.addVertex(transform * carve::geom::VECTOR(-1.0, +1.0, +1.0));
+  data.addVertex(transform * carve::geom::VECTOR(-1.0, -1.0, +1.0));
+  data.addVertex(transform * carve::geom::VECTOR(+1.0, -1.0, +1.0));
+  data.addVertex(transform * carve::geom::VECTOR(+1.0, +1.0, -1.0));
+  data.addVertex(transform * carve::geom::VECTOR(-1.0, +1.0, -1.0));
+  data.addVertex(transform * carve::geom::VECTOR(-1.0, -1.0, -1.0));
+  data.addVertex(transform * carve::geom::VECTOR(+1.0, -1.0, -1.0));
+
+  data.addFace(0, 1, 2, 3);
+  data.addFace(7, 6, 5, 4);
+  data.addFace(0, 4, 5, 1);
+  data.addFace(1, 5, 6, 2);
+  data.addFace(2, 6, 7, 3);
+  data.addFace(3, 7, 4, 0);
+
+  return new carve::mesh::MeshSet<3>(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+static double volume(const carve::mesh::MeshSet<3> *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) v += m->meshes[i]->volume();
+  return v;
+}
+
+TEST(CSGTest, PreparedMeshSet) {
+  std::auto_ptr<carve::mesh::MeshSet<3> > a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<carve::mesh::MeshSet<3> > b(makeCube(carve::math::Matrix::TRANS(1.0, 1.0, 1.0)));
+
+  carve::csg::PreparedMeshSet prepared_b(b.get());
+
+  ASSERT_EQ(prepared_b.getMeshSet(), b.get());
+  ASSERT_TRUE(prepared_b.isClosed());
+  std::vector<carve::mesh::Face<3> *> faces;
+  prepared_b.getRTree()->search(prepared_b.getAABB(), std::back_inserter(faces));
+  ASSERT_EQ(faces.size(), 6U);
+  ASSERT_NEAR(prepared_b.getAABB().min().x, 0.0, 1e-12);
+  ASSERT_NEAR(prepared_b.getAABB().max().x, 2.0, 1e-12);
+
+  carve::csg::CSG csg;
+  std::auto_ptr<carve::mesh::MeshSet<3> > plain(csg.compute(a.get(), b.get(), carve::csg::CSG::A_MINUS_B));
+
+  // the prepared operand can be reused across operations.
+  for (int i = 0; i < 3; ++i) {
+    std::auto_ptr<carve::mesh::MeshSet<3> > prepared(csg.compute(a.get(), prepared_b, carve::csg::CSG::A_MINUS_B));
+    ASSERT_NEAR(volume(prepared.get()), volume(plain.get()), 1e-9);
+    ASSERT_NEAR(volume(prepared.get()), 7.0, 1e-9);
+  }
+}
+
+TEST(CSGTest, DisjointMeshes) {
+  std::auto_ptr<carve::mesh::MeshSet<3> > cube_1(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<carve::mesh::MeshSet<3> > cube_2(makeCube(carve::math::Matrix::TRANS(10.0, 0.0, 0.0)));
+  std::auto_ptr<carve::mesh::MeshSet<3> > touching(makeCube(carve::math::Matrix::TRANS(1.0, 1.0, 1.0)));
+  std::auto_ptr<carve::mesh::MeshSet<3> > nested(makeCube(carve::math::Matrix::TRANS(10.0, 0.0, 0.0) *
+                                                          carve::math::Matrix::SCALE(0.5, 0.5, 0.5)));
+
+  carve::csg::CSG csg;
+
+  // operands with disjoint bounding boxes.
+  std::auto_ptr<carve::mesh::MeshSet<3> > a(csg.compute(cube_1.get(), cube_2.get(), carve::csg::CSG::UNION));
+  ASSERT_EQ(a->meshes.size(), 2U);
+  ASSERT_NEAR(volume(a.get()), 16.0, 1e-9);
+  std::auto_ptr<carve::mesh::MeshSet<3> > none(csg.compute(cube_1.get(), cube_2.get(), carve::csg::CSG::INTERSECTION));
+  ASSERT_EQ(none->meshes.size(), 0U);
+
+  // only the first mesh of a touches the second operand.
+  std::auto_ptr<carve::mesh::MeshSet<3> > a_minus_b(csg.compute(a.get(), touching.get(), carve::csg::CSG::A_MINUS_B));
+  ASSERT_EQ(a_minus_b->meshes.size(), 2U);
+  ASSERT_NEAR(volume(a_minus_b.get()), 15.0, 1e-9);
+  std::auto_ptr<carve::mesh::MeshSet<3> > a_and_b(csg.compute(a.get(), touching.get(), carve::csg::CSG::INTERSECTION));
+  ASSERT_EQ(a_and_b->meshes.size(), 1U);
+  ASSERT_NEAR(volume(a_and_b.get()), 1.0, 1e-9);
+  std::auto_ptr<carve::mesh::MeshSet<3> > a_or_b(csg.compute(a.get(), touching.get(), carve::csg::CSG::UNION));
+  ASSERT_EQ(a_or_b->meshes.size(), 2U);
+  ASSERT_NEAR(volume(a_or_b.get()), 23.0, 1e-9);
+
+  // a mesh that touches nothing, but lies inside the other operand.
+  std::auto_ptr<carve::mesh::MeshSet<3> > inside(csg.compute(a.get(), nested.get(), carve::csg::CSG::INTERSECTION));
+  ASSERT_EQ(inside->meshes.size(), 1U);
+  ASSERT_NEAR(volume(inside.get()), 1.0, 1e-9);
+  std::auto_ptr<carve::mesh::MeshSet<3> > outside(csg.compute(a.get(), nested.get(), carve::csg::CSG::UNION));
+  ASSERT_EQ(outside->meshes.size(), 2U);
+  ASSERT_NEAR(volume(outside.get()), 16.0, 1e-9);
+}
+
+TEST(CSGTest, PassThroughUntouchedFaces) {
+  std::auto_ptr<carve::mesh::MeshSet<3> > a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<carve::mesh::MeshSet<3> > b(makeCube(carve::math::Matrix::TRANS(1.0, 1.0, 1.0) *
+                                                     carve::math::Matrix::SCALE(0.5, 0.5, 0.5)));
+
+  const carve::csg::CSG::OP ops[] = {
+    carve::csg::CSG::UNION,
+    carve::csg::CSG::INTERSECTION,
+    carve::csg::CSG::A_MINUS_B,
+    carve::csg::CSG::B_MINUS_A,
+    carve::csg::CSG::SYMMETRIC_DIFFERENCE
+  };
+
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    carve::csg::CSG csg;
+    std::auto_ptr<carve::mesh::MeshSet<3> > full(csg.compute(a.get(), b.get(), ops[i]));
+    csg.pass_through_untouched_faces = true;
+    std::auto_ptr<carve::mesh::MeshSet<3> > pass_through(csg.compute(a.get(), b.get(), ops[i]));
+
+    ASSERT_EQ(std::distance(pass_through->faceBegin(), pass_through->faceEnd()),
+              std::distance(full->faceBegin(), full->faceEnd()));
+    ASSERT_EQ(pass_through->meshes.size(), full->meshes.size());
+    ASSERT_NEAR(volume(pass_through.get()), volume(full.get()), 1e-9);
+  }
+}
+
+TEST(CSGTest, SubtractionSession) {
+  std::auto_ptr<carve::mesh::MeshSet<3> > stock(makeCube(carve::math::Matrix::IDENT()));
+  carve::csg::SubtractionSession session(stock.get());
+
+  carve::csg::CSG csg;
+  std::auto_ptr<carve::mesh::MeshSet<3> > expected(stock->clone());
+
+  // small tools, rotated to avoid coplanar faces, that cut corners,
+  // edges and faces of the stock, cut through earlier cuts, miss the
+  // stock and lie inside it.
+  unsigned seed = 1;
+  for (int i = 0; i < 40; ++i) {
+    double r[7];
+    for (int j = 0; j < 7; ++j) {
+      seed = seed * 1103515245U + 12345U;
+      r[j] = ((seed >> 8) & 0xffff) / 65536.0;
+    }
+    const double scale = 0.1 + 0.2 * r[6];
+    carve::math::Matrix transform =
+      carve::math::Matrix::TRANS(2.6 * r[0] - 1.3, 2.6 * r[1] - 1.3, 2.6 * r[2] - 1.3) *
+      carve::math::Matrix::ROT(0.3 + 2.0 * r[3], 1.0, r[4], r[5]) *
+      carve::math::Matrix::SCALE(scale, scale, scale);
+    if (i == 0) transform = carve::math::Matrix::TRANS(0.1, 0.2, 0.3) * carve::math::Matrix::SCALE(0.3, 0.3, 0.3);
+    if (i == 1) transform = carve::math::Matrix::TRANS(5.0, 0.0, 0.0) * carve::math::Matrix::SCALE(0.3, 0.3, 0.3);
+
+    std::auto_ptr<carve::mesh::MeshSet<3> > tool(makeCube(transform));
+
+    session.subtract(tool.get());
+    expected.reset(csg.compute(expected.get(), tool.get(), carve::csg::CSG::A_MINUS_B));
+
+    std::auto_ptr<carve::mesh::MeshSet<3> > result(session.result());
+    ASSERT_TRUE(result->isClosed());
+    ASSERT_EQ(result->meshes.size(), expected->meshes.size());
+    ASSERT_NEAR(volume(result.get()), volume(expected.get()), 1e-9);
+  }
+
+  // the stock is unchanged by a tool that misses it, and by one that
+  // lies inside a cavity.
+  ASSERT_FALSE(session.subtract(std::auto_ptr<carve::mesh::MeshSet<3> >(makeCube(carve::math::Matrix::TRANS(0.0, 4.0, 0.0))).get()));
+  ASSERT_FALSE(session.subtract(std::auto_ptr<carve::mesh::MeshSet<3> >(makeCube(carve::math::Matrix::TRANS(0.1, 0.2, 0.3) *
+                                                                                 carve::math::Matrix::SCALE(0.1, 0.1, 0.1))).get()));
+
+  // a slab severed from the stock by one tool, and then enclosed by
+  // another, is removed.
+  std::auto_ptr<carve::mesh::MeshSet<3> > severing(makeCube(carve::math::Matrix::TRANS(0.55, 0.0, 0.0) *
+                                                            carve::math::Matrix::SCALE(0.05, 2.0, 2.0)));
+  std::auto_ptr<carve::mesh::MeshSet<3> > enclosing(makeCube(carve::math::Matrix::TRANS(0.85, 0.0, 0.0) *
+                                                             carve::math::Matrix::SCALE(0.28, 1.5, 1.5)));
+  ASSERT_TRUE(session.subtract(severing.get()));
+  expected.reset(csg.compute(expected.get(), severing.get(), carve::csg::CSG::A_MINUS_B));
+  ASSERT_TRUE(session.subtract(enclosing.get()));
+  expected.reset(csg.compute(expected.get(), enclosing.get(), carve::csg::CSG::A_MINUS_B));
+
+  std::auto_ptr<carve::mesh::MeshSet<3> > result(session.result());
+  ASSERT_TRUE(result->isClosed());
+  ASSERT_EQ(result->meshes.size(), expected->meshes.size());
+  ASSERT_NEAR(volume(result.get()), volume(expected.get()), 1e-9);
+
+  // a component of the stock enclosed by a tool is removed.
+  std::auto_ptr<carve::mesh::MeshSet<3> > a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<carve::mesh::MeshSet<3> > b(makeCube(carve::math::Matrix::TRANS(4.0, 0.0, 0.0)));
+  std::auto_ptr<carve::mesh::MeshSet<3> > pair(csg.compute(a.get(), b.get(), carve::csg::CSG::UNION));
+  carve::csg::SubtractionSession pair_session(pair.get());
+  ASSERT_TRUE(pair_session.subtract(std::auto_ptr<carve::mesh::MeshSet<3> >(makeCube(carve::math::Matrix::TRANS(4.0, 0.0, 0.0) *
+                                                                                      carve::math::Matrix::SCALE(1.5, 1.5, 1.5))).get()));
+  result.reset(pair_session.result());
+  ASSERT_TRUE(result->isClosed());
+  ASSERT_EQ(result->meshes.size(), 1U);
+  ASSERT_NEAR(volume(result.get()), 8.0, 1e-9);
+}
+
+// records the operands from which result faces were taken.
+struct ResultFaceHook : public carve::csg::CSG::Hook {
+  std::set<const carve::mesh::MeshSet<3> *> sources;
+  size_t n_faces;
+
+  ResultFaceHook() : sources(), n_faces(0) { }
+
+  virtual void resultFace(const carve::mesh::MeshSet<3>::face_t * /* new_face */,
+                          const carve::mesh::MeshSet<3>::face_t *orig_face,
+                          bool /* flipped */) {
+    sources.insert(orig_face->mesh->meshset);
+    ++n_faces;
+  }
+};
+
+TEST(CSGTest, ComputeUnion) {
+  // a chain of overlapping cubes, a cube inside one of them, and
+  // cubes that overlap nothing.
+  std::vector<carve::mesh::MeshSet<3> *> operands;
+  for (int i = 0; i < 7; ++i) {
+    operands.push_back(makeCube(carve::math::Matrix::TRANS(1.5 * i, 0.1 * i, 0.0) *
+                                carve::math::Matrix::ROT(0.2 + 0.1 * i, 1.0, 0.5, 0.3)));
+  }
+  operands.push_back(makeCube(carve::math::Matrix::TRANS(3.0, 0.3, 0.0) * carve::math::Matrix::SCALE(0.2, 0.2, 0.2)));
+  for (int i = 0; i < 3; ++i) {
+    operands.push_back(makeCube(carve::math::Matrix::TRANS(5.0 * i, 10.0, 0.0)));
+  }
+
+  carve::csg::CSG csg;
+  std::auto_ptr<carve::mesh::MeshSet<3> > expected(operands[0]->clone());
+  for (size_t i = 1; i < operands.size(); ++i) {
+    expected.reset(csg.compute(expected.get(), operands[i], carve::csg::CSG::UNION));
+  }
+
+  std::auto_ptr<carve::mesh::MeshSet<3> > result(csg.computeUnion(operands));
+  ASSERT_TRUE(result->isClosed());
+  ASSERT_EQ(result->meshes.size(), 4U);
+  ASSERT_EQ(result->meshes.size(), expected->meshes.size());
+  ASSERT_NEAR(volume(result.get()), volume(expected.get()), 1e-9);
+
+  // the cubes that overlap nothing are not passed to compute().
+  carve::csg::CSG hooked;
+  ResultFaceHook *hook = new ResultFaceHook;
+  hooked.hooks.registerHook(hook, carve::csg::CSG::Hooks::RESULT_FACE_BIT);
+  result.reset(hooked.computeUnion(operands));
+  ASSERT_EQ(result->meshes.size(), 4U);
+  ASSERT_NEAR(volume(result.get()), volume(expected.get()), 1e-9);
+  ASSERT_GT(hook->n_faces, 0U);
+  for (size_t i = 8; i < operands.size(); ++i) {
+    ASSERT_EQ(hook->sources.count(operands[i]), 0U);
+  }
+
+  // a grid of cubes that overlap nothing, many of which share the
+  // leaves of the tree used to find overlaps, is not passed to
+  // compute() at all.
+  std::vector<carve::mesh::MeshSet<3> *> grid;
+  for (int i = 0; i < 27; ++i) {
+    grid.push_back(makeCube(carve::math::Matrix::TRANS(3.0 * (i % 3), 3.0 * (i / 3 % 3), 3.0 * (i / 9))));
+  }
+  hook->n_faces = 0;
+  result.reset(hooked.computeUnion(grid));
+  ASSERT_EQ(hook->n_faces, 0U);
+  ASSERT_TRUE(result->isClosed());
+  ASSERT_EQ(result->meshes.size(), 27U);
+  ASSERT_NEAR(volume(result.get()), 27.0 * 8.0, 1e-9);
+  for (size_t i = 0; i < grid.size(); ++i) delete grid[i];
+
+  // a single operand is copied.
+  std::vector<carve::mesh::MeshSet<3> *> single(1, operands[0]);
+  result.reset(csg.computeUnion(single));
+  ASSERT_NE(result.get(), operands[0]);
+  ASSERT_NEAR(volume(result.get()), 8.0, 1e-9);
+
+  result.reset(csg.computeUnion(std::vector<carve::mesh::MeshSet<3> *>()));
+  ASSERT_EQ(result->meshes.size(), 0U);
+
+  for (size_t i = 0; i < operands.size(); ++i) delete operands[i];
+}
+
+struct UnionSelector : public carve::csg::Arrangement::Selector {
+  virtual bool select(carve::csg::Arrangement::mask_t region) const { return region != 0; }
+};
+
+TEST(CSGTest, Arrangement) {
+  // three cubes meeting at triple points, and one whose faces
+  // coincide with faces of the first.
+  std::vector<carve::mesh::MeshSet<3> *> operands;
+  operands.push_back(makeCube(carve::math::Matrix::IDENT()));
+  operands.push_back(makeCube(carve::math::Matrix::TRANS(1.0, 0.3, 0.2) * carve::math::Matrix::ROT(0.4, 1.0, 0.3, 0.2)));
+  operands.push_back(makeCube(carve::math::Matrix::TRANS(0.4, 1.1, 0.5) * carve::math::Matrix::ROT(0.7, 0.2, 1.0, 0.5)));
+  operands.push_back(makeCube(carve::math::Matrix::TRANS(0.0, -1.0, 0.5) * carve::math::Matrix::SCALE(0.5, 0.5, 0.5)));
+
+  carve::csg::Arrangement arrangement(operands);
+  ASSERT_EQ(arrangement.operandCount(), operands.size());
+
+  // each region is the intersection of the operands that contain it,
+  // less the others.
+  carve::csg::CSG csg;
+  for (unsigned region = 1; region < (1U << operands.size()); ++region) {
+    std::auto_ptr<carve::mesh::MeshSet<3> > expected;
+    for (size_t i = 0; i < operands.size(); ++i) {
+      if (!(region & (1U << i))) continue;
+      if (expected.get() == NULL) {
+        expected.reset(operands[i]->clone());
+      } else {
+        expected.reset(csg.compute(expected.get(), operands[i], carve::csg::CSG::INTERSECTION));
+      }
+    }
+    for (size_t i = 0; i < operands.size(); ++i) {
+      if (region & (1U << i)) continue;
+      expected.reset(csg.compute(expected.get(), operands[i], carve::csg::CSG::A_MINUS_B));
+    }
+
+    std::auto_ptr<carve::mesh::MeshSet<3> > result(arrangement.collect((carve::csg::Arrangement::mask_t)region));
+    ASSERT_TRUE(result->isClosed());
+    ASSERT_EQ(result->meshes.size(), expected->meshes.size());
+    ASSERT_NEAR(volume(result.get()), volume(expected.get()), 1e-9);
+  }
+
+  std::auto_ptr<carve::mesh::MeshSet<3> > expected(csg.computeUnion(operands));
+  std::auto_ptr<carve::mesh::MeshSet<3> > result(arrangement.collect(UnionSelector()));
+  ASSERT_TRUE(result->isClosed());
+  ASSERT_EQ(result->meshes.size(), expected->meshes.size());
+  ASSERT_NEAR(volume(result.get()), volume(expected.get()), 1e-9);
+
+  for (size_t i = 0; i < operands.size(); ++i) delete operands[i];
+}
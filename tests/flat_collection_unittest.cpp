@@ -0,0 +1,123 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/flat_collection.hpp>
+
+#include <set>
+#include <map>
+#include <vector>
+
+#include "mersenne_twister.h"
+
+TEST(FlatCollectionTest, SmallSet) {
+  MTRand rand(1);
+  carve::small_set<int> s;
+  std::set<int> ref;
+
+  for (int i = 0; i < 1000; ++i) {
+    int v = rand.randInt(200);
+    ASSERT_EQ(s.insert(v).second, ref.insert(v).second);
+  }
+  for (int i = 0; i < 300; ++i) {
+    int v = rand.randInt(200);
+    ASSERT_EQ(s.erase(v), ref.erase(v));
+  }
+
+  ASSERT_EQ(s.size(), ref.size());
+  ASSERT_TRUE(std::equal(s.begin(), s.end(), ref.begin()));
+  for (int v = 0; v < 200; ++v) {
+    ASSERT_EQ(s.count(v), ref.count(v));
+  }
+
+  // range insertion merges and removes duplicates.
+  std::vector<int> more;
+  for (int i = 0; i < 100; ++i) more.push_back(rand.randInt(300));
+  s.insert(more.begin(), more.end());
+  ref.insert(more.begin(), more.end());
+  ASSERT_EQ(s.size(), ref.size());
+  ASSERT_TRUE(std::equal(s.begin(), s.end(), ref.begin()));
+}
+
+TEST(FlatCollectionTest, SmallMap) {
+  carve::small_map<int, int> m;
+  for (int i = 10; i > 0; --i) m[i] = i * i;
+  ASSERT_EQ(m.size(), 10U);
+  ASSERT_EQ(m.begin()->first, 1);
+  ASSERT_EQ(m.find(4)->second, 16);
+  ASSERT_TRUE(m.find(11) == m.end());
+  ASSERT_FALSE(m.insert(std::make_pair(4, 0)).second);
+  ASSERT_EQ(m.erase(4), 1U);
+  ASSERT_EQ(m.count(4), 0U);
+}
+
+TEST(FlatCollectionTest, FlatHashMap) {
+  MTRand rand(2);
+  carve::flat_hash_map<int, std::vector<int> > m;
+  std::map<int, std::vector<int> > ref;
+
+  for (int i = 0; i < 20000; ++i) {
+    int k = rand.randInt(5000);
+    switch (rand.randInt(3)) {
+    case 0:
+    case 1:
+      m[k].push_back(i);
+      ref[k].push_back(i);
+      break;
+    case 2:
+      ASSERT_EQ(m.erase(k), ref.erase(k));
+      break;
+    case 3:
+      ASSERT_EQ(m.count(k), ref.count(k));
+      break;
+    }
+  }
+
+  ASSERT_EQ(m.size(), ref.size());
+  size_t n = 0;
+  for (carve::flat_hash_map<int, std::vector<int> >::const_iterator i = m.begin(); i != m.end(); ++i, ++n) {
+    ASSERT_TRUE(ref[i->first] == i->second);
+  }
+  ASSERT_EQ(n, ref.size());
+
+  carve::flat_hash_map<int, std::vector<int> > copy(m);
+  ASSERT_EQ(copy.size(), m.size());
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_TRUE(m.find(ref.begin()->first) == m.end());
+  ASSERT_TRUE(copy.find(ref.begin()->first)->second == ref.begin()->second);
+}
+
+TEST(FlatCollectionTest, FlatHashMapErase) {
+  int values[100];
+  carve::flat_hash_map<int *, int> m;
+  for (int i = 0; i < 100; ++i) m[values + i] = i;
+
+  // references to other elements survive erasure.
+  int &r = m[values + 50];
+  for (int i = 0; i < 100; ++i) {
+    if (i != 50) m.erase(values + i);
+  }
+  ASSERT_EQ(m.size(), 1U);
+  ASSERT_EQ(&r, &m[values + 50]);
+  ASSERT_EQ(r, 50);
+}
@@ -139,3 +139,30 @@ TEST(GeomTest, Geom2D) {
             VECTOR(1119.40699999999992542143,213544.662000000011175871),
             VECTOR(1120.40699999999992542143,213543.469000000011874363))), false);
 }
+
+TEST(GeomTest, PointInTriangle) {
+  P2vec tris[2];
+  tris[0] = TRI(VECTOR(0,0), VECTOR(1,0), VECTOR(.25,1));
+  tris[1] = TRI(VECTOR(0,0), VECTOR(.25,1), VECTOR(1,0));
+
+  for (size_t t = 0; t < 2; ++t) {
+    const P2vec &tri = tris[t];
+    for (int i = -4; i <= 44; ++i) {
+      for (int j = -4; j <= 44; ++j) {
+        P2 p = VECTOR(i / 40.0, j / 40.0);
+        PolyInclusionInfo a = pointInPoly(tri, p);
+        PolyInclusionInfo b = pointInTriangle(&tri[0], p);
+        ASSERT_EQ(a.iclass, b.iclass);
+        ASSERT_EQ(a.iobjnum, b.iobjnum);
+        if (a.iclass == carve::POINT_IN || a.iclass == carve::POINT_OUT) {
+          ASSERT_EQ(pointInPolySimple(tri, p), pointInTriangleSimple(&tri[0], p));
+        }
+      }
+    }
+  }
+
+  // degenerate triangles are classified as polygons.
+  P2vec line = TRI(VECTOR(0,0), VECTOR(1,1), VECTOR(2,2));
+  ASSERT_EQ(pointInPolySimple(line, VECTOR(1,0)), pointInTriangleSimple(&line[0], VECTOR(1,0)));
+  ASSERT_EQ(pointInPoly(line, VECTOR(.5,.5)).iclass, pointInTriangle(&line[0], VECTOR(.5,.5)).iclass);
+}
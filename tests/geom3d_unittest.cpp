@@ -25,12 +25,18 @@
 #include <carve/geom2d.hpp>
 #include <carve/geom3d.hpp>
 #include <carve/matrix.hpp>
+#include <carve/packed_aabb.hpp>
+#include <carve/flat_rtree.hpp>
 
 using namespace carve::geom;
 using namespace carve::geom3d;
 
 #include BOOST_INCLUDE(random.hpp)
 
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
 uint32_t getseed() {
 #if defined(__APPLE__)
   srandomdev();
@@ -175,3 +181,366 @@ TEST(GeomTest, Geom3D) {
   }
 }
 
+TEST(GeomTest, PackedAABB) {
+  // boxes on a coarse grid, so that many of them just touch.
+  std::vector<aabb<3> > boxes;
+  for (int i = 0; i < 23; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(i % 3 * 0.1, i / 3 % 3 * 0.1, i / 9 * 0.1),
+                            VECTOR(0.05 + i % 2 * 0.05, 0.05, 0.1)));
+  }
+
+  packed_aabb<3> packed;
+  packed.resize(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i) packed.set(i, boxes[i]);
+
+  ASSERT_EQ(boxes.size(), packed.size());
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    ASSERT_EQ(boxes[i].pos, packed.get(i).pos);
+    ASSERT_EQ(boxes[i].extent, packed.get(i).extent);
+  }
+
+  for (int q = 0; q < 64; ++q) {
+    aabb<3> query(VECTOR(q % 4 * 0.1, q / 4 % 4 * 0.1, q / 16 * 0.1), VECTOR(0.05, 0.05, 0.05));
+    for (size_t b = 0; b < packed.blocks(); ++b) {
+      unsigned m1 = packed.intersectsBlock(b, query);
+      unsigned m2 = packed.intersectsBlock(b, query, true);
+      for (size_t i = 0; i < packed_aabb<3>::WIDTH; ++i) {
+        size_t j = b * packed_aabb<3>::WIDTH + i;
+        bool e1 = j < boxes.size() && boxes[j].intersects(query);
+        bool e2 = j < boxes.size() && query.intersects(boxes[j]);
+        ASSERT_EQ(e1, (m1 & (1U << i)) != 0);
+        ASSERT_EQ(e2, (m2 & (1U << i)) != 0);
+        if (j < boxes.size()) {
+          ASSERT_EQ(e1, packed.intersects(j, query));
+          ASSERT_EQ(e2, packed.intersects(j, query, true));
+        }
+      }
+    }
+  }
+}
+
+TEST(GeomTest, FlatRTree) {
+  typedef RTreeNode<3, const aabb<3> *> rtree_t;
+  typedef FlatRTree<3, const aabb<3> *> flat_rtree_t;
+
+  std::vector<aabb<3> > boxes;
+  for (int i = 0; i < 1000; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(i % 10 * 0.1, i / 10 % 10 * 0.1, i / 100 * 0.1),
+                            VECTOR(0.03 + i % 7 * 0.01, 0.05, 0.04 + i % 3 * 0.01)));
+  }
+  std::vector<const aabb<3> *> ptrs;
+  for (size_t i = 0; i < boxes.size(); ++i) ptrs.push_back(&boxes[i]);
+
+  rtree_t *tree = rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+  flat_rtree_t *flat = flat_rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+
+  ASSERT_EQ(tree->bbox, flat->getAABB());
+
+  for (int q = 0; q < 125; ++q) {
+    aabb<3> query(VECTOR(q % 5 * 0.25, q / 5 % 5 * 0.25, q / 25 * 0.25), VECTOR(0.1, 0.15, 0.05));
+    std::vector<const aabb<3> *> r1, r2, r3;
+    tree->search(query, std::back_inserter(r1));
+    flat->search(query, std::back_inserter(r2));
+    // the generic search, which tests each child in turn.
+    flat->search(linesegment<3>(query.min(), query.max()), std::back_inserter(r3));
+    ASSERT_TRUE(r1 == r2);
+    std::vector<const aabb<3> *> r4;
+    tree->search(linesegment<3>(query.min(), query.max()), std::back_inserter(r4));
+    ASSERT_TRUE(r3 == r4);
+  }
+
+  for (size_t i = 0; i < boxes.size(); i += 3) {
+    ASSERT_TRUE(tree->remove(ptrs[i], boxes[i]));
+    ASSERT_TRUE(flat->remove(ptrs[i], boxes[i]));
+  }
+  ASSERT_FALSE(flat->remove(ptrs[0], boxes[0]));
+  for (size_t i = 1; i < boxes.size(); i += 3) {
+    boxes[i].pos.x += 0.01;
+    tree->updateExtents(boxes[i]);
+    flat->updateExtents(boxes[i]);
+  }
+
+  ASSERT_EQ(tree->bbox, flat->getAABB());
+  for (int q = 0; q < 125; ++q) {
+    aabb<3> query(VECTOR(q % 5 * 0.25, q / 5 % 5 * 0.25, q / 25 * 0.25), VECTOR(0.1, 0.15, 0.05));
+    std::vector<const aabb<3> *> r1, r2;
+    tree->search(query, std::back_inserter(r1));
+    flat->search(query, std::back_inserter(r2));
+    ASSERT_TRUE(r1 == r2);
+  }
+
+  // emptied leaves do not contribute to the boxes of their parents.
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    if (i % 3 == 0 || i / 100 >= 5) continue;
+    ASSERT_TRUE(tree->remove(ptrs[i], boxes[i]));
+    ASSERT_TRUE(flat->remove(ptrs[i], boxes[i]));
+  }
+  ASSERT_EQ(tree->bbox, flat->getAABB());
+  ASSERT_GT(flat->getAABB().min().z, 0.4);
+
+  delete tree;
+  delete flat;
+}
+
+// the boxes and data of a tree, in depth first order.
+template<typename node_t>
+static void treeShape(const node_t *node, std::vector<aabb<3> > &boxes, std::vector<const aabb<3> *> &data) {
+  boxes.push_back(node->bbox);
+  if (node->child) {
+    for (const node_t *c = node->child; c; c = c->sibling) treeShape(c, boxes, data);
+  } else {
+    data.insert(data.end(), node->data.begin(), node->data.end());
+  }
+}
+
+TEST(GeomTest, RTreeParallelBuild) {
+  typedef RTreeNode<3, const aabb<3> *> rtree_t;
+  typedef FlatRTree<3, const aabb<3> *> flat_rtree_t;
+
+  // enough boxes for construction to be split between threads, many
+  // of them with equal midpoints.
+  std::vector<aabb<3> > boxes;
+  for (int i = 0; i < 40000; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(i % 37 * 0.1, i / 37 % 31 * 0.1, i / 1147 * 0.1),
+                            VECTOR(0.03 + i % 7 * 0.01, 0.05, 0.04 + i % 3 * 0.01)));
+  }
+  std::vector<const aabb<3> *> ptrs;
+  for (size_t i = 0; i < boxes.size(); ++i) ptrs.push_back(&boxes[i]);
+
+  std::vector<aabb<3> > str_boxes[2], tgs_boxes[2];
+  std::vector<const aabb<3> *> str_data[2], tgs_data[2], flat_data[2];
+
+  for (int pass = 0; pass < 2; ++pass) {
+#if defined(_OPENMP)
+    omp_set_num_threads(pass ? 4 : 1);
+#endif
+    rtree_t *str = rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+    treeShape(str, str_boxes[pass], str_data[pass]);
+    delete str;
+
+    rtree_t *tgs = rtree_t::construct_TGS(ptrs.begin(), ptrs.end(), 8, 8);
+    treeShape(tgs, tgs_boxes[pass], tgs_data[pass]);
+    delete tgs;
+
+    flat_rtree_t *flat = flat_rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+    flat->search(flat->getAABB(), std::back_inserter(flat_data[pass]));
+    delete flat;
+  }
+
+  ASSERT_EQ(boxes.size(), str_data[0].size());
+  ASSERT_EQ(boxes.size(), tgs_data[0].size());
+  ASSERT_TRUE(str_boxes[0] == str_boxes[1]);
+  ASSERT_TRUE(str_data[0] == str_data[1]);
+  ASSERT_TRUE(tgs_boxes[0] == tgs_boxes[1]);
+  ASSERT_TRUE(tgs_data[0] == tgs_data[1]);
+  ASSERT_TRUE(flat_data[0] == flat_data[1]);
+  ASSERT_TRUE(flat_data[0] == str_data[0]);
+
+  std::vector<const aabb<3> *> sorted(tgs_data[0]);
+  std::sort(sorted.begin(), sorted.end());
+  std::sort(ptrs.begin(), ptrs.end());
+  ASSERT_TRUE(sorted == ptrs);
+}
+
+// check the structure of a tree, and count its data.
+template<typename node_t>
+static size_t checkTree(const node_t *node, size_t leaf_size, size_t internal_size) {
+  if (!node->child) {
+    EXPECT_GE(leaf_size, node->data.size());
+    for (size_t i = 0; i < node->data.size(); ++i) {
+      EXPECT_TRUE(node->bbox.intersects(*node->data[i]));
+    }
+    return node->data.size();
+  }
+  size_t n_children = 0, n_data = 0;
+  for (const node_t *c = node->child; c; c = c->sibling) {
+    ++n_children;
+    EXPECT_TRUE(node->bbox.intersects(c->bbox));
+    n_data += checkTree(c, leaf_size, internal_size);
+  }
+  EXPECT_LE(2U, n_children);
+  EXPECT_GE(internal_size, n_children);
+  return n_data;
+}
+
+TEST(GeomTest, RTreeSAH) {
+  typedef RTreeNode<3, const aabb<3> *> rtree_t;
+  typedef FlatRTree<3, const aabb<3> *> flat_rtree_t;
+
+  // long thin boxes along x, and a cluster of coincident boxes.
+  std::vector<aabb<3> > boxes;
+  for (int i = 0; i < 20000; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(i % 3 * 2.0, i / 3 % 100 * 0.01, i / 300 * 0.01),
+                            VECTOR(1.0, 0.004, 0.004)));
+  }
+  for (int i = 0; i < 100; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(1, 1, 1), VECTOR(0.1, 0.1, 0.1)));
+  }
+  std::vector<const aabb<3> *> ptrs;
+  for (size_t i = 0; i < boxes.size(); ++i) ptrs.push_back(&boxes[i]);
+
+  std::vector<aabb<3> > shape[2];
+  std::vector<const aabb<3> *> data[2];
+  for (int pass = 0; pass < 2; ++pass) {
+#if defined(_OPENMP)
+    omp_set_num_threads(pass ? 4 : 1);
+#endif
+    rtree_t *sah = rtree_t::construct_SAH(ptrs.begin(), ptrs.end(), 6, 4);
+    ASSERT_EQ(boxes.size(), checkTree(sah, 6, 4));
+    treeShape(sah, shape[pass], data[pass]);
+
+    // flattening preserves the order of search results.
+    flat_rtree_t *flat = flat_rtree_t::flatten(sah);
+    for (int q = 0; q < 64; ++q) {
+      aabb<3> query(VECTOR(q % 4 * 1.5, q / 4 % 4 * 0.3, q / 16 * 0.3), VECTOR(0.5, 0.1, 0.1));
+      std::vector<const aabb<3> *> r1, r2;
+      sah->search(query, std::back_inserter(r1));
+      flat->search(query, std::back_inserter(r2));
+      ASSERT_TRUE(r1 == r2);
+    }
+    delete flat;
+    delete sah;
+  }
+  ASSERT_TRUE(shape[0] == shape[1]);
+  ASSERT_TRUE(data[0] == data[1]);
+
+  rtree_t *str = rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+  flat_rtree_t *flat_str = flat_rtree_t::flatten(str);
+  flat_rtree_t *flat = flat_rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+  std::vector<const aabb<3> *> r1, r2;
+  flat_str->search(flat_str->getAABB(), std::back_inserter(r1));
+  flat->search(flat->getAABB(), std::back_inserter(r2));
+  ASSERT_TRUE(r1 == r2);
+  delete flat;
+  delete flat_str;
+  delete str;
+}
+
+// check that the box of each node tightly bounds its children or
+// data, that no node is empty, and return the depth of its leaves,
+// which must all be equal.
+template<typename node_t>
+static int checkFit(const node_t *node) {
+  std::vector<aabb<3> > inner;
+  int depth = -1;
+  if (node->child) {
+    for (const node_t *c = node->child; c; c = c->sibling) {
+      inner.push_back(c->bbox);
+      const int d = checkFit(c);
+      EXPECT_TRUE(depth == -1 || depth == d);
+      depth = d;
+    }
+  } else {
+    EXPECT_FALSE(node->data.empty());
+    for (size_t i = 0; i < node->data.size(); ++i) inner.push_back(*node->data[i]);
+  }
+  aabb<3> box;
+  box.fit(inner.begin(), inner.end());
+  for (unsigned i = 0; i < 3; ++i) {
+    EXPECT_NEAR(box.min(i), node->bbox.min(i), 1e-12);
+    EXPECT_NEAR(box.max(i), node->bbox.max(i), 1e-12);
+  }
+  return depth + 1;
+}
+
+// check a search against the boxes that intersect the query.
+template<typename tree_t>
+static void checkSearch(const tree_t *tree, const std::vector<aabb<3> > &boxes, const std::vector<bool> &present) {
+  for (int q = 0; q < 64; ++q) {
+    // off the grid of the boxes, so that none just touch.
+    aabb<3> query(VECTOR(q % 4 * 0.3 + 0.0123, q / 4 % 4 * 0.3 + 0.0071, q / 16 * 0.3 + 0.0037), VECTOR(0.1037, 0.1511, 0.0519));
+    std::vector<const aabb<3> *> found;
+    tree->search(query, std::back_inserter(found));
+    std::sort(found.begin(), found.end());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+      const bool in = std::binary_search(found.begin(), found.end(), &boxes[i]);
+      if (!present[i]) {
+        ASSERT_FALSE(in);
+      } else if (boxes[i].intersects(query)) {
+        ASSERT_TRUE(in);
+      }
+    }
+  }
+}
+
+TEST(GeomTest, RTreeInsert) {
+  typedef RTreeNode<3, const aabb<3> *> rtree_t;
+  typedef FlatRTree<3, const aabb<3> *> flat_rtree_t;
+
+  std::vector<aabb<3> > boxes;
+  for (int i = 0; i < 3000; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(i * 7 % 100 * 0.01, i * 13 % 97 * 0.01, i * 29 % 89 * 0.01),
+                            VECTOR(0.01 + i % 5 * 0.01, 0.02, 0.01 + i % 3 * 0.005)));
+  }
+  // axis aligned faces have flat boxes.
+  for (int i = 0; i < 500; ++i) {
+    boxes.push_back(aabb<3>(VECTOR(0.5, i % 20 * 0.05, i / 20 * 0.04), VECTOR(0.0, 0.02, 0.02)));
+  }
+  std::vector<bool> present(boxes.size(), false);
+
+  // grow a tree from empty.
+  rtree_t *tree = new rtree_t;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    tree->insert(&boxes[i], 4, 4);
+    present[i] = true;
+  }
+  ASSERT_EQ(boxes.size(), checkTree(tree, 4, 4));
+  ASSERT_LT(0, checkFit(tree));
+  checkSearch(tree, boxes, present);
+
+  // remove some, and put them back.
+  for (size_t i = 0; i < boxes.size(); i += 2) {
+    ASSERT_TRUE(tree->remove(&boxes[i], boxes[i]));
+    present[i] = false;
+  }
+  checkFit(tree);
+  checkSearch(tree, boxes, present);
+  for (size_t i = 0; i < boxes.size(); i += 2) {
+    tree->insert(&boxes[i], 4, 4);
+    present[i] = true;
+  }
+  // removal leaves nodes underfull, so only the size of the tree is checked.
+  std::vector<const aabb<3> *> all;
+  tree->search(tree->bbox, std::back_inserter(all));
+  ASSERT_EQ(boxes.size(), all.size());
+  checkFit(tree);
+  checkSearch(tree, boxes, present);
+
+  // move boxes a little, and refit the paths to their leaves.
+  for (size_t i = 0; i < boxes.size(); i += 3) {
+    const aabb<3> old_box = boxes[i];
+    boxes[i].pos.y += 0.015;
+    ASSERT_TRUE(tree->refit(&boxes[i], old_box));
+  }
+  checkFit(tree);
+  checkSearch(tree, boxes, present);
+
+  // and again, refitting the whole tree.
+  for (size_t i = 1; i < boxes.size(); i += 3) boxes[i].pos.z -= 0.015;
+  tree->refit();
+  checkFit(tree);
+  checkSearch(tree, boxes, present);
+  delete tree;
+
+  // insertion into a bulk loaded tree, and refitting a flat tree.
+  std::vector<const aabb<3> *> ptrs;
+  for (size_t i = 0; i < boxes.size() / 2; ++i) ptrs.push_back(&boxes[i]);
+  tree = rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+  flat_rtree_t *flat = flat_rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4);
+  for (size_t i = boxes.size() / 2; i < boxes.size(); ++i) tree->insert(&boxes[i], 4, 4);
+  ASSERT_EQ(boxes.size(), checkTree(tree, 4, 4));
+  checkFit(tree);
+  checkSearch(tree, boxes, present);
+
+  std::fill(present.begin() + boxes.size() / 2, present.end(), false);
+  for (size_t i = 0; i < boxes.size() / 2; i += 2) {
+    const aabb<3> old_box = boxes[i];
+    boxes[i].pos.x -= 0.02;
+    ASSERT_TRUE(flat->refit(&boxes[i], old_box));
+  }
+  ASSERT_FALSE(flat->refit(&boxes[boxes.size() - 1], boxes[boxes.size() - 1]));
+  checkSearch(flat, boxes, present);
+
+  delete flat;
+  delete tree;
+}
@@ -23,6 +23,7 @@
 #include <carve/carve.hpp>
 #include <carve/mesh.hpp>
 #include <carve/mesh_impl.hpp>
+#include <carve/winding_number.hpp>
 
 #include "write_ply.hpp"
 
@@ -307,6 +308,306 @@ TEST(MeshTest, MeshConstruction2) {
   delete mesh;
 }
 
+// A cube of side 2 about the origin. If n_faces < 6, only the
+// first n_faces faces are created, leaving the cube open.
+static carve::mesh::MeshSet<3> *makeCube(size_t n_faces = 6) {
+  std::vector<carve::mesh::Vertex<3> > vertices;
+  vertices.reserve(8);
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(-1.0, -1.0, -1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(-1.0, +1.0, -1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(+1.0, +1.0, -1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(+1.0, -1.0, -1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(-1.0, -1.0, +1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(-1.0, +1.0, +1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(+1.0, +1.0, +1.0)));
+  vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(+1.0, -1.0, +1.0)));
+
+  std::vector<carve::mesh::Face<3> *> quadfaces;
+  quadfaces.reserve(6);
+  quadfaces.push_back(new carve::mesh::Face<3>(&vertices[0], &vertices[1], &vertices[2], &vertices[3]));
+  quadfaces.push_back(new carve::mesh::Face<3>(&vertices[0], &vertices[4], &vertices[5], &vertices[1]));
+  quadfaces.push_back(new carve::mesh::Face<3>(&vertices[1], &vertices[5], &vertices[6], &vertices[2]));
+  quadfaces.push_back(new carve::mesh::Face<3>(&vertices[2], &vertices[6], &vertices[7], &vertices[3]));
+  quadfaces.push_back(new carve::mesh::Face<3>(&vertices[3], &vertices[7], &vertices[4], &vertices[0]));
+  quadfaces.push_back(new carve::mesh::Face<3>(&vertices[7], &vertices[6], &vertices[5], &vertices[4]));
+
+  while (quadfaces.size() > n_faces) {
+    delete quadfaces.back();
+    quadfaces.pop_back();
+  }
+
+  std::vector<carve::mesh::Mesh<3> *> quadmeshes;
+  carve::mesh::Mesh<3>::create(quadfaces.begin(), quadfaces.end(), quadmeshes, carve::mesh::MeshOptions());
+  return new carve::mesh::MeshSet<3>(vertices, quadmeshes);
+}
+
+TEST(MeshTest, ClassifyPoints) {
+  carve::mesh::MeshSet<3> *mesh = makeCube();
+
+  typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
+  face_rtree_t *rtree = face_rtree_t::construct_STR(mesh->faceBegin(), mesh->faceEnd(), 4, 4);
+
+  std::vector<carve::geom::vector<3> > points;
+  for (int x = -6; x <= 6; ++x) {
+    for (int y = -6; y <= 6; ++y) {
+      for (int z = -6; z <= 6; ++z) {
+        points.push_back(carve::geom::VECTOR(x * 0.3, y * 0.3, z * 0.3));
+      }
+    }
+  }
+  points.push_back(carve::geom::VECTOR(1.0, 0.1, 0.2));
+
+  std::vector<carve::PointClass> result;
+  carve::mesh::classifyPoints(mesh, rtree, points, result);
+
+  ASSERT_EQ(result.size(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    ASSERT_EQ(result[i], carve::mesh::classifyPoint(mesh, rtree, points[i]));
+  }
+  ASSERT_EQ(result[points.size() / 2 - 1], carve::POINT_IN);
+  ASSERT_EQ(result[0], carve::POINT_OUT);
+  ASSERT_EQ(result.back(), carve::POINT_ON);
+
+  delete rtree;
+  delete mesh;
+}
+
+TEST(MeshTest, WindingNumber) {
+  typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
+
+  carve::mesh::MeshSet<3> *mesh = makeCube();
+  face_rtree_t *rtree = face_rtree_t::construct_STR(mesh->faceBegin(), mesh->faceEnd(), 4, 4);
+
+  {
+    carve::mesh::WindingNumber exact(mesh, rtree, NULL, 1e30);
+    carve::mesh::WindingNumber approx(mesh, rtree);
+
+    ASSERT_NEAR(exact(carve::geom::VECTOR(0.0, 0.0, 0.0)), 1.0, 1e-9);
+    ASSERT_NEAR(exact(carve::geom::VECTOR(0.5, -0.7, 0.2)), 1.0, 1e-9);
+    ASSERT_NEAR(exact(carve::geom::VECTOR(3.0, 0.0, 0.0)), 0.0, 1e-9);
+
+    for (int x = -6; x <= 6; ++x) {
+      for (int y = -6; y <= 6; ++y) {
+        for (int z = -6; z <= 6; ++z) {
+          carve::geom::vector<3> v = carve::geom::VECTOR(x * 0.3 + 0.01, y * 0.3 + 0.02, z * 0.3 + 0.03);
+          ASSERT_NEAR(approx(v), exact(v), 0.05);
+          ASSERT_EQ(carve::mesh::classifyPoint(approx, v), carve::mesh::classifyPoint(mesh, rtree, v));
+        }
+      }
+    }
+
+    const carve::mesh::Face<3> *hit_face;
+    ASSERT_EQ(approx.classify(carve::geom::VECTOR(1.0, 0.1, 0.2), &hit_face), carve::POINT_ON);
+    ASSERT_TRUE(hit_face != NULL);
+  }
+
+  delete rtree;
+  delete mesh;
+
+  // with one face missing, the centre of the cube is enclosed by
+  // five sixths of the surface, and is still classified as inside.
+  mesh = makeCube(5);
+  rtree = face_rtree_t::construct_STR(mesh->faceBegin(), mesh->faceEnd(), 4, 4);
+
+  {
+    carve::mesh::WindingNumber winding_number(mesh, rtree);
+
+    ASSERT_NEAR(winding_number(carve::geom::VECTOR(0.0, 0.0, 0.0)), 5.0 / 6.0, 1e-9);
+    ASSERT_EQ(winding_number.classify(carve::geom::VECTOR(0.0, 0.0, 0.0)), carve::POINT_IN);
+    ASSERT_EQ(winding_number.classify(carve::geom::VECTOR(0.0, 0.0, 5.0)), carve::POINT_OUT);
+  }
+
+  delete rtree;
+  delete mesh;
+}
+
+TEST(MeshTest, FlatBufferConstruction) {
+  const double coords[] = {
+    -1.0, -1.0, -1.0,
+    -1.0, +1.0, -1.0,
+    +1.0, +1.0, -1.0,
+    +1.0, -1.0, -1.0,
+    -1.0, -1.0, +1.0,
+    -1.0, +1.0, +1.0,
+    +1.0, +1.0, +1.0,
+    +1.0, -1.0, +1.0
+  };
+  const int face_sizes[] = { 4, 4, 4, 4, 4, 4 };
+  const int face_vertices[] = {
+    0, 1, 2, 3,
+    7, 6, 5, 4,
+    0, 4, 5, 1,
+    1, 5, 6, 2,
+    2, 6, 7, 3,
+    3, 7, 4, 0
+  };
+
+  carve::mesh::MeshSet<3> *mesh = new carve::mesh::MeshSet<3>(coords, 8, face_sizes, 6, face_vertices);
+  carve::mesh::MeshSet<3> *ref = makeCube();
+
+  ASSERT_EQ(mesh->vertex_storage.size(), 8U);
+  ASSERT_EQ(mesh->meshes.size(), 1U);
+  ASSERT_TRUE(mesh->isClosed());
+  ASSERT_EQ(mesh->meshes[0]->faces.size(), 6U);
+  ASSERT_EQ(mesh->meshes[0]->closed_edges.size(), 12U);
+  ASSERT_NEAR(mesh->meshes[0]->volume(), ref->meshes[0]->volume(), 1e-9);
+
+  for (carve::mesh::MeshSet<3>::face_iter i = mesh->faceBegin(); i != mesh->faceEnd(); ++i) {
+    ASSERT_TRUE((*i)->isArenaOwned());
+    ASSERT_TRUE((*i)->edge->isArenaOwned());
+  }
+
+  carve::mesh::MeshSet<3> *copy = mesh->clone();
+  ASSERT_EQ(copy->meshes.size(), 1U);
+  ASSERT_EQ(copy->meshes[0]->faces.size(), 6U);
+  ASSERT_EQ(copy->meshes[0]->closed_edges.size(), 12U);
+  ASSERT_NEAR(copy->meshes[0]->volume(), ref->meshes[0]->volume(), 1e-9);
+  ASSERT_EQ(copy->vertex_storage.size(), mesh->vertex_storage.size());
+  for (carve::mesh::MeshSet<3>::face_iter i = copy->faceBegin(); i != copy->faceEnd(); ++i) {
+    ASSERT_TRUE((*i)->isArenaOwned());
+    for (carve::mesh::MeshSet<3>::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e) {
+      ASSERT_GE(e->vert, &copy->vertex_storage[0]);
+      ASSERT_LT(e->vert, &copy->vertex_storage[0] + copy->vertex_storage.size());
+    }
+  }
+
+  // the clone owns its own arena, and outlives the original.
+  delete mesh;
+  delete ref;
+  ASSERT_TRUE(copy->isClosed());
+
+  // arena owned faces may still be destroyed individually.
+  delete copy->meshes[0];
+  copy->meshes.clear();
+  delete copy;
+}
+
+static void checkDenseIndices(const carve::mesh::MeshSet<3> *mesh) {
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  carve::mesh::ElementAttribute<meshset_t::face_t, int> face_seen(mesh, 0);
+  carve::mesh::ElementAttribute<meshset_t::edge_t, int> edge_seen(mesh, 0);
+  carve::mesh::ElementAttribute<meshset_t::vertex_t, int> vert_seen(mesh, 0);
+
+  size_t n_faces = 0, n_edges = 0;
+  for (meshset_t::const_face_iter i = mesh->faceBegin(); i != mesh->faceEnd(); ++i) {
+    ASSERT_LT(mesh->faceIndex(*i), mesh->faceCount());
+    face_seen[*i]++;
+    ++n_faces;
+    for (meshset_t::face_t::const_edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e) {
+      ASSERT_LT(mesh->edgeIndex(&*e), mesh->edgeCount());
+      edge_seen[&*e]++;
+      vert_seen[e->vert] = 1;
+      ++n_edges;
+    }
+  }
+
+  ASSERT_EQ(mesh->faceCount(), n_faces);
+  ASSERT_EQ(mesh->edgeCount(), n_edges);
+  ASSERT_EQ(face_seen.size(), n_faces);
+  for (size_t i = 0; i < face_seen.size(); ++i) ASSERT_EQ(face_seen[i], 1);
+  for (size_t i = 0; i < edge_seen.size(); ++i) ASSERT_EQ(edge_seen[i], 1);
+  for (size_t i = 0; i < vert_seen.size(); ++i) ASSERT_EQ(vert_seen[i], 1);
+}
+
+TEST(MeshTest, DenseIndices) {
+  carve::mesh::MeshSet<3> *mesh = makeCube();
+  ASSERT_EQ(mesh->faceCount(), 6U);
+  ASSERT_EQ(mesh->edgeCount(), 24U);
+  ASSERT_EQ(mesh->vertexCount(), 8U);
+  checkDenseIndices(mesh);
+
+  carve::mesh::MeshSet<3> *copy = mesh->clone();
+  checkDenseIndices(copy);
+  for (carve::mesh::MeshSet<3>::face_iter i = mesh->faceBegin(), j = copy->faceBegin(); i != mesh->faceEnd(); ++i, ++j) {
+    ASSERT_EQ(mesh->faceIndex(*i), copy->faceIndex(*j));
+    ASSERT_EQ(mesh->edgeIndex((*i)->edge), copy->edgeIndex((*j)->edge));
+  }
+
+  copy->canonicalize();
+  checkDenseIndices(copy);
+
+  delete copy;
+  delete mesh;
+}
+
+TEST(MeshTest, MoveMeshes) {
+  // the faces of a clone are in its arena. moving its meshes to a new
+  // meshset must leave them valid once the clone is destroyed.
+  carve::mesh::MeshSet<3> *mesh = makeCube();
+  carve::mesh::MeshSet<3> *copy = mesh->clone();
+  ASSERT_TRUE((*copy->faceBegin())->isArenaOwned());
+
+  std::vector<carve::mesh::MeshSet<3>::mesh_t *> meshes;
+  for (size_t i = 0; i < copy->meshes.size(); ++i) {
+    copy->meshes[i]->meshset = NULL;
+    meshes.push_back(copy->meshes[i]);
+  }
+  copy->meshes.clear();
+
+  carve::mesh::MeshSet<3> *moved = new carve::mesh::MeshSet<3>(meshes);
+  delete copy;
+
+  ASSERT_TRUE(moved->isClosed());
+  ASSERT_EQ(moved->faceCount(), 6U);
+  ASSERT_EQ(moved->edgeCount(), 24U);
+  ASSERT_EQ(moved->vertexCount(), 8U);
+  checkDenseIndices(moved);
+  ASSERT_NEAR(moved->meshes[0]->volume(), mesh->meshes[0]->volume(), 1e-12);
+  for (carve::mesh::MeshSet<3>::face_iter i = moved->faceBegin(); i != moved->faceEnd(); ++i) {
+    ASSERT_EQ((*i)->mesh->meshset, moved);
+    ASSERT_TRUE((*i)->edge->vert >= &moved->vertex_storage[0] &&
+                (*i)->edge->vert < &moved->vertex_storage[0] + moved->vertex_storage.size());
+  }
+
+  delete moved;
+  delete mesh;
+}
+
+struct translate_x {
+  carve::geom::vector<3> operator()(const carve::geom::vector<3> &v) const {
+    return v + carve::geom::VECTOR(1.0, 0.0, 0.0);
+  }
+};
+
+TEST(MeshTest, FaceGeometry) {
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  meshset_t *mesh = makeCube();
+
+  ASSERT_TRUE(mesh->cachedFaceGeometry() == NULL);
+  const carve::mesh::FaceGeometry<3> &geom = mesh->faceGeometry();
+  ASSERT_EQ(mesh->cachedFaceGeometry(), &geom);
+
+  std::vector<carve::geom::vector<2> > proj, cached;
+  for (meshset_t::face_iter i = mesh->faceBegin(); i != mesh->faceEnd(); ++i) {
+    meshset_t::face_t *f = *i;
+    carve::geom::aabb<3> a = f->getAABB(), b = geom.getAABB(f->id);
+    for (unsigned j = 0; j < 3; ++j) {
+      ASSERT_EQ(a.pos.v[j], b.pos.v[j]);
+      ASSERT_EQ(a.extent.v[j], b.extent.v[j]);
+    }
+    ASSERT_TRUE(geom.normalRange(f->id) == f->rangeInDirection(f->plane.N, f->edge->vert->v));
+
+    f->getProjectedVertices(proj);
+    geom.getProjectedVertices(f, cached);
+    ASSERT_EQ(proj.size(), cached.size());
+    for (size_t j = 0; j < proj.size(); ++j) {
+      ASSERT_EQ(proj[j].x, cached[j].x);
+      ASSERT_EQ(proj[j].y, cached[j].y);
+    }
+  }
+
+  // moving the vertices discards the cache.
+  mesh->transform(translate_x());
+  ASSERT_TRUE(mesh->cachedFaceGeometry() == NULL);
+  ASSERT_EQ(mesh->faceGeometry().getAABB(0).pos.x, (*mesh->faceBegin())->getAABB().pos.x);
+
+  mesh->faceGeometry();
+  mesh->canonicalize();
+  ASSERT_TRUE(mesh->cachedFaceGeometry() == NULL);
+
+  delete mesh;
+}
+
 TEST(MeshTest, MeshConstruction1) {
   std::vector<carve::mesh::Vertex<3> > vertices;
   vertices.reserve(9);
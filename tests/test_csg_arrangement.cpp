@@ -0,0 +1,147 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+// Benchmark of region arrangements. Every region of K overlapping
+// rotated cubes, whose faces are divided into n * n squares, is
+// collected from one Arrangement, and computed by a chain of K - 1
+// calls to CSG::compute(), for increasing K.
+//
+// usage: test_csg_arrangement [max_operands [n]]
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg.hpp>
+#include <carve/csg_arrangement.hpp>
+#include <carve/matrix.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <memory>
+#include <ctime>
+#include <cstdlib>
+#include <cmath>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// a cube of side 2 centred on the origin, each face of which is
+// divided into n * n squares.
+static meshset_t *makeCube(const carve::math::Matrix &transform, int n) {
+  std::map<std::vector<int>, int> index;
+  std::vector<carve::geom::vector<3> > points;
+  std::vector<int> faces;
+  size_t n_faces = 0;
+
+  for (int a = 0; a < 3; ++a) {
+    const int b = (a + 1) % 3, c = (a + 2) % 3;
+    for (int side = 0; side < 2; ++side) {
+      for (int u = 0; u < n; ++u) {
+        for (int v = 0; v < n; ++v) {
+          const int du[] = { 0, 1, 1, 0 }, dv[] = { 0, 0, 1, 1 };
+          faces.push_back(4);
+          for (int k = 0; k < 4; ++k) {
+            const int kk = side ? k : 3 - k;
+            std::vector<int> p(3);
+            p[a] = side * n; p[b] = u + du[kk]; p[c] = v + dv[kk];
+            std::map<std::vector<int>, int>::iterator i = index.find(p);
+            if (i == index.end()) {
+              i = index.insert(std::make_pair(p, (int)points.size())).first;
+              points.push_back(transform * (carve::geom::VECTOR(p[0], p[1], p[2]) * (2.0 / n) - carve::geom::VECTOR(1.0, 1.0, 1.0)));
+            }
+            faces.push_back((*i).second);
+          }
+          ++n_faces;
+        }
+      }
+    }
+  }
+  return new meshset_t(points, n_faces, faces);
+}
+
+static double volume(const meshset_t *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) v += m->meshes[i]->volume();
+  return v;
+}
+
+static double seconds(clock_t start) {
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+
+int main(int argc, char **argv) {
+  const size_t max_operands = argc > 1 ? atoi(argv[1]) : 6;
+  const int n = argc > 2 ? atoi(argv[2]) : 8;
+
+  std::cout << "operands  regions  arrangement(s)  compute(s)  max volume difference" << std::endl;
+
+  for (size_t k = 2; k <= max_operands; ++k) {
+    std::vector<meshset_t *> operands;
+    for (size_t i = 0; i < k; ++i) {
+      const double t = 2.0 * M_PI * i / k;
+      operands.push_back(makeCube(carve::math::Matrix::TRANS(0.8 * cos(t), 0.8 * sin(t), 0.1 * i) *
+                                  carve::math::Matrix::ROT(0.3 + 0.4 * i, 1.0, 0.3 + 0.1 * i, 0.2), n));
+    }
+    const unsigned n_regions = (1U << k) - 1;
+
+    clock_t c = clock();
+    std::vector<double> arrangement_volume;
+    {
+      carve::csg::Arrangement arrangement(operands);
+      for (unsigned r = 1; r <= n_regions; ++r) {
+        std::auto_ptr<meshset_t> result(arrangement.collect((carve::csg::Arrangement::mask_t)r));
+        arrangement_volume.push_back(volume(result.get()));
+      }
+    }
+    const double t_arrangement = seconds(c);
+
+    carve::csg::CSG csg;
+    double max_difference = 0.0;
+    c = clock();
+    for (unsigned r = 1; r <= n_regions; ++r) {
+      std::auto_ptr<meshset_t> result;
+      for (size_t i = 0; i < k; ++i) {
+        if (!(r & (1U << i))) continue;
+        if (result.get() == NULL) {
+          result.reset(operands[i]->clone());
+        } else {
+          result.reset(csg.compute(result.get(), operands[i], carve::csg::CSG::INTERSECTION));
+        }
+      }
+      for (size_t i = 0; i < k; ++i) {
+        if (r & (1U << i)) continue;
+        result.reset(csg.compute(result.get(), operands[i], carve::csg::CSG::A_MINUS_B));
+      }
+      max_difference = std::max(max_difference, fabs(volume(result.get()) - arrangement_volume[r - 1]));
+    }
+    const double t_compute = seconds(c);
+
+    std::cout << std::setw(8) << k
+              << std::setw(9) << n_regions
+              << std::setw(16) << std::fixed << std::setprecision(3) << t_arrangement
+              << std::setw(12) << t_compute
+              << std::setw(23) << std::scientific << std::setprecision(2) << max_difference << std::endl;
+
+    for (size_t i = 0; i < k; ++i) delete operands[i];
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+// Benchmark of incremental subtraction. A tool is swept in small
+// steps across a corner of cubic stocks of increasing size, whose
+// faces are unit squares, and each step is subtracted both by a
+// SubtractionSession and by CSG::compute() on the whole stock. The
+// cost of a session step should not grow with the stock.
+//
+// usage: test_csg_session [n_steps]
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg.hpp>
+#include <carve/csg_session.hpp>
+#include <carve/matrix.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <memory>
+#include <ctime>
+#include <cstdlib>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// a cube of side n, each face of which is divided into n * n squares.
+static meshset_t *makeStock(int n) {
+  std::map<std::vector<int>, int> index;
+  std::vector<carve::geom::vector<3> > points;
+  std::vector<int> faces;
+  size_t n_faces = 0;
+
+  for (int a = 0; a < 3; ++a) {
+    const int b = (a + 1) % 3, c = (a + 2) % 3;
+    for (int side = 0; side < 2; ++side) {
+      for (int u = 0; u < n; ++u) {
+        for (int v = 0; v < n; ++v) {
+          const int du[] = { 0, 1, 1, 0 }, dv[] = { 0, 0, 1, 1 };
+          faces.push_back(4);
+          for (int k = 0; k < 4; ++k) {
+            // the max side is wound anticlockwise seen from outside,
+            // the min side the other way.
+            const int kk = side ? k : 3 - k;
+            std::vector<int> p(3);
+            p[a] = side * n; p[b] = u + du[kk]; p[c] = v + dv[kk];
+            std::map<std::vector<int>, int>::iterator i = index.find(p);
+            if (i == index.end()) {
+              i = index.insert(std::make_pair(p, (int)points.size())).first;
+              points.push_back(carve::geom::VECTOR(p[0], p[1], p[2]));
+            }
+            faces.push_back((*i).second);
+          }
+          ++n_faces;
+        }
+      }
+    }
+  }
+  return new meshset_t(points, n_faces, faces);
+}
+
+// a rotated cube of side 1.
+static meshset_t *makeTool(const carve::math::Matrix &transform) {
+  std::vector<carve::geom::vector<3> > points;
+  for (int i = 0; i < 8; ++i) {
+    points.push_back(transform * carve::geom::VECTOR(i & 1 ? 0.5 : -0.5, i & 2 ? 0.5 : -0.5, i & 4 ? 0.5 : -0.5));
+  }
+  const int f[] = {
+    4, 0, 2, 3, 1,   4, 4, 5, 7, 6,   4, 0, 1, 5, 4,
+    4, 2, 6, 7, 3,   4, 0, 4, 6, 2,   4, 1, 3, 7, 5
+  };
+  return new meshset_t(points, 6, std::vector<int>(f, f + sizeof(f) / sizeof(f[0])));
+}
+
+static double volume(const meshset_t *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) v += m->meshes[i]->volume();
+  return v;
+}
+
+static double seconds(clock_t start) {
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+
+int main(int argc, char **argv) {
+  const int n_steps = argc > 1 ? atoi(argv[1]) : 100;
+
+  std::cout << "   stock    faces  session(ms/step)  compute(ms/step)  volume difference" << std::endl;
+
+  const int sizes[] = { 4, 16, 64 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    const int n = sizes[s];
+    std::auto_ptr<meshset_t> stock(makeStock(n));
+    const size_t n_faces = stock->faceEnd() - stock->faceBegin();
+
+    std::vector<meshset_t *> tools;
+    for (int i = 0; i < n_steps; ++i) {
+      const double t = double(i) / n_steps;
+      tools.push_back(makeTool(carve::math::Matrix::TRANS(n - 2.0 + 1.5 * t, n - 1.0 - 1.5 * t, n - 0.1 - 0.2 * t) *
+                               carve::math::Matrix::ROT(0.3 + 0.05 * i, 1.0, 0.7, 0.3)));
+    }
+
+    clock_t c = clock();
+    carve::csg::SubtractionSession session(stock.get());
+    for (int i = 0; i < n_steps; ++i) session.subtract(tools[i]);
+    const double t_session = seconds(c);
+    std::auto_ptr<meshset_t> session_result(session.result());
+
+    carve::csg::CSG csg;
+    std::auto_ptr<meshset_t> compute_result(stock->clone());
+    c = clock();
+    for (int i = 0; i < n_steps; ++i) {
+      compute_result.reset(csg.compute(compute_result.get(), tools[i], carve::csg::CSG::A_MINUS_B));
+    }
+    const double t_compute = seconds(c);
+
+    std::cout << std::setw(8) << n
+              << std::setw(9) << n_faces
+              << std::setw(18) << std::fixed << std::setprecision(3) << 1000.0 * t_session / n_steps
+              << std::setw(18) << 1000.0 * t_compute / n_steps
+              << std::setw(19) << std::scientific << std::setprecision(2)
+              << volume(session_result.get()) - volume(compute_result.get()) << std::endl;
+
+    for (int i = 0; i < n_steps; ++i) delete tools[i];
+  }
+
+  return EXIT_SUCCESS;
+}
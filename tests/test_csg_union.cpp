@@ -0,0 +1,137 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+// Benchmark of n-ary union. The struts along the edges of cubic
+// lattices of increasing size are united by CSG::computeUnion(), and,
+// up to a given lattice size, by a chain of binary unions. Each strut
+// is turned about its own axis by a different angle, so that no two
+// struts have coplanar faces.
+//
+// usage: test_csg_union [max_chain_size [max_size]]
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg.hpp>
+#include <carve/matrix.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <ctime>
+#include <cstdlib>
+
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// a box of the given length along the x axis and width 0.2, centred
+// on the origin.
+static meshset_t *makeStrut(const carve::math::Matrix &transform, double length) {
+  std::vector<carve::geom::vector<3> > points;
+  for (int i = 0; i < 8; ++i) {
+    points.push_back(transform * carve::geom::VECTOR(i & 1 ? length / 2 : -length / 2, i & 2 ? 0.1 : -0.1, i & 4 ? 0.1 : -0.1));
+  }
+  const int f[] = {
+    4, 0, 2, 3, 1,   4, 4, 5, 7, 6,   4, 0, 1, 5, 4,
+    4, 2, 6, 7, 3,   4, 0, 4, 6, 2,   4, 1, 3, 7, 5
+  };
+  return new meshset_t(points, 6, std::vector<int>(f, f + sizeof(f) / sizeof(f[0])));
+}
+
+// the struts along the edges of a lattice of n * n * n unit cells.
+static void makeLattice(int n, std::vector<meshset_t *> &struts) {
+  const carve::math::Matrix to_axis[] = {
+    carve::math::Matrix::IDENT(),
+    carve::math::Matrix::ROT(M_PI / 2, 0.0, 0.0, 1.0),
+    carve::math::Matrix::ROT(-M_PI / 2, 0.0, 1.0, 0.0)
+  };
+  for (int a = 0; a < 3; ++a) {
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j <= n; ++j) {
+        for (int k = 0; k <= n; ++k) {
+          double p[3];
+          p[a] = i + 0.5; p[(a + 1) % 3] = j; p[(a + 2) % 3] = k;
+          const double angle = 0.1 + 0.37 * (double)struts.size();
+          struts.push_back(makeStrut(carve::math::Matrix::TRANS(p[0], p[1], p[2]) *
+                                     to_axis[a] *
+                                     carve::math::Matrix::ROT(angle, 1.0, 0.0, 0.0),
+                                     1.3));
+        }
+      }
+    }
+  }
+}
+
+static double volume(const meshset_t *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) v += m->meshes[i]->volume();
+  return v;
+}
+
+static double now() {
+#if defined(_OPENMP)
+  return omp_get_wtime();
+#else
+  return double(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+
+
+int main(int argc, char **argv) {
+  const int max_chain_size = argc > 1 ? atoi(argv[1]) : 3;
+  const int max_size = argc > 2 ? atoi(argv[2]) : 6;
+
+  std::cout << " lattice   struts  union(s)  chain(s)  volume difference" << std::endl;
+
+  carve::csg::CSG csg;
+  for (int n = 1; n <= max_size; ++n) {
+    std::vector<meshset_t *> struts;
+    makeLattice(n, struts);
+
+    double t = now();
+    std::auto_ptr<meshset_t> result(csg.computeUnion(struts));
+    const double t_union = now() - t;
+
+    std::cout << std::setw(8) << n
+              << std::setw(9) << struts.size()
+              << std::setw(10) << std::fixed << std::setprecision(3) << t_union;
+
+    if (n <= max_chain_size) {
+      t = now();
+      std::auto_ptr<meshset_t> chain(struts[0]->clone());
+      for (size_t i = 1; i < struts.size(); ++i) {
+        chain.reset(csg.compute(chain.get(), struts[i], carve::csg::CSG::UNION));
+      }
+      const double t_chain = now() - t;
+
+      std::cout << std::setw(10) << t_chain
+                << std::setw(19) << std::scientific << std::setprecision(2)
+                << volume(result.get()) - volume(chain.get());
+    }
+    std::cout << std::endl;
+
+    for (size_t i = 0; i < struts.size(); ++i) delete struts[i];
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+// Benchmark of R-tree traversal, comparing child box tests made
+// through the packed child bounds of each node with tests made one
+// child node at a time, and the pointer based RTreeNode with the
+// flattened FlatRTree.
+//
+// usage: test_rtree [n_boxes [n_queries]]
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/rtree.hpp>
+#include <carve/flat_rtree.hpp>
+
+#include "mersenne_twister.h"
+
+#include <iostream>
+#include <vector>
+#include <ctime>
+#include <cstdlib>
+
+typedef carve::geom::aabb<3> aabb_t;
+typedef carve::geom::RTreeNode<3, const aabb_t *> rtree_t;
+typedef carve::geom::FlatRTree<3, const aabb_t *> flat_rtree_t;
+
+
+
+// search, testing the box of each child node in turn.
+static void searchSiblings(const rtree_t *node, const aabb_t &q, size_t &count) {
+  if (!node->bbox.intersects(q)) return;
+  if (node->child) {
+    for (const rtree_t *c = node->child; c; c = c->sibling) searchSiblings(c, q, count);
+  } else {
+    count += node->data.size();
+  }
+}
+
+// search, using the packed child bounds.
+static void searchPacked(const rtree_t *node, const aabb_t &q, size_t &count) {
+  if (node->child) {
+    rtree_t::intersecting_children children(node, q);
+    for (const rtree_t *c; (c = children.next()) != NULL; ) searchPacked(c, q, count);
+  } else {
+    count += node->data.size();
+  }
+}
+
+// dual tree traversal, testing child nodes in turn.
+static void joinSiblings(const rtree_t *a, const rtree_t *b, bool descend_a, size_t &count) {
+  if (!a->bbox.intersects(b->bbox)) return;
+  if (a->child && (descend_a || !b->child)) {
+    for (const rtree_t *c = a->child; c; c = c->sibling) joinSiblings(c, b, false, count);
+  } else if (b->child) {
+    for (const rtree_t *c = b->child; c; c = c->sibling) joinSiblings(a, c, true, count);
+  } else {
+    count += a->data.size() * b->data.size();
+  }
+}
+
+// dual tree traversal, using the packed child bounds.
+static void joinPacked(const rtree_t *a, const rtree_t *b, bool descend_a, size_t &count) {
+  if (a->child && (descend_a || !b->child)) {
+    rtree_t::intersecting_children children(a, b->bbox);
+    for (const rtree_t *c; (c = children.next()) != NULL; ) joinPacked(c, b, false, count);
+  } else if (b->child) {
+    rtree_t::intersecting_children children(b, a->bbox, true);
+    for (const rtree_t *c; (c = children.next()) != NULL; ) joinPacked(a, c, true, count);
+  } else {
+    count += a->data.size() * b->data.size();
+  }
+}
+
+// search of the flattened tree.
+static void searchFlat(const flat_rtree_t *tree, flat_rtree_t::index_t node, const aabb_t &q, size_t &count) {
+  if (tree->isLeaf(node)) {
+    count += tree->end(node) - tree->begin(node);
+  } else {
+    flat_rtree_t::intersecting_children children(*tree, node, q);
+    for (flat_rtree_t::index_t c; children.next(c); ) searchFlat(tree, c, q, count);
+  }
+}
+
+// dual tree traversal of the flattened tree.
+static void joinFlat(const flat_rtree_t *tree, flat_rtree_t::index_t a, flat_rtree_t::index_t b, bool descend_a, size_t &count) {
+  if (!tree->isLeaf(a) && (descend_a || tree->isLeaf(b))) {
+    flat_rtree_t::intersecting_children children(*tree, a, tree->bbox(b));
+    for (flat_rtree_t::index_t c; children.next(c); ) joinFlat(tree, c, b, false, count);
+  } else if (!tree->isLeaf(b)) {
+    flat_rtree_t::intersecting_children children(*tree, b, tree->bbox(a), true);
+    for (flat_rtree_t::index_t c; children.next(c); ) joinFlat(tree, a, c, true, count);
+  } else {
+    count += (tree->end(a) - tree->begin(a)) * (tree->end(b) - tree->begin(b));
+  }
+}
+
+// the approximate heap footprint of a pointer based tree.
+static size_t memoryUsed(const rtree_t *node) {
+  size_t n = sizeof(rtree_t) + node->data.capacity() * sizeof(const aabb_t *) + node->child_bbox.memoryUsed();
+  for (const rtree_t *c = node->child; c; c = c->sibling) n += memoryUsed(c);
+  return n;
+}
+
+static double seconds(clock_t start) {
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+
+int main(int argc, char **argv) {
+  const size_t n_boxes = argc > 1 ? (size_t)atol(argv[1]) : 200000;
+  const size_t n_queries = argc > 2 ? (size_t)atol(argv[2]) : 200000;
+
+  MTRand rand(1);
+
+  // small boxes scattered through a unit cube, roughly as the faces
+  // of a fine mesh are.
+  const double size = 0.5 / std::pow((double)n_boxes, 1.0 / 3.0);
+  std::vector<aabb_t> boxes(n_boxes);
+  for (size_t i = 0; i < n_boxes; ++i) {
+    boxes[i].pos = carve::geom::VECTOR(rand.rand(), rand.rand(), rand.rand());
+    boxes[i].extent = carve::geom::VECTOR(rand.rand(size), rand.rand(size), rand.rand(size));
+  }
+  std::vector<aabb_t> queries(n_queries);
+  for (size_t i = 0; i < n_queries; ++i) {
+    queries[i].pos = carve::geom::VECTOR(rand.rand(), rand.rand(), rand.rand());
+    queries[i].extent = carve::geom::VECTOR(rand.rand(size), rand.rand(size), rand.rand(size));
+  }
+
+  std::vector<const aabb_t *> ptrs(n_boxes);
+  for (size_t i = 0; i < n_boxes; ++i) ptrs[i] = &boxes[i];
+
+  std::cout << "boxes: " << n_boxes << " queries: " << n_queries
+            << " block width: " << carve::geom::packed_aabb<3>::WIDTH << std::endl;
+
+  const size_t fanouts[] = { 4, 8, 16 };
+  for (size_t f = 0; f < sizeof(fanouts) / sizeof(fanouts[0]); ++f) {
+    clock_t t = clock();
+    rtree_t *tree = rtree_t::construct_STR(ptrs.begin(), ptrs.end(), fanouts[f], fanouts[f]);
+    double tb = seconds(t);
+
+    t = clock();
+    flat_rtree_t *flat = flat_rtree_t::construct_STR(ptrs.begin(), ptrs.end(), fanouts[f], fanouts[f]);
+    double tb_flat = seconds(t);
+
+    size_t c_sib = 0, c_packed = 0, c_flat = 0;
+    t = clock();
+    for (size_t i = 0; i < n_queries; ++i) searchSiblings(tree, queries[i], c_sib);
+    double t_sib = seconds(t);
+
+    t = clock();
+    for (size_t i = 0; i < n_queries; ++i) {
+      if (tree->bbox.intersects(queries[i])) searchPacked(tree, queries[i], c_packed);
+    }
+    double t_packed = seconds(t);
+
+    t = clock();
+    for (size_t i = 0; i < n_queries; ++i) {
+      if (flat->getAABB().intersects(queries[i])) searchFlat(flat, flat->root(), queries[i], c_flat);
+    }
+    double t_flat = seconds(t);
+
+    size_t j_sib = 0, j_packed = 0, j_flat = 0;
+    t = clock();
+    joinSiblings(tree, tree, true, j_sib);
+    double tj_sib = seconds(t);
+
+    t = clock();
+    if (tree->bbox.intersects(tree->bbox)) joinPacked(tree, tree, true, j_packed);
+    double tj_packed = seconds(t);
+
+    t = clock();
+    joinFlat(flat, flat->root(), flat->root(), true, j_flat);
+    double tj_flat = seconds(t);
+
+    std::cout << "fanout " << fanouts[f] << std::endl
+              << "  build:  pointers " << tb << "s flat " << tb_flat << "s" << std::endl
+              << "  memory: pointers " << memoryUsed(tree) << " bytes flat " << flat->memoryUsed() << " bytes" << std::endl
+              << "  search: siblings " << t_sib << "s packed " << t_packed << "s flat " << t_flat << "s"
+              << " (" << c_sib << (c_sib == c_packed && c_sib == c_flat ? " == " : " != ") << c_packed << " results)" << std::endl
+              << "  join:   siblings " << tj_sib << "s packed " << tj_packed << "s flat " << tj_flat << "s"
+              << " (" << j_sib << (j_sib == j_packed && j_sib == j_flat ? " == " : " != ") << j_packed << " pairs)" << std::endl;
+
+    delete tree;
+    delete flat;
+
+    if (c_sib != c_packed || c_sib != c_flat || j_sib != j_packed || j_sib != j_flat) return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
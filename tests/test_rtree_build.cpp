@@ -0,0 +1,179 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+// Benchmark of R-tree builders on meshes. Face R-trees are built by
+// sort-tile-recursive (STR), top-down greedy split (TGS) and surface
+// area heuristic (SAH) construction, and compared by the work done
+// querying the tree with the bounding box of each face, and by the
+// search for intersection candidates between the mesh and a
+// slightly translated copy, as done by CSG::compute().
+//
+// usage: test_rtree_build [-l leaf_size] [-i internal_size] file.ply ...
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/mesh.hpp>
+#include <carve/flat_rtree.hpp>
+#include <carve/matrix.hpp>
+
+#include "read_ply.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+typedef carve::geom::FlatRTree<3, carve::mesh::Face<3> *> face_rtree_t;
+typedef carve::geom::aabb<3> aabb_t;
+
+struct stats_t {
+  // bounding box tests made.
+  size_t box_tests;
+  // faces returned by queries, or face pairs in intersecting leaf pairs.
+  size_t candidates;
+  // of those, faces or face pairs whose bounding boxes intersect.
+  size_t hits;
+
+  stats_t() : box_tests(0), candidates(0), hits(0) { }
+};
+
+static void query(const face_rtree_t *tree, face_rtree_t::index_t node, const aabb_t &box, stats_t &stats) {
+  if (tree->isLeaf(node)) {
+    for (face_rtree_t::data_iter_t i = tree->begin(node); i != tree->end(node); ++i) {
+      ++stats.candidates;
+      if ((*i)->getAABB().intersects(box)) ++stats.hits;
+    }
+  } else {
+    stats.box_tests += tree->childEnd(node) - tree->childBegin(node);
+    face_rtree_t::intersecting_children children(*tree, node, box);
+    for (face_rtree_t::index_t c; children.next(c); ) query(tree, c, box, stats);
+  }
+}
+
+// the dual traversal of CSG::generateIntersectionCandidates().
+static void join(const face_rtree_t *a, face_rtree_t::index_t a_node,
+                 const face_rtree_t *b, face_rtree_t::index_t b_node,
+                 bool descend_a, stats_t &stats) {
+  ++stats.box_tests;
+  if (!a->bbox(a_node).intersects(b->bbox(b_node))) return;
+
+  if (!a->isLeaf(a_node) && (descend_a || b->isLeaf(b_node))) {
+    for (face_rtree_t::index_t c = a->childBegin(a_node); c != a->childEnd(a_node); ++c) join(a, c, b, b_node, false, stats);
+  } else if (!b->isLeaf(b_node)) {
+    for (face_rtree_t::index_t c = b->childBegin(b_node); c != b->childEnd(b_node); ++c) join(a, a_node, b, c, true, stats);
+  } else {
+    for (face_rtree_t::data_iter_t i = a->begin(a_node); i != a->end(a_node); ++i) {
+      const aabb_t box = (*i)->getAABB();
+      for (face_rtree_t::data_iter_t j = b->begin(b_node); j != b->end(b_node); ++j) {
+        ++stats.candidates;
+        if (box.intersects((*j)->getAABB())) ++stats.hits;
+      }
+    }
+  }
+}
+
+// the summed surface area of the leaves, relative to that of the root.
+static double leafArea(const face_rtree_t *tree) {
+  double area = 0.0;
+  for (face_rtree_t::index_t i = 0; i < tree->size(); ++i) {
+    if (tree->isLeaf(i)) area += tree->bbox(i).surfaceArea();
+  }
+  return area / tree->getAABB().surfaceArea();
+}
+
+static face_rtree_t *build(int builder, meshset_t *mesh, size_t leaf_size, size_t internal_size) {
+  switch (builder) {
+  case 0: return face_rtree_t::construct_STR(mesh->faceBegin(), mesh->faceEnd(), leaf_size, internal_size);
+  case 1: return face_rtree_t::construct_TGS(mesh->faceBegin(), mesh->faceEnd(), leaf_size, internal_size);
+  default: return face_rtree_t::construct_SAH(mesh->faceBegin(), mesh->faceEnd(), leaf_size, internal_size);
+  }
+}
+
+static double seconds(clock_t start) {
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+
+int main(int argc, char **argv) {
+  size_t leaf_size = 4, internal_size = 4;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+      leaf_size = (size_t)atol(argv[++i]);
+    } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+      internal_size = (size_t)atol(argv[++i]);
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  if (files.empty()) {
+    std::cerr << "usage: " << argv[0] << " [-l leaf_size] [-i internal_size] file.ply ..." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const char *names[] = { "STR", "TGS", "SAH" };
+
+  for (size_t f = 0; f < files.size(); ++f) {
+    std::auto_ptr<meshset_t> a(readPLYasMesh(files[f]));
+    std::auto_ptr<meshset_t> b(readPLYasMesh(files[f], carve::math::Matrix::TRANS(0.01, 0.02, 0.01)));
+    if (!a.get() || !b.get()) {
+      std::cerr << "failed to load " << files[f] << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::cout << files[f] << ": " << a->faceCount() << " faces" << std::endl
+              << "  builder   build(s)    nodes  leaf area  query tests  query faces  join tests  join pairs   join hits" << std::endl;
+
+    for (int builder = 0; builder < 3; ++builder) {
+      clock_t t = clock();
+      std::auto_ptr<face_rtree_t> a_tree(build(builder, a.get(), leaf_size, internal_size));
+      double tb = seconds(t);
+      std::auto_ptr<face_rtree_t> b_tree(build(builder, b.get(), leaf_size, internal_size));
+
+      stats_t q;
+      for (meshset_t::face_iter i = a->faceBegin(); i != a->faceEnd(); ++i) {
+        const aabb_t box = (*i)->getAABB();
+        if (a_tree->getAABB().intersects(box)) query(a_tree.get(), a_tree->root(), box, q);
+      }
+
+      stats_t j;
+      join(a_tree.get(), a_tree->root(), b_tree.get(), b_tree->root(), true, j);
+
+      std::cout << "  " << std::setw(7) << names[builder]
+                << std::setw(11) << std::fixed << std::setprecision(3) << tb
+                << std::setw(9) << a_tree->size()
+                << std::setw(11) << std::setprecision(1) << leafArea(a_tree.get())
+                << std::setw(13) << q.box_tests
+                << std::setw(13) << q.candidates
+                << std::setw(12) << j.box_tests
+                << std::setw(12) << j.candidates
+                << std::setw(12) << j.hits << std::endl;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}